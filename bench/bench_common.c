@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "bench_common.h"
+
+uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* "64,256,4K,1M" -> values; returns the count or -EINVAL */
+int bench_parse_list(const char *arg, int *vals, int max)
+{
+	int n = 0;
+
+	while (*arg) {
+		char *end;
+		long v = strtol(arg, &end, 0);
+
+		if (end == arg || n == max)
+			return -EINVAL;
+		if (*end == 'K' || *end == 'k')
+			v *= 1024, end++;
+		else if (*end == 'M' || *end == 'm')
+			v *= 1024 * 1024, end++;
+		if (v <= 0 || (*end && *end != ','))
+			return -EINVAL;
+		vals[n++] = v;
+		arg = *end ? end + 1 : end;
+	}
+	return n ? n : -EINVAL;
+}
+
+// ========================= Latency Statistics ===============================
+
+int bench_samples_init(struct bench_samples *s, int cap)
+{
+	s->us = malloc(cap * sizeof(*s->us));
+	s->count = 0;
+	s->cap = s->us ? cap : 0;
+	return s->us ? 0 : -ENOMEM;
+}
+
+void bench_samples_free(struct bench_samples *s)
+{
+	free(s->us);
+	s->us = NULL;
+	s->count = s->cap = 0;
+}
+
+void bench_samples_add(struct bench_samples *s, double us)
+{
+	if (s->count < s->cap)
+		s->us[s->count++] = us;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile of sorted samples */
+static double rank(const struct bench_samples *s, double pct)
+{
+	int i = (int)(pct / 100.0 * s->count + 0.5) - 1;
+
+	if (i < 0)
+		i = 0;
+	if (i >= s->count)
+		i = s->count - 1;
+	return s->us[i];
+}
+
+/* Sorts the samples in place */
+void bench_stats_compute(struct bench_samples *s, struct bench_stats *st)
+{
+	double sum = 0.0;
+
+	memset(st, 0, sizeof(*st));
+	if (!s->count)
+		return;
+	qsort(s->us, s->count, sizeof(*s->us), cmp_double);
+	for (int i = 0; i < s->count; i++)
+		sum += s->us[i];
+	st->count = s->count;
+	st->mean = sum / s->count;
+	st->p50 = rank(s, 50.0);
+	st->p90 = rank(s, 90.0);
+	st->p99 = rank(s, 99.0);
+	st->p999 = rank(s, 99.9);
+	st->max = s->us[s->count - 1];
+}
+
+// ========================= JSON / CSV Output ===============================
+
+/* Integral values (sizes, counts) print without a fraction */
+static void print_num(FILE *fp, double v)
+{
+	fprintf(fp, v == (double)(long long)v ? "%.0f" : "%.3f", v);
+}
+
+static FILE *open_sink(const char *path)
+{
+	FILE *fp;
+
+	if (!path)
+		return NULL;
+	fp = fopen(path, "w");
+	if (!fp)
+		fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+	return fp;
+}
+
+int bench_output_open(struct bench_output *out, const char *bench, const char *transport,
+                      const char *json_path, const char *csv_path)
+{
+	out->rows = 0;
+	out->json = open_sink(json_path);
+	out->csv = open_sink(csv_path);
+	if ((json_path && !out->json) || (csv_path && !out->csv)) {
+		bench_output_close(out);
+		return -EIO;
+	}
+	if (out->json)
+		fprintf(out->json, "{\n  \"bench\": \"%s\",\n  \"transport\": \"%s\",\n  \"results\": [",
+		        bench, transport);
+	return 0;
+}
+
+void bench_output_row(struct bench_output *out, const struct bench_field *fields, int n)
+{
+	if (out->json) {
+		fprintf(out->json, "%s\n    {", out->rows ? "," : "");
+		for (int i = 0; i < n; i++) {
+			fprintf(out->json, "%s\"%s\": ", i ? ", " : "", fields[i].key);
+			if (fields[i].str)
+				fprintf(out->json, "\"%s\"", fields[i].str);
+			else
+				print_num(out->json, fields[i].num);
+		}
+		fprintf(out->json, "}");
+	}
+	if (out->csv) {
+		if (!out->rows)
+			for (int i = 0; i < n; i++)
+				fprintf(out->csv, "%s%s", fields[i].key, i + 1 < n ? "," : "\n");
+		for (int i = 0; i < n; i++) {
+			if (fields[i].str)
+				fprintf(out->csv, "%s", fields[i].str);
+			else
+				print_num(out->csv, fields[i].num);
+			fputc(i + 1 < n ? ',' : '\n', out->csv);
+		}
+	}
+	out->rows++;
+}
+
+void bench_output_close(struct bench_output *out)
+{
+	if (out->json) {
+		fprintf(out->json, "\n  ]\n}\n");
+		fclose(out->json);
+	}
+	if (out->csv)
+		fclose(out->csv);
+	out->json = out->csv = NULL;
+}
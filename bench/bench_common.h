@@ -0,0 +1,53 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BENCH_MAX_LIST		16
+
+/* Latency samples of one configuration, in microseconds */
+struct bench_samples {
+	double *us;
+	int count;
+	int cap;
+};
+
+struct bench_stats {
+	int count;
+	double mean;
+	double p50;
+	double p90;
+	double p99;
+	double p999;
+	double max;
+};
+
+/* One column of a result row; numbers unless str is set */
+struct bench_field {
+	const char *key;
+	const char *str;
+	double num;
+};
+
+/* Result sinks: a JSON array of row objects and a CSV table, either may be NULL */
+struct bench_output {
+	FILE *json;
+	FILE *csv;
+	int rows;
+};
+
+uint64_t bench_now_ns(void);
+int bench_parse_list(const char *arg, int *vals, int max);
+
+int bench_samples_init(struct bench_samples *s, int cap);
+void bench_samples_free(struct bench_samples *s);
+void bench_samples_add(struct bench_samples *s, double us);
+void bench_stats_compute(struct bench_samples *s, struct bench_stats *st);
+
+int bench_output_open(struct bench_output *out, const char *bench, const char *transport,
+                      const char *json_path, const char *csv_path);
+void bench_output_row(struct bench_output *out, const struct bench_field *fields, int n);
+void bench_output_close(struct bench_output *out);
+
+#endif //BENCH_COMMON_H
@@ -0,0 +1,544 @@
+/*
+ * bench_dmabuf: cost of each step of getting a dma-buf ready for the remote
+ * core, per buffer size, and CPU bandwidth into the mapping.
+ *
+ *   alloc   - DMA_HEAP_IOCTL_ALLOC (heap), memfd + UDMABUF_CREATE (udmabuf),
+ *             memfd_create + ftruncate (memfd), private anonymous mmap (malloc)
+ *   attach  - RPROC_IOC_DMA_BUF_ATTACH, heap provider with a remoteproc cdev only
+ *   mmap    - mmap() of the dma-buf
+ *   touch   - first write to every page of a fresh mapping (page faults)
+ *   sync_*  - dmabuf_begin/end_cpu_access() pairs through the library
+ *   init    - dmabuf_heap_init() + dmabuf_heap_destroy(), heap provider only
+ *   write / read / read_stride - CPU bandwidth over a faulted-in mapping
+ *
+ * udmabuf and memfd stand in for a DMA heap on machines without one; memfd
+ * buffers are not dma-bufs, so they have no sync numbers.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-heap.h>
+#include <linux/udmabuf.h>
+#include "dmabuf.h"
+#include "remoteproc_cdev.h"
+#include "transport.h"
+#include "bench_common.h"
+
+#define PAGE_SIZE		4096
+/* Bandwidth points repeat until at least this many bytes went through */
+#define BW_MIN_BYTES		(256 << 20)
+
+enum provider {
+	PROV_HEAP,
+	PROV_UDMABUF,
+	PROV_MEMFD,
+	PROV_MALLOC,
+	PROV_COUNT
+};
+
+static const char *const provider_names[PROV_COUNT] = { "heap", "udmabuf", "memfd", "malloc" };
+
+struct bench_config {
+	char *heap;
+	char *rproc_dev;
+	int sizes[BENCH_MAX_LIST], num_sizes;
+	unsigned providers;		/* 1 << enum provider */
+	int reps;
+	const char *json;
+	const char *csv;
+};
+
+/* Open handles a provider allocates from */
+struct provider_ctx {
+	enum provider prov;
+	int heap_fd;
+	int rproc_fd;			/* -1 when attach cannot be measured */
+	int udmabuf_fd;
+};
+
+/* One allocated buffer; fd is -1 for the malloc baseline */
+struct bench_buf {
+	int fd;
+	int memfd;
+	void *addr;
+	size_t size;
+};
+
+static struct bench_output out;
+
+// ========================= Providers ===============================
+
+static int provider_open(struct provider_ctx *ctx, enum provider prov, const struct bench_config *cfg)
+{
+	char path[128];
+
+	ctx->prov = prov;
+	ctx->heap_fd = ctx->rproc_fd = ctx->udmabuf_fd = -1;
+	switch (prov) {
+	case PROV_HEAP:
+		snprintf(path, sizeof(path), "/dev/dma_heap/%s", cfg->heap);
+		ctx->heap_fd = open(path, O_RDWR | O_CLOEXEC);
+		if (ctx->heap_fd < 0)
+			return -errno;
+		ctx->rproc_fd = open(cfg->rproc_dev, O_RDONLY | O_CLOEXEC);
+		return 0;
+	case PROV_UDMABUF:
+		ctx->udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+		return ctx->udmabuf_fd < 0 ? -errno : 0;
+	default:
+		return 0;
+	}
+}
+
+static void provider_close(struct provider_ctx *ctx)
+{
+	if (ctx->heap_fd >= 0)
+		close(ctx->heap_fd);
+	if (ctx->rproc_fd >= 0)
+		close(ctx->rproc_fd);
+	if (ctx->udmabuf_fd >= 0)
+		close(ctx->udmabuf_fd);
+}
+
+static int buf_alloc(struct provider_ctx *ctx, size_t size, struct bench_buf *b)
+{
+	struct dma_heap_allocation_data heap = {
+		.len = size,
+		.fd_flags = O_RDWR | O_CLOEXEC,
+	};
+	struct udmabuf_create create = { .flags = UDMABUF_FLAGS_CLOEXEC, .size = size };
+
+	memset(b, 0, sizeof(*b));
+	b->fd = b->memfd = -1;
+	b->size = size;
+
+	switch (ctx->prov) {
+	case PROV_HEAP:
+		if (ioctl(ctx->heap_fd, DMA_HEAP_IOCTL_ALLOC, &heap) < 0)
+			return -errno;
+		b->fd = heap.fd;
+		return 0;
+	case PROV_UDMABUF:
+		/* udmabuf needs a shrink-sealed memfd behind it */
+		b->memfd = memfd_create("bench_dmabuf", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		if (b->memfd < 0 || ftruncate(b->memfd, size) < 0 ||
+		    fcntl(b->memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0)
+			break;
+		create.memfd = b->memfd;
+		b->fd = ioctl(ctx->udmabuf_fd, UDMABUF_CREATE, &create);
+		if (b->fd < 0)
+			break;
+		return 0;
+	case PROV_MEMFD:
+		b->fd = memfd_create("bench_dmabuf", MFD_CLOEXEC);
+		if (b->fd < 0 || ftruncate(b->fd, size) < 0)
+			break;
+		return 0;
+	default:
+		/*
+		 * What malloc() does for large blocks, but on every rep: a recycled
+		 * heap block would already be faulted in and hide the touch cost.
+		 */
+		b->addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (b->addr == MAP_FAILED) {
+			b->addr = NULL;
+			return -errno;
+		}
+		return 0;
+	}
+
+	if (b->memfd >= 0)
+		close(b->memfd);
+	if (b->fd >= 0)
+		close(b->fd);
+	return -errno;
+}
+
+static int buf_map(struct bench_buf *b)
+{
+	if (b->fd < 0)
+		return 0;
+	b->addr = mmap(NULL, b->size, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+	if (b->addr == MAP_FAILED) {
+		b->addr = NULL;
+		return -errno;
+	}
+	return 0;
+}
+
+static void buf_free(struct bench_buf *b)
+{
+	if (b->fd < 0) {
+		if (b->addr)
+			munmap(b->addr, b->size);
+	} else {
+		if (b->addr)
+			munmap(b->addr, b->size);
+		close(b->fd);
+	}
+	if (b->memfd >= 0)
+		close(b->memfd);
+}
+
+static void touch_pages(struct bench_buf *b)
+{
+	volatile uint8_t *p = b->addr;
+
+	for (size_t off = 0; off < b->size; off += PAGE_SIZE)
+		p[off] = 1;
+}
+
+// ========================= Measurements ===============================
+
+static void report(enum provider prov, const char *op, int size, struct bench_samples *s,
+                   double mb_s)
+{
+	struct bench_stats st;
+
+	bench_stats_compute(s, &st);
+	if (!st.count)
+		return;
+
+	struct bench_field fields[] = {
+		{ "provider", provider_names[prov] },
+		{ "op", op },
+		{ "size", NULL, size },
+		{ "reps", NULL, st.count },
+		{ "mean_us", NULL, st.mean },
+		{ "p50_us", NULL, st.p50 },
+		{ "p99_us", NULL, st.p99 },
+		{ "max_us", NULL, st.max },
+		{ "mb_per_s", NULL, mb_s },
+	};
+
+	printf("%-7s %-11s %9d: p50 %10.1f p99 %10.1f max %10.1f us", provider_names[prov], op, size,
+	       st.p50, st.p99, st.max);
+	if (mb_s > 0)
+		printf(", %9.1f MB/s", mb_s);
+	printf("\n");
+	bench_output_row(&out, fields, sizeof(fields) / sizeof(fields[0]));
+}
+
+/* Per-step costs of setting up and tearing down a buffer, reps times */
+static void bench_setup(struct provider_ctx *ctx, int size, int reps)
+{
+	enum { STEP_ALLOC, STEP_ATTACH, STEP_MMAP, STEP_TOUCH, STEP_COUNT };
+	static const char *const names[STEP_COUNT] = { "alloc", "attach", "mmap", "touch" };
+	struct bench_samples steps[STEP_COUNT];
+
+	for (int i = 0; i < STEP_COUNT; i++)
+		if (bench_samples_init(&steps[i], reps) < 0)
+			goto out;
+
+	for (int i = 0; i < reps; i++) {
+		struct rproc_dma_buf_attach_data data = { 0 };
+		struct bench_buf b;
+		uint64_t t[STEP_COUNT + 1];
+		int ret;
+
+		t[0] = bench_now_ns();
+		ret = buf_alloc(ctx, size, &b);
+		if (ret < 0) {
+			fprintf(stderr, "%s: alloc of %d bytes failed: %s\n",
+			        provider_names[ctx->prov], size, strerror(-ret));
+			break;
+		}
+		t[1] = bench_now_ns();
+		if (ctx->rproc_fd >= 0) {
+			data.fd = b.fd;
+			if (ioctl(ctx->rproc_fd, RPROC_IOC_DMA_BUF_ATTACH, &data) < 0) {
+				fprintf(stderr, "%s: attach failed, not measuring it: %s\n",
+				        provider_names[ctx->prov], strerror(errno));
+				close(ctx->rproc_fd);
+				ctx->rproc_fd = -1;
+			}
+		}
+		t[2] = bench_now_ns();
+		if (buf_map(&b) < 0) {
+			buf_free(&b);
+			break;
+		}
+		t[3] = bench_now_ns();
+		touch_pages(&b);
+		t[4] = bench_now_ns();
+		buf_free(&b);
+
+		for (int j = 0; j < STEP_COUNT; j++)
+			bench_samples_add(&steps[j], (t[j + 1] - t[j]) / 1e3);
+	}
+
+	for (int j = 0; j < STEP_COUNT; j++) {
+		if (j == STEP_ATTACH && ctx->rproc_fd < 0)
+			continue;
+		if (j == STEP_MMAP && ctx->prov == PROV_MALLOC)
+			continue;
+		report(ctx->prov, names[j], size, &steps[j], 0.0);
+	}
+out:
+	for (int i = 0; i < STEP_COUNT; i++)
+		bench_samples_free(&steps[i]);
+}
+
+/* Library cache maintenance for each CPU access direction */
+static void bench_sync(struct provider_ctx *ctx, struct bench_buf *b, int reps,
+                       struct bench_samples *s)
+{
+	static const struct {
+		const char *op;
+		uint32_t dir;
+	} dirs[] = {
+		{ "sync_read", DMABUF_DIR_READ },
+		{ "sync_write", DMABUF_DIR_WRITE },
+		{ "sync_rw", DMABUF_DIR_RW },
+	};
+	struct dma_buf_params params = {
+		.dma_buf_fd = b->fd,
+		.kern_addr = b->addr,
+		.size = b->size,
+	};
+
+	for (size_t d = 0; d < sizeof(dirs) / sizeof(dirs[0]); d++) {
+		s->count = 0;
+		for (int i = 0; i < reps; i++) {
+			uint64_t t0 = bench_now_ns();
+
+			if (dmabuf_begin_cpu_access(&params, dirs[d].dir) < 0 ||
+			    dmabuf_end_cpu_access(&params, dirs[d].dir) < 0) {
+				fprintf(stderr, "%s: DMA_BUF_IOCTL_SYNC failed: %s\n",
+				        provider_names[ctx->prov], strerror(errno));
+				return;
+			}
+			bench_samples_add(s, (bench_now_ns() - t0) / 1e3);
+		}
+		report(ctx->prov, dirs[d].op, b->size, s, 0.0);
+	}
+}
+
+static uint64_t read_seq(const uint64_t *p, size_t words)
+{
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < words; i++)
+		sum += p[i];
+	return sum;
+}
+
+/* One word per 64-byte line: cost of pulling lines in rather than of the adds */
+static uint64_t read_stride(const uint64_t *p, size_t words)
+{
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < words; i += 8)
+		sum += p[i];
+	return sum;
+}
+
+static void bench_bandwidth(enum provider prov, struct bench_buf *b, struct bench_samples *s)
+{
+	static volatile uint64_t sink;
+	size_t words = b->size / sizeof(uint64_t);
+	int reps = BW_MIN_BYTES / b->size;
+
+	if (reps < 3)
+		reps = 3;
+	if (reps > s->cap)
+		reps = s->cap;
+
+	for (int op = 0; op < 3; op++) {
+		static const char *const names[] = { "write", "read", "read_stride" };
+		uint64_t total = 0;
+
+		s->count = 0;
+		for (int i = 0; i < reps; i++) {
+			uint64_t t0 = bench_now_ns(), ns;
+
+			if (op == 0)
+				memset(b->addr, i, b->size);
+			else if (op == 1)
+				sink += read_seq(b->addr, words);
+			else
+				sink += read_stride(b->addr, words);
+			ns = bench_now_ns() - t0;
+			total += ns;
+			bench_samples_add(s, ns / 1e3);
+		}
+		report(prov, names[op], b->size, s, total ? (double)b->size * reps / (total / 1e9) / 1e6 : 0.0);
+	}
+}
+
+/* Library path end to end: open heap + rproc, alloc, attach, map, close */
+static void bench_heap_init(const struct bench_config *cfg, int size, int reps,
+                            struct bench_samples *s)
+{
+	struct dma_buf_params params;
+
+	s->count = 0;
+	for (int i = 0; i < reps; i++) {
+		uint64_t t0 = bench_now_ns();
+
+		if (dmabuf_heap_init(cfg->heap, size, cfg->rproc_dev, &params) < 0)
+			return;
+		dmabuf_heap_destroy(&params);
+		bench_samples_add(s, (bench_now_ns() - t0) / 1e3);
+	}
+	report(PROV_HEAP, "init", size, s, 0.0);
+}
+
+static void bench_provider(const struct bench_config *cfg, enum provider prov)
+{
+	struct bench_samples samples;
+	struct provider_ctx ctx;
+	int ret = provider_open(&ctx, prov, cfg);
+
+	if (ret < 0) {
+		printf("%-7s skipped: %s\n", provider_names[prov], strerror(-ret));
+		return;
+	}
+	if (bench_samples_init(&samples, BW_MIN_BYTES / PAGE_SIZE) < 0) {
+		provider_close(&ctx);
+		return;
+	}
+
+	for (int i = 0; i < cfg->num_sizes; i++) {
+		int size = cfg->sizes[i];
+		struct bench_buf b;
+
+		bench_setup(&ctx, size, cfg->reps);
+
+		if (buf_alloc(&ctx, size, &b) < 0 || buf_map(&b) < 0) {
+			fprintf(stderr, "%s: cannot map %d bytes\n", provider_names[prov], size);
+			continue;
+		}
+		touch_pages(&b);
+		if (prov == PROV_HEAP || prov == PROV_UDMABUF)
+			bench_sync(&ctx, &b, cfg->reps, &samples);
+		bench_bandwidth(prov, &b, &samples);
+		buf_free(&b);
+
+		if (prov == PROV_HEAP && ctx.rproc_fd >= 0)
+			bench_heap_init(cfg, size, cfg->reps, &samples);
+	}
+	bench_samples_free(&samples);
+	provider_close(&ctx);
+}
+
+// ========================= Command Line ===============================
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  -p, --providers LIST   heap,udmabuf,memfd,malloc (default all, unavailable ones skipped)\n"
+	       "  -b, --sizes LIST       buffer sizes, K/M suffixes allowed (default 4K,16K,64K,256K,1M,4M,16M,64M)\n"
+	       "  -n, --reps N           repetitions of each setup and sync step (default 20)\n"
+	       "      --heap NAME        DMA heap (default linux,cma)\n"
+	       "      --rproc-dev PATH   remoteproc cdev for attach (default /dev/remoteproc0)\n"
+	       "      --json FILE        write results as JSON\n"
+	       "      --csv FILE         write results as CSV\n",
+	       prog);
+}
+
+static int parse_providers(const char *arg, unsigned *providers)
+{
+	char buf[64], *tok, *save;
+
+	snprintf(buf, sizeof(buf), "%s", arg);
+	*providers = 0;
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		int p;
+
+		for (p = 0; p < PROV_COUNT; p++)
+			if (strcmp(tok, provider_names[p]) == 0)
+				break;
+		if (p == PROV_COUNT)
+			return -EINVAL;
+		*providers |= 1u << p;
+	}
+	return *providers ? 0 : -EINVAL;
+}
+
+enum {
+	OPT_HEAP = 256,
+	OPT_RPROC_DEV,
+	OPT_JSON,
+	OPT_CSV,
+};
+
+static int parse_args(int argc, char **argv, struct bench_config *cfg)
+{
+	static const struct option opts[] = {
+		{ "providers", required_argument, NULL, 'p' },
+		{ "sizes", required_argument, NULL, 'b' },
+		{ "reps", required_argument, NULL, 'n' },
+		{ "heap", required_argument, NULL, OPT_HEAP },
+		{ "rproc-dev", required_argument, NULL, OPT_RPROC_DEV },
+		{ "json", required_argument, NULL, OPT_JSON },
+		{ "csv", required_argument, NULL, OPT_CSV },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int c, ret = 0;
+
+	while ((c = getopt_long(argc, argv, "p:b:n:h", opts, NULL)) != -1) {
+		switch (c) {
+		case 'p': ret = parse_providers(optarg, &cfg->providers); break;
+		case 'b': ret = cfg->num_sizes = bench_parse_list(optarg, cfg->sizes, BENCH_MAX_LIST); break;
+		case 'n': cfg->reps = atoi(optarg); break;
+		case OPT_HEAP: cfg->heap = optarg; break;
+		case OPT_RPROC_DEV: cfg->rproc_dev = optarg; break;
+		case OPT_JSON: cfg->json = optarg; break;
+		case OPT_CSV: cfg->csv = optarg; break;
+		default:
+			usage(argv[0]);
+			return -EINVAL;
+		}
+		if (ret < 0) {
+			fprintf(stderr, "Invalid argument for -%c: %s\n", c < 256 ? c : '-', optarg);
+			return ret;
+		}
+	}
+	if (cfg->reps < 1 || cfg->reps > BW_MIN_BYTES / PAGE_SIZE) {
+		fprintf(stderr, "Invalid repetition count\n");
+		return -EINVAL;
+	}
+	for (int i = 0; i < cfg->num_sizes; i++) {
+		if (cfg->sizes[i] % PAGE_SIZE) {
+			fprintf(stderr, "Size %d is not a multiple of %d\n", cfg->sizes[i], PAGE_SIZE);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_config cfg = {
+		.heap = "linux,cma",
+		.rproc_dev = "/dev/remoteproc0",
+		.sizes = { 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20, 64 << 20 },
+		.num_sizes = 8,
+		.providers = (1u << PROV_COUNT) - 1,
+		.reps = 20,
+	};
+
+	if (parse_args(argc, argv, &cfg) < 0)
+		return 1;
+	/* Sync goes through the real DMA_BUF_IOCTL_SYNC path, whatever the environment says */
+	if (transport_select("rpmsg") < 0)
+		return 1;
+	if (bench_output_open(&out, "bench_dmabuf", "rpmsg", cfg.json, cfg.csv) < 0)
+		return 1;
+
+	for (int p = 0; p < PROV_COUNT; p++)
+		if (cfg.providers & (1u << p))
+			bench_provider(&cfg, p);
+
+	bench_output_close(&out);
+	return 0;
+}
@@ -0,0 +1,514 @@
+/*
+ * bench_rpmsg_dma: IPC round-trip latency and throughput of the rpmsg/dma-buf
+ * library, swept over message size, buffer size, batch depth and sync mode.
+ *
+ *   sync  - send_msg()/recv_msg() on the endpoint, one message at a time
+ *   async - rpmsg_async_submit()/wait() with <depth> requests in flight
+ *   batch - rpmsg_async_submit_batch() of <depth> buffers per message
+ *
+ * Every job syncs its dma-buf for the device before sending and for the CPU
+ * after the reply, as a real client does. Runs against the C7x ("rpmsg") or
+ * the simulated DSP ("loopback"). No stage touches the payload, so the
+ * MB/s column is nominal: buffer bytes described per second, not moved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include "rpmsg.h"
+#include "rpmsg_async.h"
+#include "dmabuf.h"
+#include "transport.h"
+#include "bench_common.h"
+
+#define BENCH_TIMEOUT_MS	2000
+
+enum bench_mode {
+	MODE_SYNC,
+	MODE_ASYNC,
+	MODE_BATCH,
+	MODE_COUNT
+};
+
+static const char *const mode_names[MODE_COUNT] = { "sync", "async", "batch" };
+
+struct bench_config {
+	const char *transport;
+	int rproc_id;
+	int ept;
+	char *heap;
+	char *rproc_dev;
+	int iters;
+	int warmup;
+	int msg_sizes[BENCH_MAX_LIST], num_msg_sizes;
+	int buf_sizes[BENCH_MAX_LIST], num_buf_sizes;
+	int depths[BENCH_MAX_LIST], num_depths;
+	unsigned modes;			/* 1 << enum bench_mode */
+	const char *json;
+	const char *csv;
+	struct loopback_model model;
+};
+
+/* One sweep point; msgs/jobs/elapsed are filled by the run */
+struct bench_run {
+	enum bench_mode mode;
+	int msg_size;
+	int buf_size;
+	int depth;
+	long msgs;
+	long jobs;
+	uint64_t elapsed_ns;
+};
+
+static void sync_for_device(struct dma_buf_params *buf)
+{
+	dmabuf_begin_cpu_access(buf, DMABUF_DIR_WRITE);
+	dmabuf_end_cpu_access(buf, DMABUF_DIR_WRITE);
+}
+
+static void sync_for_cpu(struct dma_buf_params *buf)
+{
+	dmabuf_begin_cpu_access(buf, DMABUF_DIR_READ);
+	dmabuf_end_cpu_access(buf, DMABUF_DIR_READ);
+}
+
+static void fill_msg(ipc_msg_buf_t *msg, struct dma_buf_params *buf, int size)
+{
+	memset(msg, 0, sizeof(*msg));
+	msg->data_buffer = (uint32_t)buf->phys_addr;
+	msg->data_size = size;
+}
+
+// ========================= Benchmark Modes ===============================
+
+static int run_sync(int fd, struct dmabuf_pool *pool, struct bench_run *run, int iters,
+                    struct bench_samples *samples)
+{
+	char msg[RPMSG_MAX_MSG_LEN] = { 0 }, reply[RPMSG_MAX_MSG_LEN];
+	struct dma_buf_params *buf = &pool->bufs[0];
+	int reply_len;
+
+	for (int i = 0; i < iters; i++) {
+		uint64_t t0 = bench_now_ns();
+
+		fill_msg((ipc_msg_buf_t *)msg, buf, run->buf_size);
+		((ipc_msg_buf_t *)msg)->seq = i;
+		sync_for_device(buf);
+		if (send_msg(fd, msg, run->msg_size) < 0 ||
+		    recv_msg(fd, sizeof(reply), reply, &reply_len) < 0 || reply_len <= 0)
+			return -EIO;
+		sync_for_cpu(buf);
+		if (samples)
+			bench_samples_add(samples, (bench_now_ns() - t0) / 1e3);
+	}
+	run->msgs += iters;
+	run->jobs += iters;
+	return 0;
+}
+
+/* Keeps depth requests in flight, each on its own buffer, and waits in submission order */
+static int run_async(struct rpmsg_async *as, struct dmabuf_pool *pool, struct bench_run *run,
+                     int iters, struct bench_samples *samples)
+{
+	uint32_t tickets[RPMSG_ASYNC_MAX_INFLIGHT];
+	uint64_t start[RPMSG_ASYNC_MAX_INFLIGHT];
+	int submitted = 0, done = 0, ret;
+	ipc_msg_buf_t msg, reply;
+
+	while (done < iters) {
+		while (submitted < iters && submitted - done < run->depth) {
+			int slot = submitted % run->depth;
+			struct dma_buf_params *buf = &pool->bufs[slot];
+
+			start[slot] = bench_now_ns();
+			fill_msg(&msg, buf, run->buf_size);
+			sync_for_device(buf);
+			ret = rpmsg_async_submit(as, &msg, NULL, &tickets[slot]);
+			if (ret < 0)
+				return ret;
+			submitted++;
+		}
+
+		int slot = done % run->depth;
+
+		ret = rpmsg_async_wait(as, tickets[slot], &reply, BENCH_TIMEOUT_MS);
+		if (ret < 0)
+			return ret;
+		sync_for_cpu(&pool->bufs[slot]);
+		if (samples)
+			bench_samples_add(samples, (bench_now_ns() - start[slot]) / 1e3);
+		done++;
+	}
+	run->msgs += iters;
+	run->jobs += iters;
+	return 0;
+}
+
+/* One message and one completion for depth buffers; latency is per batch */
+static int run_batch(struct rpmsg_async *as, struct dmabuf_pool *pool, struct bench_run *run,
+                     int iters, struct bench_samples *samples)
+{
+	ipc_batch_entry_t entries[IPC_BATCH_MAX_INLINE];
+	ipc_batch_hdr_t hdr, reply;
+	uint32_t ticket;
+	int ret;
+
+	for (int j = 0; j < run->depth; j++) {
+		entries[j].data_buffer = (uint32_t)pool->bufs[j].phys_addr;
+		entries[j].data_size = run->buf_size;
+		entries[j].graph_id = 0;
+	}
+
+	for (int i = 0; i < iters; i++) {
+		uint64_t t0 = bench_now_ns();
+
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.count = run->depth;
+		for (int j = 0; j < run->depth; j++)
+			sync_for_device(&pool->bufs[j]);
+		ret = rpmsg_async_submit_batch(as, &hdr, entries, NULL, NULL, &ticket);
+		if (ret < 0)
+			return ret;
+		ret = rpmsg_async_wait_batch(as, ticket, &reply, BENCH_TIMEOUT_MS);
+		if (ret < 0)
+			return ret;
+		if (reply.status != 0)
+			return -EIO;
+		for (int j = 0; j < run->depth; j++)
+			sync_for_cpu(&pool->bufs[j]);
+		if (samples)
+			bench_samples_add(samples, (bench_now_ns() - t0) / 1e3);
+	}
+	run->msgs += iters;
+	run->jobs += (long)iters * run->depth;
+	return 0;
+}
+
+static int run_mode(int fd, struct rpmsg_async *as, struct dmabuf_pool *pool,
+                    struct bench_run *run, int iters, struct bench_samples *samples)
+{
+	switch (run->mode) {
+	case MODE_SYNC:
+		return run_sync(fd, pool, run, iters, samples);
+	case MODE_ASYNC:
+		return run_async(as, pool, run, iters, samples);
+	default:
+		return run_batch(as, pool, run, iters, samples);
+	}
+}
+
+// ========================= Sweep & Report ===============================
+
+static void report(struct bench_output *out, const struct bench_run *run, struct bench_stats *st)
+{
+	double secs = run->elapsed_ns / 1e9;
+	double msgs_s = secs > 0 ? run->msgs / secs : 0.0;
+	/* Descriptor throughput: buffers referenced per second, the payload is never touched */
+	double desc_mb_s = secs > 0 ? (double)run->jobs * run->buf_size / secs / 1e6 : 0.0;
+	struct bench_field fields[] = {
+		{ "mode", mode_names[run->mode] },
+		{ "msg_size", NULL, run->msg_size },
+		{ "buf_size", NULL, run->buf_size },
+		{ "depth", NULL, run->depth },
+		{ "msgs", NULL, run->msgs },
+		{ "jobs", NULL, run->jobs },
+		{ "lat_mean_us", NULL, st->mean },
+		{ "lat_p50_us", NULL, st->p50 },
+		{ "lat_p90_us", NULL, st->p90 },
+		{ "lat_p99_us", NULL, st->p99 },
+		{ "lat_p999_us", NULL, st->p999 },
+		{ "lat_max_us", NULL, st->max },
+		{ "msgs_per_s", NULL, msgs_s },
+		{ "desc_mb_per_s", NULL, desc_mb_s },
+	};
+
+	printf("%-5s msg %4d buf %8d depth %2d: p50 %8.1f p99 %8.1f p99.9 %8.1f max %8.1f us,"
+	       " %9.0f msg/s, %8.1f MB/s described\n",
+	       mode_names[run->mode], run->msg_size, run->buf_size, run->depth,
+	       st->p50, st->p99, st->p999, st->max, msgs_s, desc_mb_s);
+	bench_output_row(out, fields, sizeof(fields) / sizeof(fields[0]));
+}
+
+static int bench_point(const struct bench_config *cfg, int fd, struct rpmsg_async *as,
+                       struct dmabuf_pool *pool, struct bench_run *run,
+                       struct bench_output *out, struct bench_samples *samples)
+{
+	struct bench_stats st;
+	uint64_t t0;
+	int ret;
+
+	ret = run_mode(fd, as, pool, run, cfg->warmup, NULL);
+	if (ret < 0)
+		return ret;
+	run->msgs = run->jobs = 0;
+	samples->count = 0;
+
+	t0 = bench_now_ns();
+	ret = run_mode(fd, as, pool, run, cfg->iters, samples);
+	run->elapsed_ns = bench_now_ns() - t0;
+	if (ret < 0)
+		return ret;
+
+	bench_stats_compute(samples, &st);
+	report(out, run, &st);
+	return 0;
+}
+
+static int max_depth(const struct bench_config *cfg)
+{
+	int depth = 1;
+
+	for (int i = 0; i < cfg->num_depths; i++)
+		if (cfg->depths[i] > depth)
+			depth = cfg->depths[i];
+	return depth;
+}
+
+static int sweep(const struct bench_config *cfg, int fd, struct rpmsg_async *as,
+                 struct bench_output *out)
+{
+	struct bench_samples samples;
+	struct dmabuf_pool pool;
+	int nbufs = max_depth(cfg), ret = 0;
+
+	if (bench_samples_init(&samples, cfg->iters) < 0)
+		return -ENOMEM;
+
+	for (int b = 0; b < cfg->num_buf_sizes && ret == 0; b++) {
+		if (dmabuf_pool_init(cfg->heap, cfg->buf_sizes[b], nbufs, cfg->rproc_dev, &pool) < 0) {
+			fprintf(stderr, "Cannot allocate %d x %d byte dma-bufs\n", nbufs, cfg->buf_sizes[b]);
+			ret = -ENOMEM;
+			break;
+		}
+		for (int m = 0; m < MODE_COUNT && ret == 0; m++) {
+			int n = m == MODE_SYNC ? cfg->num_msg_sizes : cfg->num_depths;
+
+			if (!(cfg->modes & (1u << m)))
+				continue;
+			for (int i = 0; i < n && ret == 0; i++) {
+				struct bench_run run = { .mode = m, .buf_size = cfg->buf_sizes[b], .depth = 1 };
+
+				if (m == MODE_SYNC) {
+					run.msg_size = cfg->msg_sizes[i];
+				} else {
+					run.depth = cfg->depths[i];
+					run.msg_size = m == MODE_ASYNC ? (int)sizeof(ipc_msg_buf_t) :
+					        (int)(sizeof(ipc_batch_hdr_t) + run.depth * sizeof(ipc_batch_entry_t));
+				}
+				ret = bench_point(cfg, fd, as, &pool, &run, out, &samples);
+				if (ret < 0)
+					fprintf(stderr, "%s msg %d buf %d depth %d failed: %d\n",
+					        mode_names[m], run.msg_size, run.buf_size, run.depth, ret);
+			}
+		}
+		dmabuf_pool_destroy(&pool);
+	}
+	bench_samples_free(&samples);
+	return ret;
+}
+
+// ========================= Command Line ===============================
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  -t, --transport NAME   rpmsg or loopback (default: $RPMSG_DMA_TRANSPORT, else rpmsg)\n"
+	       "      --rproc-id N       remote processor id (default 8)\n"
+	       "      --ept N            remote endpoint (default 14)\n"
+	       "      --heap NAME        DMA heap (default linux,cma)\n"
+	       "      --rproc-dev PATH   remoteproc cdev (default /dev/remoteproc0)\n"
+	       "  -n, --iters N          measured messages per point (default 1000)\n"
+	       "  -w, --warmup N         unmeasured messages per point (default 100)\n"
+	       "  -m, --msg-sizes LIST   sync mode message sizes in bytes (default 24,128,496)\n"
+	       "  -b, --buf-sizes LIST   dma-buf sizes, K/M suffixes allowed (default 4K,64K,1M)\n"
+	       "  -d, --depths LIST      async in-flight / batch depths (default 1,4,16)\n"
+	       "  -s, --modes LIST       sync,async,batch (default all)\n"
+	       "      --json FILE        write results as JSON\n"
+	       "      --csv FILE         write results as CSV\n"
+	       "      --fixed-us N, --ns-per-kb N, --jitter-us N, --job-us N\n"
+	       "                         compute-time model of the loopback DSP (default 0)\n",
+	       prog);
+}
+
+static int parse_modes(const char *arg, unsigned *modes)
+{
+	char buf[64], *tok, *save;
+
+	snprintf(buf, sizeof(buf), "%s", arg);
+	*modes = 0;
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		int m;
+
+		for (m = 0; m < MODE_COUNT; m++)
+			if (strcmp(tok, mode_names[m]) == 0)
+				break;
+		if (m == MODE_COUNT)
+			return -EINVAL;
+		*modes |= 1u << m;
+	}
+	return *modes ? 0 : -EINVAL;
+}
+
+static int check_config(struct bench_config *cfg)
+{
+	for (int i = 0; i < cfg->num_msg_sizes; i++) {
+		if (cfg->msg_sizes[i] < (int)sizeof(ipc_msg_buf_t) || cfg->msg_sizes[i] > RPMSG_MAX_MSG_LEN) {
+			fprintf(stderr, "Message size %d outside %zu..%d\n", cfg->msg_sizes[i],
+			        sizeof(ipc_msg_buf_t), RPMSG_MAX_MSG_LEN);
+			return -EINVAL;
+		}
+	}
+	for (int i = 0; i < cfg->num_depths; i++) {
+		int limit = IPC_BATCH_MAX_INLINE;
+
+		if ((cfg->modes & (1u << MODE_ASYNC)) && limit > RPMSG_ASYNC_MAX_INFLIGHT)
+			limit = RPMSG_ASYNC_MAX_INFLIGHT;
+		if (cfg->depths[i] > limit) {
+			fprintf(stderr, "Depth %d above the limit of %d\n", cfg->depths[i], limit);
+			return -EINVAL;
+		}
+	}
+	if (cfg->iters < 1 || cfg->warmup < 0) {
+		fprintf(stderr, "Invalid iteration counts\n");
+		return -EINVAL;
+	}
+	return 0;
+}
+
+enum {
+	OPT_RPROC_ID = 256,
+	OPT_EPT,
+	OPT_HEAP,
+	OPT_RPROC_DEV,
+	OPT_JSON,
+	OPT_CSV,
+	OPT_FIXED_US,
+	OPT_NS_PER_KB,
+	OPT_JITTER_US,
+	OPT_JOB_US,
+};
+
+static int parse_args(int argc, char **argv, struct bench_config *cfg)
+{
+	static const struct option opts[] = {
+		{ "transport", required_argument, NULL, 't' },
+		{ "rproc-id", required_argument, NULL, OPT_RPROC_ID },
+		{ "ept", required_argument, NULL, OPT_EPT },
+		{ "heap", required_argument, NULL, OPT_HEAP },
+		{ "rproc-dev", required_argument, NULL, OPT_RPROC_DEV },
+		{ "iters", required_argument, NULL, 'n' },
+		{ "warmup", required_argument, NULL, 'w' },
+		{ "msg-sizes", required_argument, NULL, 'm' },
+		{ "buf-sizes", required_argument, NULL, 'b' },
+		{ "depths", required_argument, NULL, 'd' },
+		{ "modes", required_argument, NULL, 's' },
+		{ "json", required_argument, NULL, OPT_JSON },
+		{ "csv", required_argument, NULL, OPT_CSV },
+		{ "fixed-us", required_argument, NULL, OPT_FIXED_US },
+		{ "ns-per-kb", required_argument, NULL, OPT_NS_PER_KB },
+		{ "jitter-us", required_argument, NULL, OPT_JITTER_US },
+		{ "job-us", required_argument, NULL, OPT_JOB_US },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int c, ret = 0;
+
+	while ((c = getopt_long(argc, argv, "t:n:w:m:b:d:s:h", opts, NULL)) != -1) {
+		switch (c) {
+		case 't': cfg->transport = optarg; break;
+		case OPT_RPROC_ID: cfg->rproc_id = atoi(optarg); break;
+		case OPT_EPT: cfg->ept = atoi(optarg); break;
+		case OPT_HEAP: cfg->heap = optarg; break;
+		case OPT_RPROC_DEV: cfg->rproc_dev = optarg; break;
+		case 'n': cfg->iters = atoi(optarg); break;
+		case 'w': cfg->warmup = atoi(optarg); break;
+		case 'm':
+			ret = cfg->num_msg_sizes = bench_parse_list(optarg, cfg->msg_sizes, BENCH_MAX_LIST);
+			break;
+		case 'b':
+			ret = cfg->num_buf_sizes = bench_parse_list(optarg, cfg->buf_sizes, BENCH_MAX_LIST);
+			break;
+		case 'd':
+			ret = cfg->num_depths = bench_parse_list(optarg, cfg->depths, BENCH_MAX_LIST);
+			break;
+		case 's': ret = parse_modes(optarg, &cfg->modes); break;
+		case OPT_JSON: cfg->json = optarg; break;
+		case OPT_CSV: cfg->csv = optarg; break;
+		case OPT_FIXED_US: cfg->model.fixed_us = atoi(optarg); break;
+		case OPT_NS_PER_KB: cfg->model.ns_per_kb = atoi(optarg); break;
+		case OPT_JITTER_US: cfg->model.jitter_us = atoi(optarg); break;
+		case OPT_JOB_US: cfg->model.job_us = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return -EINVAL;
+		}
+		if (ret < 0) {
+			fprintf(stderr, "Invalid argument for -%c: %s\n", c < 256 ? c : '-', optarg);
+			return ret;
+		}
+	}
+	return check_config(cfg);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_config cfg = {
+		.rproc_id = 8,
+		.ept = 14,
+		.heap = "linux,cma",
+		.rproc_dev = "/dev/remoteproc0",
+		.iters = 1000,
+		.warmup = 100,
+		.msg_sizes = { sizeof(ipc_msg_buf_t), 128, RPMSG_MAX_MSG_LEN },
+		.num_msg_sizes = 3,
+		.buf_sizes = { 4096, 65536, 1048576 },
+		.num_buf_sizes = 3,
+		.depths = { 1, 4, 16 },
+		.num_depths = 3,
+		.modes = (1u << MODE_COUNT) - 1,
+	};
+	struct bench_output out;
+	struct rpmsg_async as;
+	int fd, ret;
+
+	if (parse_args(argc, argv, &cfg) < 0)
+		return 1;
+	if (cfg.transport && transport_select(cfg.transport) < 0)
+		return 1;
+	if (strcmp(transport_name(), "loopback") == 0)
+		loopback_set_model(&cfg.model);
+
+	fd = init_rpmsg(cfg.rproc_id, cfg.ept);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open rpmsg endpoint %d on rproc %d\n", cfg.ept, cfg.rproc_id);
+		return 1;
+	}
+	if (rpmsg_async_init(&as, fd) < 0) {
+		cleanup_rpmsg(fd);
+		return 1;
+	}
+	if ((cfg.modes & (1u << MODE_BATCH)) && rpmsg_async_probe(&as, BENCH_TIMEOUT_MS) != RPMSG_ABI_TAGGED) {
+		fprintf(stderr, "Remote side does not echo seq, skipping batch mode\n");
+		cfg.modes &= ~(1u << MODE_BATCH);
+		if (!cfg.modes) {
+			rpmsg_async_destroy(&as);
+			cleanup_rpmsg(fd);
+			return 1;
+		}
+	}
+	if (bench_output_open(&out, "bench_rpmsg_dma", transport_name(), cfg.json, cfg.csv) < 0) {
+		rpmsg_async_destroy(&as);
+		cleanup_rpmsg(fd);
+		return 1;
+	}
+
+	printf("bench_rpmsg_dma: transport %s, %d iterations (+%d warmup) per point\n",
+	       transport_name(), cfg.iters, cfg.warmup);
+	ret = sweep(&cfg, fd, &as, &out);
+
+	bench_output_close(&out);
+	rpmsg_async_destroy(&as);
+	cleanup_rpmsg(fd);
+	return ret < 0 ? 1 : 0;
+}
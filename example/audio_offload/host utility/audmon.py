@@ -13,6 +13,7 @@ from tkinter.scrolledtext import ScrolledText
 from tkinter import ttk
 import datetime
 import socket
+import struct
 from collections import deque
 import numpy as np
 import matplotlib.ticker as ticker
@@ -387,45 +388,39 @@ def outrecv_exact(size):
         buf += chunk
     return buf
 
+TAP_HEADER = struct.Struct("<4sIQIHH")  # tag, seq, ts_ns, channel_mask, frames, reserved
+
+def read_tap_frames(recv_exact, tag, samples, name):
+    """Read framed tap data and append the first channel to samples."""
+    last_seq = None
+    while True:
+        header = recv_exact(TAP_HEADER.size)
+        if not header:
+            break
+        htag, seq, ts_ns, mask, frames, _ = TAP_HEADER.unpack(header)
+        if htag != tag:
+            print(f"[{name} WARN] Unknown tag: {htag}, stream lost sync")
+            break
+        data = recv_exact(bin(mask).count("1") * frames * 2)
+        if not data:
+            break
+        if last_seq is not None and seq != last_seq + 1:
+            log_debug(f"[{name}] {seq - last_seq - 1} tap frames dropped")
+        last_seq = seq
+        if mask == 0:
+            continue
+        # Payload is planar, lowest channel first
+        ch0_samples = np.frombuffer(data[:frames * 2], dtype=np.int16).tolist()
+        with waveform_lock:
+            samples.extend(ch0_samples)
+
 def read_input_audio_samples():
     """Read input audio samples from socket and add to global buffer."""
-    while True:
-        if connected_input_data:
-            header = inrecv_exact(4)
-            if not header:
-                break
-            if header != b'INPT':
-                print(f"[INPUT WARN] Unknown tag: {header}")
-                continue
-            data = inrecv_exact(512)
-            if not data:
-                break
-            samples = np.frombuffer(data, dtype=np.int16)
-            ch0_samples = samples.tolist()
-
-            # Add to waveform_insamples
-            with waveform_lock:
-                waveform_insamples.extend(ch0_samples)
+    read_tap_frames(inrecv_exact, b'INPT', waveform_insamples, "INPUT")
 
 def read_output_audio_samples():
     """Read output audio samples from socket and add to global buffer."""
-    while True:
-        if connected_output_data:
-            header = outrecv_exact(4)
-            if not header:
-                break
-            if header != b'OUTP':
-                print(f"[OUTPUT WARN] Unknown tag: {header}")
-                continue
-            data = outrecv_exact(512)
-            if not data:
-                break
-            samples = np.frombuffer(data, dtype=np.int16)
-            ch0_samples = samples.tolist()
-
-            # Add to waveform_insamples
-            with waveform_lock:
-                waveform_outsamples.extend(ch0_samples)
+    read_tap_frames(outrecv_exact, b'OUTP', waveform_outsamples, "OUTPUT")
 
 def read_data():
     """Read logs from socket and add to global buffers."""
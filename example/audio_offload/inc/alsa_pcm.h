@@ -0,0 +1,57 @@
+#ifndef ALSA_PCM_H
+#define ALSA_PCM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+
+/*
+ * An ALSA stream with explicit period/buffer sizing. With mmap access the
+ * frames are copied straight to/from the hardware ring, otherwise through
+ * snd_pcm_writei()/readi(). Xruns are recovered in place and counted.
+ */
+struct alsa_pcm {
+	snd_pcm_t *handle;
+	const char *name;		/* "playback" or "capture", for logs */
+	bool capture;
+	int channels;
+	int frame_bytes;
+	unsigned int rate;
+	bool mmap;
+	snd_pcm_uframes_t period;
+	snd_pcm_uframes_t buffer;
+	snd_pcm_uframes_t start;	/* start threshold */
+	struct alsa_pcm *linked;	/* other half of a full-duplex pair */
+	int16_t *silence;		/* one period, playback side of a linked pair */
+
+	/* Written by the streaming thread, read by log_alsa_stats() */
+	unsigned long xruns;
+	unsigned long frames;
+	long max_delay;			/* frames queued ahead of the DAC / behind the ADC */
+	uint64_t delay_sum;
+	unsigned long delay_count;
+	/* Playback: ADC-to-DAC time of the frames that carried a capture timestamp */
+	uint64_t rtt_sum_us;
+	unsigned long rtt_count;
+	long rtt_min_us;
+	long rtt_max_us;
+
+	/* log_alsa_stats() only */
+	uint64_t logged_sum;
+	unsigned long logged_count;
+	uint64_t logged_rtt_sum;
+	unsigned long logged_rtt_count;
+};
+
+int alsa_pcm_open(struct alsa_pcm *p, const char *device, snd_pcm_stream_t stream,
+                  int channels, unsigned int rate, int period, int periods, int start_periods,
+                  bool mmap);
+int alsa_pcm_link(struct alsa_pcm *capture, struct alsa_pcm *playback);
+int alsa_pcm_write(struct alsa_pcm *p, const int16_t *data, int frames,
+                   const struct timespec *t_capture);
+int alsa_pcm_read(struct alsa_pcm *p, int16_t *data, int frames, struct timespec *t_capture);
+void alsa_pcm_close(struct alsa_pcm *p);
+void log_alsa_stats(struct alsa_pcm *p);
+
+#endif //ALSA_PCM_H
@@ -0,0 +1,46 @@
+#ifndef AUDIO_KERNELS_H
+#define AUDIO_KERNELS_H
+
+#include <stdint.h>
+
+/*
+ * Sample format kernels shared by the ARM processing path and the host taps.
+ * Planar buffers hold one contiguous run of frames per channel:
+ * planar[ch * frames + i] <-> interleaved[i * channels + ch].
+ */
+
+/* (De)interleave compiled for one fixed channel count and block size */
+struct audio_block_kernels {
+	int channels;
+	int frames;
+	void (*deinterleave_s16)(int16_t *planar, const int16_t *interleaved);
+	void (*interleave_s16)(int16_t *interleaved, const int16_t *planar);
+};
+
+struct audio_kernels {
+	const char *name;
+	void (*deinterleave_s16)(int16_t *planar, const int16_t *interleaved, int channels, int frames);
+	void (*interleave_s16)(int16_t *interleaved, const int16_t *planar, int channels, int frames);
+	/* dst[i] = src[i] * scale */
+	void (*s16_to_f32)(float *dst, const int16_t *src, int n, float scale);
+	/* dst[i] = src[i] * scale, clamped to int16 range and truncated toward zero */
+	void (*f32_to_s16)(int16_t *dst, const float *src, int n, float scale);
+	/* 2/8/16 channels x 64/128/256/512 frames */
+	const struct audio_block_kernels *blocks;
+	int num_blocks;
+};
+
+int audio_kernels_init(void);
+const struct audio_kernels *audio_kernels_get(void);
+
+/*
+ * Bind the specialized kernels for the stream geometry, if there are any.
+ * Returns 1 when specialized, 0 when the generic kernels will be used.
+ */
+int audio_kernels_bind(int channels, int frames);
+
+/* The bound block kernels when the geometry matches, the generic ones otherwise */
+void audio_deinterleave_s16(int16_t *planar, const int16_t *interleaved, int channels, int frames);
+void audio_interleave_s16(int16_t *interleaved, const int16_t *planar, int channels, int frames);
+
+#endif //AUDIO_KERNELS_H
@@ -0,0 +1,32 @@
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include <stdint.h>
+#include <time.h>
+#include "alsa_pcm.h"
+
+/*
+ * Where the read stage gets its frames (AUDIO_SOURCE):
+ *   "file"    - SAMPLE_AUDIO_FILE through libsndfile, ends at end of file
+ *   "capture" - live ALSA capture from CAPTURE_DEVICE, linked to playback
+ */
+struct audio_source {
+	const char *name;
+	/* Optional: the format the source delivers, filled in before anything is opened */
+	int (*probe)(int *channels, unsigned int *rate);
+	/* sink is the opened playback stream, for sources that share its clock; NULL offline */
+	int (*open)(int channels, unsigned int rate, struct alsa_pcm *sink);
+	/*
+	 * Fills data with up to `frames` interleaved frames, straight into the
+	 * slot's dma-buf. Returns the frames read, fewer at end of stream. A
+	 * zero t_capture means the source has no ADC time for the frame.
+	 */
+	int (*read)(int16_t *data, int frames, struct timespec *t_capture);
+	void (*close)(void);
+	/* Optional, called from the complete stage with the other periodic stats */
+	void (*log_stats)(void);
+};
+
+const struct audio_source *audio_source_select(const char *name);
+
+#endif //AUDIO_SOURCE_H
@@ -5,6 +5,10 @@
 
 typedef struct {
 	char *pcm_device;
+	char *capture_device;		/* empty = pcm_device */
+	char *audio_source;		/* file or capture */
+	char *offline_output;
+	char *streams;			/* extra DSP streams, name:graph[:priority[:deadline_ms]],... */
 	char *uart_device;
 	char *rproc_dev_name;
 	char *dma_heap_reserved;
@@ -13,15 +17,53 @@ typedef struct {
 	char *c7_old_fw_path;
 	char *c7_new_fw_path;
 	char *c7_state_path;
+	char *transport;
+	char *fftw_wisdom_file;
+	char *fftw_plan_rigor;
+	char *fir_coeff_file;
+	char *rec_dir;
+	char *rec_format;		/* wav or raw */
+	/* Per-thread "<other|fifo|rr>[:prio][@cpu]", empty = unchanged */
+	char *rt_process;
+	char *rt_read;
+	char *rt_complete;
+	char *rt_dsp;			/* empty = same as rt_complete */
+	char *rt_play;
+	char *rt_reactor;
+	char *rt_workers;
 
 	int c7_proc_id;
 	int remote_endpoint;
 	int data_buffer_size;
+	int channels;			/* 0 = from the audio source */
+	int sample_rate;		/* 0 = from the audio source */
+	int block_frames;		/* 0 = DATA_SIZE / frame size */
+	int graph_id;			/* main stream */
+	int stream_priority;
+	int stream_deadline_ms;		/* 0 = one block period */
+	int dsp_max_inflight;
 	int param_buffer_size;
+	int pipeline_depth;
+	int loopback_fixed_us;
+	int loopback_ns_per_kb;
+	int loopback_jitter_us;
+	int loopback_job_us;
+	int arm_workers;
+	int log_ring_kb;
+	int cpu_sample_ms;
+	unsigned int rec_channel_mask;
+	int rec_file_mb;
+	int rec_mem_kb;
+	int alsa_period_frames;
+	int alsa_periods;
+	int alsa_start_periods;
 	bool fft_filter_enable;
 	bool is_host_eth_iface;
-	bool is_dsp_execution;
+	int is_dsp_execution;		/* 0 = ARM, 1 = DSP, 2 = hybrid */
 	bool enable_audio_logging;
+	bool rt_mlock;
+	bool alsa_mmap;
+	bool offline_mode;
 } AppConfig;
 
 extern AppConfig app_config;
@@ -0,0 +1,61 @@
+#ifndef CPU_SAMPLER_H
+#define CPU_SAMPLER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#define CPU_SAMPLER_MAX_CORES		16
+#define CPU_SAMPLER_MAX_THREADS		16
+
+struct cpu_thread_sample {
+	const char *name;		/* static storage */
+	float util;			/* % of one core over the last period */
+	uint64_t cpu_ns;		/* total CPU time so far */
+};
+
+/* One sampling period; utilisation is over the period, counters are deltas */
+struct cpu_snapshot {
+	uint64_t ts_ns;
+	float total;			/* % of all cores */
+	int cores;
+	float core[CPU_SAMPLER_MAX_CORES];
+	int threads;
+	struct cpu_thread_sample thread[CPU_SAMPLER_MAX_THREADS];
+	long vol_ctxsw;			/* process-wide, from getrusage() */
+	long invol_ctxsw;
+	long minflt;
+	long majflt;
+};
+
+/*
+ * Background sampler of /proc/stat (kept open, re-read with pread()), the CPU
+ * clocks of registered threads and getrusage(). The latest snapshot is
+ * published under a seqlock, so readers never make a syscall or take a lock.
+ */
+struct cpu_sampler {
+	int stat_fd;
+	int period_ms;
+	pthread_t thread;
+	uint32_t stop;
+
+	int nthreads;
+	struct {
+		const char *name;
+		clockid_t clock;
+		uint64_t last_ns;
+	} reg[CPU_SAMPLER_MAX_THREADS];
+	pthread_mutex_t reg_lock;	/* registration and the sampler thread only */
+
+	uint32_t seq;			/* odd while the snapshot is being written */
+	struct cpu_snapshot snap;
+};
+
+int cpu_sampler_start(struct cpu_sampler *s, int period_ms);
+void cpu_sampler_stop(struct cpu_sampler *s);
+int cpu_sampler_add_thread(struct cpu_sampler *s, const char *name, pthread_t thread);
+void cpu_sampler_read(struct cpu_sampler *s, struct cpu_snapshot *out);
+float cpu_sampler_total(struct cpu_sampler *s);
+void log_cpu_snapshot(struct cpu_sampler *s);
+
+#endif //CPU_SAMPLER_H
@@ -0,0 +1,75 @@
+#ifndef FIR_CONV_H
+#define FIR_CONV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <fftw3.h>
+
+#define FIR_MAX_TAPS		4096
+#define FIR_MAX_GROUPS		16	/* hybrid mode runs one group per channel */
+
+/* A FIR response split into block-sized partitions, kept as spectra */
+struct fir_filter {
+	int taps;
+	int partitions;
+	fftwf_complex *h;		/* partitions * spec_dist, scaled by 1/fft_size */
+};
+
+/*
+ * Streaming overlap-save convolution with a uniformly partitioned filter.
+ * Every block of `block` frames is transformed once (FFT size 2 * block) into
+ * a per-channel frequency-domain delay line and multiplied with all filter
+ * partitions, so any FIR length runs at one block of latency.
+ *
+ * Channels are split into groups with their own plans, so each group can run
+ * on a different core. Per channel buffers are padded to cache lines.
+ */
+struct fir_conv {
+	int block;
+	int fft_size;			/* 2 * block */
+	int channels;
+	int bins;			/* block + 1 */
+	int spec_dist;			/* bins rounded up to a cache line */
+	int groups;
+	int first[FIR_MAX_GROUPS + 1];	/* first channel of each group */
+	int max_partitions;		/* delay line length */
+	int head;			/* delay line slot of the newest block */
+	bool stale;			/* delay line out of date after a bypass */
+
+	float *in;			/* per channel: previous block | newest block */
+	fftwf_complex *fdl;		/* max_partitions * channels * spec_dist */
+	fftwf_complex *acc;		/* channels * spec_dist */
+	float *out;			/* channels * fft_size, the newest block is valid */
+	int16_t *planar;		/* channels * block s16 scratch */
+
+	/* Filters are swapped in at a block boundary by the processing thread */
+	struct fir_filter filters[2];
+	struct fir_filter *active;
+	struct fir_filter *pending;
+	int pending_ready;
+	pthread_mutex_t load_lock;
+	float *h_time;			/* fft_size scratch for new partitions */
+
+	fftwf_plan fwd[FIR_MAX_GROUPS];
+	fftwf_plan bwd[FIR_MAX_GROUPS];
+	fftwf_plan hplan;
+};
+
+unsigned fir_conv_rigor(const char *name);
+int fir_conv_init(struct fir_conv *fc, int block, int channels, int groups,
+                  unsigned rigor, const char *wisdom_file);
+void fir_conv_destroy(struct fir_conv *fc);
+
+int fir_conv_set_filter(struct fir_conv *fc, const float *coeffs, int taps);
+int fir_conv_load_file(struct fir_conv *fc, const char *path);
+int fir_conv_set_lowpass(struct fir_conv *fc, float cutoff_hz, float rate, int taps);
+
+void fir_conv_load(struct fir_conv *fc, const int16_t *data);
+void fir_conv_forward(struct fir_conv *fc, int group);
+void fir_conv_filter(struct fir_conv *fc, int group);
+void fir_conv_store(struct fir_conv *fc, int16_t *data);
+void fir_conv_store_planar(struct fir_conv *fc, int16_t *planar, int first_ch, int end_ch);
+void fir_conv_bypass(struct fir_conv *fc, const int16_t *data);
+
+#endif //FIR_CONV_H
@@ -1,14 +1,77 @@
 #ifndef HOST_INTERFACE_H
 #define HOST_INTERFACE_H
 
-#define LOG_QUEUE_SIZE          16384
+#include "log_ring.h"
 
-void enqueue_log(const char *msg);
-void enqueue_input_buffer(const char* tag, int16_t *superbuf, int num_frames, int num_channels, int ch);
-void enqueue_output_buffer(const char* tag, int16_t *superbuf, int num_frames, int num_channels, int ch);
-void *log_writer(void *arg);
-void *cmd_listener(void *arg);
+/* Binary log events; the args of each are listed in the order they are stored */
+enum log_event {
+	LOG_EV_FRAME,			/* i frame, f amp, f latency, i mode, f cpu, f dsp */
+	LOG_EV_SUMMARY_FRAMES,		/* i frames */
+	LOG_EV_SUMMARY_LATENCY,		/* f min, f max, f avg */
+	LOG_EV_SUMMARY_AMP,		/* f min, f max, f avg */
+	LOG_EV_SUMMARY_CPU,		/* f min, f max, f avg */
+	LOG_EV_SUMMARY_DSP,		/* f min, f max, f avg */
+	LOG_EV_PIPELINE,		/* s queue, f avg depth, i max depth, i stalls, i pops */
+	LOG_EV_WORKER,			/* i worker, i jobs, f avg ms, f max ms, f wake us */
+	LOG_EV_HYBRID,			/* i dsp channels, i channels, f arm/ch, f dsp/ch, f slack, i moves */
+	LOG_EV_PCT_INTERVAL,		/* s metric, f p50, f p90, f p99, f p99.9, f max */
+	LOG_EV_PCT_TOTAL,		/* s metric, f p50, f p90, f p99, f p99.9, f max */
+	LOG_EV_CPU_SYS,			/* f total, i vol ctxsw, i invol ctxsw, i minflt, i majflt */
+	LOG_EV_CPU_CORE,		/* i core, f util */
+	LOG_EV_CPU_THREAD,		/* s thread, f util, f cpu ms */
+	LOG_EV_ALSA,			/* s stream, i xruns, f avg delay ms, f max delay ms, i period, i buffer */
+	LOG_EV_ROUNDTRIP,		/* f avg ms, f min ms, f max ms, i frames */
+	LOG_EV_STREAM,			/* s stream, i graph, i priority, i jobs, i misses, i dropped */
+	LOG_EV_STREAM_TIME,		/* s stream, f avg queued ms, f max queued ms, f avg latency ms, f max latency ms, f dsp load */
+};
+
+/*
+ * Called from the complete stage only (the single producer). Fill the args of
+ * the returned record and publish it with log_end(); NULL means dropped.
+ */
+struct log_record *log_begin(enum log_event event);
+void log_end(struct log_record *rec);
+
+/* Audio taps, streamed on the IN (8890) and OUT (8891) data ports */
+enum tap_dir {
+	TAP_INPUT,
+	TAP_OUTPUT,
+	TAP_DIRS
+};
+
+/*
+ * Precedes every tap frame on the wire (little endian). The payload is
+ * `frames` int16 samples of each channel set in channel_mask, lowest first.
+ */
+struct tap_header {
+	char tag[4];			/* "INPT" or "OUTP" */
+	uint32_t seq;			/* frame sequence number; gaps are dropped frames */
+	uint64_t ts_ns;			/* CLOCK_MONOTONIC time the frame was read */
+	uint32_t channel_mask;
+	uint16_t frames;
+	uint16_t reserved;
+};
+
+/* A borrowed interleaved frame; buf stays valid until release(ctx) is called */
+struct tap_frame {
+	const int16_t *buf;
+	int frames;
+	int channels;
+	uint32_t channel_mask;
+	int rate;
+	uint32_t seq;
+	uint64_t ts_ns;
+	void (*release)(void *ctx);
+	void *ctx;
+};
+
+/*
+ * Called from one thread per direction and never blocks. The host I/O thread
+ * extracts the channels and then calls release(), off the audio thread. On
+ * error (nobody listening, ring full) the caller keeps its reference.
+ */
+int tap_publish(enum tap_dir dir, const struct tap_frame *frame);
 void init_host_interface();
-int init_ethernet_async();
+void close_host_interface();
 
 #endif //HOST_INTERFACE_H
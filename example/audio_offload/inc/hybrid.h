@@ -0,0 +1,29 @@
+#ifndef HYBRID_H
+#define HYBRID_H
+
+#include <stdbool.h>
+
+/*
+ * Frame-to-frame split of the channels between the DSP and the ARM cores.
+ * Channels [0, dsp_channels) go to the DSP, the rest are processed on ARM.
+ * hybrid_update() runs on the complete stage, hybrid_dsp_channels() on the
+ * process stage.
+ */
+struct hybrid_balancer {
+	int channels;
+	int dsp_channels;		/* read atomically by the process stage */
+	float frame_ms;			/* deadline: one block of audio */
+	float arm_ch_ms;		/* smoothed cost of one channel on ARM */
+	float dsp_ch_ms;		/* smoothed cost of one channel on the DSP */
+	float slack_ms;			/* deadline minus the slower side, last frame */
+	unsigned long moves;
+	bool pinned;			/* firmware ignores channel_mask: all channels stay on the DSP */
+};
+
+void hybrid_init(struct hybrid_balancer *b, int channels, float frame_ms);
+int hybrid_dsp_channels(struct hybrid_balancer *b);
+void hybrid_update(struct hybrid_balancer *b, int dsp_channels, float arm_ms, float dsp_ms,
+                   float dsp_load, bool mask_done);
+void log_hybrid_stats(struct hybrid_balancer *b);
+
+#endif //HYBRID_H
@@ -0,0 +1,46 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_MAX_ARGS		6
+
+/* Raw argument; strings must be static storage, they are read by the writer later */
+union log_arg {
+	int64_t i;
+	double f;
+	const char *s;
+};
+
+/* One binary log record, exactly one cache line */
+struct log_record {
+	uint16_t event;
+	uint16_t reserved[3];
+	uint64_t ts_ns;
+	union log_arg a[LOG_MAX_ARGS];
+} __attribute__((aligned(64)));
+
+/*
+ * Lock-free single-producer, single-consumer ring of log records. The
+ * producer fills a record in place between log_ring_reserve() and
+ * log_ring_commit(); when the ring is full the record is dropped and
+ * counted instead of waiting for the consumer.
+ */
+struct log_ring {
+	struct log_record *recs;
+	uint32_t mask;
+	uint32_t head __attribute__((aligned(64)));	/* producer only */
+	uint64_t drops;
+	uint32_t tail __attribute__((aligned(64)));	/* consumer only */
+};
+
+int log_ring_init(struct log_ring *ring, size_t bytes);
+void log_ring_destroy(struct log_ring *ring);
+struct log_record *log_ring_reserve(struct log_ring *ring, uint16_t event);
+void log_ring_commit(struct log_ring *ring, struct log_record *rec);
+struct log_record *log_ring_peek(struct log_ring *ring);
+void log_ring_consume(struct log_ring *ring);
+uint64_t log_ring_drops(struct log_ring *ring);
+
+#endif //LOG_RING_H
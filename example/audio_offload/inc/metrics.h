@@ -1,19 +1,52 @@
 #ifndef METRICS_H
 #define METRICS_H
 
-float get_cpu_load();
-void log_input_audio(int16_t *superbuf, int num_frames, int num_channels, int ch);
-void log_output_audio(int16_t *superbuf, int num_frames, int num_channels, int ch);
-void update_metrics(float lat, float amp, float cpu, float dsp,
-                    double *total_latency, double *min_latency, double *max_latency,
-                    double *total_amp, double *min_amp, double *max_amp,
-                    double *total_cpu, double *min_cpu, double *max_cpu,
-                    double *total_dsp, double *min_dsp, double *max_dsp);
+#include <stdint.h>
+
+/*
+ * Log-linear (HDR-style) histogram: exact below 64 units, then 32 buckets per
+ * power of two (~3% resolution) up to 2^32 units. Recording is a few integer
+ * ops with no allocation; histograms with the same scale merge by adding counts.
+ */
+#define HIST_SUB_BITS		5
+#define HIST_SUB_COUNT		(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS		((32 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+struct hist {
+	double scale;			/* units per measured value, e.g. 1000 for ms -> us */
+	uint64_t count;
+	double sum;
+	double min;
+	double max;
+	uint64_t counts[HIST_BUCKETS];
+};
+
+enum metric_id {
+	METRIC_LATENCY,
+	METRIC_AMP,
+	METRIC_CPU,
+	METRIC_DSP,
+	METRIC_COUNT
+};
+
+/* Per-stream metrics; each histogram is written by one thread only */
+struct metrics {
+	struct hist interval[METRIC_COUNT];	/* since the last log_summary() */
+	struct hist total[METRIC_COUNT];
+};
+
+void hist_init(struct hist *h, double scale);
+void hist_reset(struct hist *h);
+void hist_record(struct hist *h, double value);
+void hist_merge(struct hist *dst, const struct hist *src);
+double hist_percentile(const struct hist *h, double pct);
+
+void metrics_init(struct metrics *m);
+void metrics_merge(struct metrics *dst, const struct metrics *src);
+
+void update_metrics(struct metrics *m, float lat, float amp, float cpu, float dsp);
 
 void log_frame_metrics(int exec_mode, int frames, float amp, float lat, float cpu, float dsp);
-void log_summary(int frames, double total_latency, double min_latency, double max_latency,
-                 double total_amp, double min_amp, double max_amp,
-                 double total_cpu, double min_cpu, double max_cpu,
-                 double total_dsp, double min_dsp, double max_dsp);
+void log_summary(struct metrics *m);
 
 #endif //METRICS_H
@@ -0,0 +1,30 @@
+#ifndef OFFLINE_H
+#define OFFLINE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "pipeline.h"
+
+/*
+ * Offline mode: the play stage writes OFFLINE_OUTPUT instead of feeding
+ * ALSA, so the pipeline runs as fast as the engines allow and the run ends
+ * with a throughput report.
+ */
+struct offline_stats {
+	struct timespec t_start;
+	struct rusage ru_start;
+	unsigned long frames;		/* play stage */
+	double dsp_ms_sum;		/* complete stage: submit-to-reply time */
+	double dsp_load_sum;		/* complete stage: load reported by the DSP */
+	unsigned long dsp_frames;
+};
+
+int offline_open(const char *path, int channels, int rate);
+int offline_write(const int16_t *data, int frames);
+void offline_close(void);
+
+void offline_begin(struct offline_stats *st);
+void offline_report(struct offline_stats *st, slot_queue_t **queues, int num_queues, int rate);
+
+#endif //OFFLINE_H
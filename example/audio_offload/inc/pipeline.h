@@ -0,0 +1,85 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <signal.h>
+#include "dmabuf.h"
+#include "rpmsg_ipc.h"
+#include "rpmsg_sched.h"
+
+#define PIPELINE_MAX_DEPTH	8
+
+/* DSP replies are polled this often; after Ctrl+C a job is given up after PIPELINE_EXIT_WAIT_MS */
+#define PIPELINE_WAIT_TICK_MS	100
+#define PIPELINE_EXIT_WAIT_MS	1000
+
+//------- Define EQ control params structure --------
+typedef struct __attribute__((__packed__))
+{
+	float dsp_load;
+	int32_t filter_enabled;
+	uint32_t channel_mask;	/* channels the DSP processes; others are left untouched */
+	uint32_t mask_done;	/* channel_mask echoed by firmware that honours it, else left 0 */
+}
+params_t;
+
+/* Each slot has its own params_t, one cache line apart, so in-flight frames never share one */
+#define PARAMS_STRIDE	64
+
+/* One frame in flight: a data dma-buf plus everything needed to process it */
+typedef struct {
+	struct dma_buf_params *dbuf;	/* data dma-buf owned by this slot */
+	ipc_msg_buf_t ibuf;		/* IPC descriptor pointing at dbuf */
+	int16_t *data;			/* mmaped dbuf */
+	int16_t *input;			/* unprocessed copy for the input tap */
+	int16_t *arm_out;		/* planar ARM results, merged after the DSP (hybrid) */
+	uint32_t params_off;		/* this slot's params_t in the params dma-buf */
+	int dsp_channels;		/* channels [0, dsp_channels) sent to the DSP */
+	float arm_ms;			/* ARM share of the processing time */
+	int frames;
+	int seq;
+	int refs;			/* play stage + taps still reading data/input */
+	struct timespec t_read;		/* when the read stage filled the slot */
+	struct timespec t_capture;	/* ADC time of the first frame, zero for file input */
+	uint32_t ticket;		/* outstanding DSP request, 0 if none */
+	struct timespec t_start;	/* processing start (submit time on DSP) */
+	float latency;			/* ms from t_start to result available */
+} audio_slot_t;
+
+/* Bounded FIFO of slot indices between two pipeline stages */
+typedef struct {
+	const char *name;
+	int slots[PIPELINE_MAX_DEPTH];
+	int head, tail, count;
+	bool closed;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	/* stats, sampled on every pop */
+	unsigned long pops;
+	unsigned long stalls;		/* pops that had to wait for input */
+	unsigned long depth_sum;
+	int max_depth;
+
+	/* consumer only: time its stage spends between pops, and its CPU time at close */
+	struct timespec t_popped;
+	uint64_t busy_ns;
+	uint64_t cpu_ns;
+} slot_queue_t;
+
+void slot_queue_init(slot_queue_t *q, const char *name);
+void slot_queue_destroy(slot_queue_t *q);
+void slot_queue_push(slot_queue_t *q, int idx);
+int slot_queue_pop(slot_queue_t *q);
+void slot_queue_close(slot_queue_t *q);
+void log_pipeline_stats(slot_queue_t **queues, int num_queues);
+
+/* Set by SIGINT: the read stage stops and the pipeline drains, main() tears down */
+extern volatile sig_atomic_t exit_requested;
+
+int pipeline_wait_job(struct rpmsg_sched *s, uint32_t job, ipc_msg_buf_t *reply);
+
+#endif //PIPELINE_H
@@ -0,0 +1,71 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define REC_BUF_SIZE		(256 * 1024)
+#define REC_MAX_BUFS		64
+#define REC_ALIGN		4096	/* O_DIRECT buffer, offset and length alignment */
+#define REC_WAV_HEADER		44
+
+struct rec_buf {
+	uint8_t *data;			/* REC_BUF_SIZE bytes, REC_ALIGN aligned */
+	size_t len;
+	bool first;			/* opens a file, starts with the WAV header */
+	bool last;			/* closes the file */
+};
+
+/*
+ * Streams selected channels of interleaved s16 frames to WAV or raw PCM
+ * files, rotated at a size limit. The producer packs frames into a fixed set
+ * of aligned buffers and never waits: when every buffer is queued for the
+ * writer thread, whole frames are dropped. The writer uses O_DIRECT where the
+ * filesystem supports it.
+ */
+struct recorder {
+	char prefix[200];		/* files are <prefix>_NNN.wav|.raw */
+	bool wav;
+	uint32_t channel_mask;		/* within the source channels */
+	int src_channels;
+	int channels;			/* recorded channels */
+	int rate;
+	uint64_t file_limit;		/* bytes per file, header included */
+
+	struct rec_buf bufs[REC_MAX_BUFS];
+	int nbufs;
+
+	/* producer */
+	struct rec_buf *cur;		/* buffer being filled, submitted when full */
+	bool file_open;
+	uint64_t file_bytes;
+	unsigned long drops;		/* frames, read by the writer for reporting */
+
+	/* producer <-> writer, indices into bufs */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int free_list[REC_MAX_BUFS];
+	int nfree;
+	int full[REC_MAX_BUFS];
+	int full_head;
+	int full_count;
+	bool stop;
+	pthread_t thread;
+
+	/* writer */
+	int fd;
+	bool direct;
+	int file_index;
+	uint64_t written;		/* bytes of the current file */
+	char path[256];
+};
+
+int recorder_open(struct recorder *r, const char *prefix, bool wav, uint32_t channel_mask,
+                  int src_channels, int rate, uint64_t file_limit, size_t mem_budget);
+void recorder_write(struct recorder *r, const int16_t *frames, int num_frames);
+void recorder_count_drops(struct recorder *r, unsigned long frames);
+void recorder_close(struct recorder *r);
+
+#endif //RECORDER_H
@@ -1,11 +1,19 @@
 #ifndef RPMSG_AUDIO_EXAMPLE_H
 #define RPMSG_AUDIO_EXAMPLE_H
 
-#define CHANNELS        8
-#define SAMPLE_RATE     48000
-#define BITS_PER_SAMPLE 16
-#define FRAME_SIZE      (CHANNELS * (BITS_PER_SAMPLE / 8))
-#define NUM_FRAMES      256
+#include "rpmsg_ipc.h"
+#include "pipeline.h"
+
+#define BITS_PER_SAMPLE		16
+#define MAX_CHANNELS		16
+#define MIN_BLOCK_FRAMES	8
+#define MAX_BLOCK_FRAMES	1024
+
+/* Stream geometry, resolved at startup from the config and the audio source */
+int num_channels = 8;
+unsigned int sample_rate = 48000;
+int num_frames = 256;
+#define FRAME_SIZE		(num_channels * (BITS_PER_SAMPLE / 8))
 
 #define DEBUG 0
 #if DEBUG
@@ -27,27 +35,9 @@ typedef struct {
 	int params_size;                   /* Total dma-buf size */
 } local_buf_t;
 
-//------- Define EQ control params structure --------
-typedef struct __attribute__((__packed__))
-{
-	float dsp_load;
-	int32_t filter_enabled;
-}
-params_t;
-
-//------- Define C7 IPC message structure --------
-typedef struct __attribute__((__packed__))
-{
-	uint32_t data_buffer;
-	uint32_t params_buffer;
-	int32_t data_size;
-	int32_t params_size;
-	int32_t graph_id;
-
-}
-ipc_msg_buf_t;
+#define ALL_CHANNELS_MASK	((1u << num_channels) - 1)
 
-typedef enum { EXEC_ARM, EXEC_DSP } ExecMode;
+typedef enum { EXEC_ARM, EXEC_DSP, EXEC_HYBRID } ExecMode;
 ExecMode current_mode = EXEC_ARM;
 
 bool filter_enabled = false;
@@ -0,0 +1,25 @@
+#ifndef RT_PROFILE_H
+#define RT_PROFILE_H
+
+#include <pthread.h>
+
+/* Default stack of threads created after rt_lock_memory(), all of it locked */
+#define RT_THREAD_STACK		(1024 * 1024)
+/* Touched up front so the stack never faults in the hot path */
+#define RT_STACK_PREFAULT	(256 * 1024)
+
+/* One thread's scheduling, parsed from "<other|fifo|rr>[:prio][@cpu]" */
+struct rt_sched {
+	int policy;
+	int prio;
+	int cpu;			/* -1 keeps the current affinity */
+};
+
+int rt_parse(const char *spec, struct rt_sched *s);
+int rt_apply_sched(const char *name, pthread_t thread, const struct rt_sched *s);
+int rt_apply(const char *name, pthread_t thread, const char *spec);
+int rt_lock_memory(void);
+void rt_prefault_stack(void);
+void rt_check(void);
+
+#endif //RT_PROFILE_H
@@ -0,0 +1,55 @@
+#ifndef STREAMS_H
+#define STREAMS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "dmabuf.h"
+#include "rpmsg_sched.h"
+#include "pipeline.h"
+
+/* Streams besides the main one, which holds the first scheduler slot */
+#define STREAMS_MAX		(RPMSG_SCHED_MAX_STREAMS - 1)
+#define STREAM_NAME_LEN		16
+
+/*
+ * An extra DSP stream (STREAMS): another graph, e.g. a second zone or an
+ * analysis graph, run on every block the main stream reads. Each has its
+ * own data dma-bufs, params buffer and graph id, and shares the endpoint
+ * with the main stream through the scheduler. Only the process stage
+ * submits and reaps, so the job ring needs no locking.
+ */
+struct dsp_stream {
+	char name[STREAM_NAME_LEN];
+	int graph_id;
+	int priority;
+	int deadline_ms;		/* 0 = one block period */
+	int sched_id;
+
+	struct dmabuf_pool pool;
+	struct dma_buf_params params;	/* one params_t per job, PARAMS_STRIDE apart */
+	struct dma_buf_params *bufs[PIPELINE_MAX_DEPTH];
+	uint32_t jobs[PIPELINE_MAX_DEPTH];	/* FIFO of outstanding jobs, 0 = none */
+	int depth;
+	int head, count;
+
+	/* written by the process stage, logged by the complete stage */
+	unsigned long dropped;		/* blocks skipped while all buffers were busy */
+	double dsp_load_sum;
+	unsigned long dsp_loads;
+	double logged_load_sum;
+	unsigned long logged_loads;
+};
+
+int streams_parse(const char *spec);
+int streams_count(void);
+int streams_init(struct rpmsg_sched *sched, int depth, int data_size, uint32_t block_us);
+void streams_set_filter(bool enabled);
+/* block: wait for a free buffer instead of dropping the block (offline runs) */
+void streams_submit(const int16_t *data, int bytes, uint32_t channel_mask,
+                    const struct timespec *release, bool block);
+void streams_drain(void);
+void streams_destroy(void);
+void log_stream_stats(struct rpmsg_sched *sched, double main_load);
+
+#endif //STREAMS_H
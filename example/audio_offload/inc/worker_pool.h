@@ -0,0 +1,47 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define WORKER_POOL_MAX		8
+
+/* Called once per worker per fork; idx 0 runs on the thread calling worker_pool_run() */
+typedef void (*worker_fn_t)(int idx, void *arg);
+
+/* Written only by the owning worker, read by the stats logger; one cache line each */
+struct worker_stats {
+	uint64_t jobs;
+	uint64_t busy_ns;
+	uint64_t max_ns;
+	uint64_t wake_ns;		/* fork to job start, summed */
+} __attribute__((aligned(64)));
+
+struct worker_pool;
+
+/* Handed to a worker thread at creation, so that threads[idx] runs worker idx */
+struct worker_arg {
+	struct worker_pool *pool;
+	int idx;
+};
+
+struct worker_pool {
+	int count;			/* workers including the caller */
+	pthread_t threads[WORKER_POOL_MAX];
+	worker_fn_t fn;
+	void *arg;
+	uint64_t fork_ns;
+	uint32_t generation;		/* bumped to release the workers */
+	uint32_t pending;		/* workers still running the current fork */
+	uint32_t stop;
+	uint32_t sleepers;		/* workers parked in futex_wait() */
+	struct worker_arg args[WORKER_POOL_MAX];
+	struct worker_stats stats[WORKER_POOL_MAX];
+};
+
+int worker_pool_init(struct worker_pool *pool, int count);
+void worker_pool_destroy(struct worker_pool *pool);
+void worker_pool_run(struct worker_pool *pool, worker_fn_t fn, void *arg);
+void log_worker_stats(struct worker_pool *pool);
+
+#endif //WORKER_POOL_H
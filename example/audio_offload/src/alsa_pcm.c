@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "alsa_pcm.h"
+#include "host_interface.h"
+
+#define ALSA_WAIT_MS		1000
+
+// ====================== Setup =========================
+
+static int alsa_set_hw(struct alsa_pcm *p, int period, int periods)
+{
+	snd_pcm_hw_params_t *hw;
+	int dir = 0, err;
+
+	err = snd_pcm_hw_params_malloc(&hw);
+	if (err < 0)
+		return err;
+	snd_pcm_hw_params_any(p->handle, hw);
+	if (p->mmap && snd_pcm_hw_params_set_access(p->handle, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED) < 0) {
+		printf("[ALSA] %s: device has no mmap access, using read/write\n", p->name);
+		p->mmap = false;
+	}
+	if (!p->mmap)
+		snd_pcm_hw_params_set_access(p->handle, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+
+	p->period = period;
+	p->buffer = (snd_pcm_uframes_t)period * periods;
+	if ((err = snd_pcm_hw_params_set_format(p->handle, hw, SND_PCM_FORMAT_S16_LE)) < 0 ||
+	    (err = snd_pcm_hw_params_set_channels(p->handle, hw, p->channels)) < 0 ||
+	    (err = snd_pcm_hw_params_set_rate_near(p->handle, hw, &p->rate, &dir)) < 0 ||
+	    (err = snd_pcm_hw_params_set_period_size_near(p->handle, hw, &p->period, &dir)) < 0 ||
+	    (err = snd_pcm_hw_params_set_buffer_size_near(p->handle, hw, &p->buffer)) < 0 ||
+	    (err = snd_pcm_hw_params(p->handle, hw)) < 0)
+		printf("[ALSA] %s: hw params rejected: %s\n", p->name, snd_strerror(err));
+	snd_pcm_hw_params_free(hw);
+	if (err < 0)
+		return err;
+	/* The device may round the request; use what it really runs with */
+	return snd_pcm_get_params(p->handle, &p->buffer, &p->period);
+}
+
+/* start is the start threshold in frames; 0 means never start on a transfer */
+static int alsa_set_sw(struct alsa_pcm *p, snd_pcm_uframes_t start)
+{
+	snd_pcm_sw_params_t *sw;
+	int err;
+
+	err = snd_pcm_sw_params_malloc(&sw);
+	if (err < 0)
+		return err;
+	snd_pcm_sw_params_current(p->handle, sw);
+	if (start == 0)
+		snd_pcm_sw_params_get_boundary(sw, &start);
+	p->start = start;
+	/* Hardware timestamps on the clock the pipeline stamps its frames with */
+	snd_pcm_sw_params_set_tstamp_mode(p->handle, sw, SND_PCM_TSTAMP_ENABLE);
+	snd_pcm_sw_params_set_tstamp_type(p->handle, sw, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	if ((err = snd_pcm_sw_params_set_start_threshold(p->handle, sw, start)) < 0 ||
+	    (err = snd_pcm_sw_params_set_avail_min(p->handle, sw, p->period)) < 0 ||
+	    (err = snd_pcm_sw_params(p->handle, sw)) < 0)
+		printf("[ALSA] %s: sw params rejected: %s\n", p->name, snd_strerror(err));
+	snd_pcm_sw_params_free(sw);
+	return err;
+}
+
+/*
+ * period is in frames. The ring holds `periods` of them. Playback starts
+ * once start_periods are queued, so that is the latency ALSA adds; capture
+ * starts on the first read.
+ */
+int alsa_pcm_open(struct alsa_pcm *p, const char *device, snd_pcm_stream_t stream,
+                  int channels, unsigned int rate, int period, int periods, int start_periods,
+                  bool mmap)
+{
+	snd_pcm_uframes_t start;
+	int err;
+
+	memset(p, 0, sizeof(*p));
+	p->capture = stream == SND_PCM_STREAM_CAPTURE;
+	p->name = p->capture ? "capture" : "playback";
+	p->channels = channels;
+	p->frame_bytes = channels * sizeof(int16_t);
+	p->rate = rate;
+	p->mmap = mmap;
+	p->rtt_min_us = -1;
+	if (periods < 2)
+		periods = 2;
+	if (start_periods < 1)
+		start_periods = 1;
+
+	err = snd_pcm_open(&p->handle, device, stream, 0);
+	if (err < 0) {
+		printf("[ALSA] cannot open %s for %s: %s\n", device, p->name, snd_strerror(err));
+		return err;
+	}
+	if ((err = alsa_set_hw(p, period, periods)) < 0)
+		goto fail;
+	start = p->capture ? 1 : p->period * start_periods;
+	if ((err = alsa_set_sw(p, start < p->buffer ? start : p->buffer)) < 0)
+		goto fail;
+	printf("[ALSA] %s on %s: %s, %lu x %lu frames at %u Hz (%.1f ms), start at %lu frames\n",
+	       p->name, device, p->mmap ? "mmap" : "read/write", p->buffer / p->period, p->period,
+	       p->rate, p->buffer * 1000.0 / p->rate, p->start);
+	return 0;
+fail:
+	snd_pcm_close(p->handle);
+	p->handle = NULL;
+	return err;
+}
+
+void alsa_pcm_close(struct alsa_pcm *p)
+{
+	if (!p->handle)
+		return;
+	if (p->linked) {
+		snd_pcm_unlink(p->handle);
+		p->linked->linked = NULL;
+		p->linked = NULL;
+	}
+	if (p->capture)
+		snd_pcm_drop(p->handle);
+	else
+		snd_pcm_drain(p->handle);
+	snd_pcm_close(p->handle);
+	p->handle = NULL;
+	free(p->silence);
+	p->silence = NULL;
+}
+
+// ====================== Transfers =========================
+
+/* One mmap or read/write transfer of up to n frames; returns frames moved or -errno */
+static snd_pcm_sframes_t alsa_transfer(struct alsa_pcm *p, uint8_t *buf, snd_pcm_uframes_t n)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset;
+	snd_pcm_sframes_t done;
+	uint8_t *ring;
+	int err;
+
+	if (!p->mmap)
+		return p->capture ? snd_pcm_readi(p->handle, buf, n) : snd_pcm_writei(p->handle, buf, n);
+
+	err = snd_pcm_mmap_begin(p->handle, &areas, &offset, &n);
+	if (err < 0)
+		return err;
+	/* Interleaved: one area describes all channels */
+	ring = (uint8_t *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+	if (p->capture)
+		memcpy(buf, ring, n * p->frame_bytes);
+	else
+		memcpy(ring, buf, n * p->frame_bytes);
+	done = snd_pcm_mmap_commit(p->handle, offset, n);
+	if (done >= 0 && (snd_pcm_uframes_t)done != n)
+		done = -EPIPE;
+	return done;
+}
+
+/* Queues start-threshold worth of silence so a linked pair (re)starts together */
+static void alsa_prefill(struct alsa_pcm *p)
+{
+	snd_pcm_uframes_t left = p->start;
+
+	while (left > 0) {
+		snd_pcm_sframes_t done = alsa_transfer(p, (uint8_t *)p->silence,
+						       left < p->period ? left : p->period);
+		if (done <= 0)
+			break;
+		left -= done;
+	}
+}
+
+/*
+ * Underruns/overruns (-EPIPE) and suspends (-ESTRPIPE) re-prepare the stream.
+ * Preparing one half of a linked pair stops both, so playback queues
+ * silence up to its threshold, which starts both again. Capture starts the
+ * pair at once; an empty playback ring then underruns and restarts as above.
+ */
+static int alsa_recover(struct alsa_pcm *p, int err)
+{
+	if (err == -EPIPE)
+		__atomic_store_n(&p->xruns, p->xruns + 1, __ATOMIC_RELAXED);
+	err = snd_pcm_recover(p->handle, err, 1);
+	if (err < 0) {
+		printf("[ALSA] %s: cannot recover: %s\n", p->name, snd_strerror(err));
+		return err;
+	}
+	if (p->linked && p->capture)
+		snd_pcm_start(p->handle);
+	else if (p->linked)
+		alsa_prefill(p);
+	return 0;
+}
+
+/*
+ * Links capture to playback so both run from one start trigger and stay on
+ * the same clock. Capture no longer starts itself; silence queued on the
+ * playback side reaches its threshold and starts the pair.
+ */
+int alsa_pcm_link(struct alsa_pcm *capture, struct alsa_pcm *playback)
+{
+	int err = snd_pcm_link(capture->handle, playback->handle);
+
+	if (err < 0) {
+		printf("[ALSA] cannot link capture to playback: %s, streams run on separate clocks\n",
+		       snd_strerror(err));
+		return err;
+	}
+	playback->silence = calloc(playback->period, playback->frame_bytes);
+	err = playback->silence ? alsa_set_sw(capture, 0) : -ENOMEM;
+	if (err < 0) {
+		snd_pcm_unlink(capture->handle);
+		free(playback->silence);
+		playback->silence = NULL;
+		return err;
+	}
+	capture->linked = playback;
+	playback->linked = capture;
+	alsa_prefill(playback);
+	printf("[ALSA] capture linked to playback, %lu frames of silence queued\n", playback->start);
+	return 0;
+}
+
+static void alsa_track_delay(struct alsa_pcm *p, snd_pcm_sframes_t delay)
+{
+	if (delay < 0)
+		delay = 0;
+	if (delay > p->max_delay)
+		__atomic_store_n(&p->max_delay, delay, __ATOMIC_RELAXED);
+	__atomic_store_n(&p->delay_sum, p->delay_sum + delay, __ATOMIC_RELAXED);
+	__atomic_store_n(&p->delay_count, p->delay_count + 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Converter time of the next frame transferred, from the hardware timestamp
+ * of the last pointer update. Playback: the frames queued at that moment
+ * play first. Capture: the oldest unread frame was sampled `avail` earlier.
+ */
+static int64_t alsa_next_frame_ns(struct alsa_pcm *p)
+{
+	snd_pcm_uframes_t avail;
+	snd_htimestamp_t ts;
+	int64_t frames;
+
+	if (snd_pcm_state(p->handle) != SND_PCM_STATE_RUNNING ||
+	    snd_pcm_htimestamp(p->handle, &avail, &ts) < 0 || (ts.tv_sec == 0 && ts.tv_nsec == 0))
+		return 0;
+	frames = p->capture ? -(int64_t)avail : (int64_t)(p->buffer - avail);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec + frames * 1000000000LL / p->rate;
+}
+
+static void alsa_track_rtt(struct alsa_pcm *p, const struct timespec *t_capture)
+{
+	int64_t played = alsa_next_frame_ns(p);
+	long us;
+
+	if (!played || (t_capture->tv_sec == 0 && t_capture->tv_nsec == 0))
+		return;
+	us = (played - (t_capture->tv_sec * 1000000000LL + t_capture->tv_nsec)) / 1000;
+	if (p->rtt_min_us < 0 || us < p->rtt_min_us)
+		__atomic_store_n(&p->rtt_min_us, us, __ATOMIC_RELAXED);
+	if (us > p->rtt_max_us)
+		__atomic_store_n(&p->rtt_max_us, us, __ATOMIC_RELAXED);
+	__atomic_store_n(&p->rtt_sum_us, p->rtt_sum_us + us, __ATOMIC_RELAXED);
+	__atomic_store_n(&p->rtt_count, p->rtt_count + 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Shared loop of alsa_pcm_write()/read(): blocks until all frames are moved.
+ * For capture, t_first gets the ADC time of the first frame (zero if the
+ * device gives no timestamp). Returns frames or a negative error.
+ */
+static int alsa_stream(struct alsa_pcm *p, uint8_t *buf, int frames, struct timespec *t_first)
+{
+	snd_pcm_uframes_t left = frames;
+	bool tracked = false;
+
+	while (left > 0) {
+		snd_pcm_sframes_t avail, delay, done;
+		int err = snd_pcm_avail_delay(p->handle, &avail, &delay);
+
+		if (err == 0 && avail == 0) {
+			/* mmap capture never starts on its own; a linked one waits for playback */
+			if (p->capture && !p->linked && snd_pcm_state(p->handle) == SND_PCM_STATE_PREPARED)
+				snd_pcm_start(p->handle);
+			err = snd_pcm_wait(p->handle, ALSA_WAIT_MS);
+			err = err < 0 ? err : 1;
+		}
+		if (err < 0) {
+			if (alsa_recover(p, err) < 0)
+				return err;
+			continue;
+		}
+		if (err > 0)
+			continue;
+		if (!tracked) {
+			alsa_track_delay(p, delay);
+			if (t_first) {
+				int64_t ns = alsa_next_frame_ns(p);
+
+				t_first->tv_sec = ns / 1000000000LL;
+				t_first->tv_nsec = ns % 1000000000LL;
+			}
+			tracked = true;
+		}
+
+		done = alsa_transfer(p, buf, left);
+		if (done < 0) {
+			if (alsa_recover(p, done) < 0)
+				return done;
+			continue;
+		}
+		buf += done * p->frame_bytes;
+		left -= done;
+	}
+	__atomic_store_n(&p->frames, p->frames + frames, __ATOMIC_RELAXED);
+	return frames;
+}
+
+/* t_capture, when set, is the ADC time of data[0]; it feeds the round-trip stats */
+int alsa_pcm_write(struct alsa_pcm *p, const int16_t *data, int frames,
+                   const struct timespec *t_capture)
+{
+	if (t_capture)
+		alsa_track_rtt(p, t_capture);
+	return alsa_stream(p, (uint8_t *)data, frames, NULL);
+}
+
+int alsa_pcm_read(struct alsa_pcm *p, int16_t *data, int frames, struct timespec *t_capture)
+{
+	return alsa_stream(p, (uint8_t *)data, frames, t_capture);
+}
+
+// ====================== Stats =========================
+
+/* Called from the complete stage; averages cover the frames since the last call */
+void log_alsa_stats(struct alsa_pcm *p)
+{
+	uint64_t sum = __atomic_load_n(&p->delay_sum, __ATOMIC_RELAXED);
+	unsigned long count = __atomic_load_n(&p->delay_count, __ATOMIC_RELAXED);
+	uint64_t rtt_sum = __atomic_load_n(&p->rtt_sum_us, __ATOMIC_RELAXED);
+	unsigned long rtt_count = __atomic_load_n(&p->rtt_count, __ATOMIC_RELAXED);
+	struct log_record *r;
+
+	if (!p->handle)
+		return;
+	if ((r = log_begin(LOG_EV_ALSA)) != NULL) {
+		r->a[0].s = p->name;
+		r->a[1].i = __atomic_load_n(&p->xruns, __ATOMIC_RELAXED);
+		r->a[2].f = count > p->logged_count ?
+			    (double)(sum - p->logged_sum) / (count - p->logged_count) * 1000.0 / p->rate : 0.0;
+		r->a[3].f = __atomic_load_n(&p->max_delay, __ATOMIC_RELAXED) * 1000.0 / p->rate;
+		r->a[4].i = p->period;
+		r->a[5].i = p->buffer;
+		log_end(r);
+		p->logged_sum = sum;
+		p->logged_count = count;
+	}
+	if (rtt_count > p->logged_rtt_count && (r = log_begin(LOG_EV_ROUNDTRIP)) != NULL) {
+		r->a[0].f = (double)(rtt_sum - p->logged_rtt_sum) / (rtt_count - p->logged_rtt_count) / 1000.0;
+		r->a[1].f = __atomic_load_n(&p->rtt_min_us, __ATOMIC_RELAXED) / 1000.0;
+		r->a[2].f = __atomic_load_n(&p->rtt_max_us, __ATOMIC_RELAXED) / 1000.0;
+		r->a[3].i = rtt_count;
+		log_end(r);
+		p->logged_rtt_sum = rtt_sum;
+		p->logged_rtt_count = rtt_count;
+	}
+}
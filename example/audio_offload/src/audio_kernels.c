@@ -0,0 +1,706 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNELS 1
+#endif
+
+#define S16_MAX_F	32767.0f
+#define S16_MIN_F	-32768.0f
+
+/* Bodies are inlined into every generic and per-geometry kernel, so constants fold */
+#define KERNEL_BODY		static inline __attribute__((always_inline))
+#define NO_ATTR
+
+/* Geometries that get their own compiled block kernels; everything else runs the generic ones */
+#define BLOCK_GEOMETRIES(X, isa, attr)							\
+	X(isa, attr, 2, 64)  X(isa, attr, 2, 128)  X(isa, attr, 2, 256)  X(isa, attr, 2, 512)	\
+	X(isa, attr, 8, 64)  X(isa, attr, 8, 128)  X(isa, attr, 8, 256)  X(isa, attr, 8, 512)	\
+	X(isa, attr, 16, 64) X(isa, attr, 16, 128) X(isa, attr, 16, 256) X(isa, attr, 16, 512)
+
+#define BLOCK_KERNELS(isa, attr, ch, n)							\
+attr static void isa##_deinterleave_##ch##x##n(int16_t *planar, const int16_t *interleaved)	\
+{											\
+	isa##_deinterleave_body(planar, interleaved, ch, n);				\
+}											\
+attr static void isa##_interleave_##ch##x##n(int16_t *interleaved, const int16_t *planar)	\
+{											\
+	isa##_interleave_body(interleaved, planar, ch, n);				\
+}
+
+#define BLOCK_ENTRY(isa, attr, ch, n)							\
+	{ ch, n, isa##_deinterleave_##ch##x##n, isa##_interleave_##ch##x##n },
+
+/* Generic kernels plus the per-geometry table of one instruction set */
+#define GEOMETRY_KERNELS(isa, attr)							\
+attr static void isa##_deinterleave_s16(int16_t *planar, const int16_t *interleaved,	\
+					int channels, int frames)			\
+{											\
+	isa##_deinterleave_body(planar, interleaved, channels, frames);			\
+}											\
+attr static void isa##_interleave_s16(int16_t *interleaved, const int16_t *planar,	\
+				      int channels, int frames)				\
+{											\
+	isa##_interleave_body(interleaved, planar, channels, frames);			\
+}											\
+BLOCK_GEOMETRIES(BLOCK_KERNELS, isa, attr)						\
+static const struct audio_block_kernels isa##_blocks[] = {				\
+	BLOCK_GEOMETRIES(BLOCK_ENTRY, isa, attr)					\
+};
+
+// ====================== Scalar Reference =========================
+
+KERNEL_BODY void scalar_deinterleave_body(int16_t *planar, const int16_t *interleaved,
+					  int channels, int frames)
+{
+	for (int ch = 0; ch < channels; ch++)
+		for (int i = 0; i < frames; i++)
+			planar[ch * frames + i] = interleaved[i * channels + ch];
+}
+
+KERNEL_BODY void scalar_interleave_body(int16_t *interleaved, const int16_t *planar,
+					int channels, int frames)
+{
+	for (int ch = 0; ch < channels; ch++)
+		for (int i = 0; i < frames; i++)
+			interleaved[i * channels + ch] = planar[ch * frames + i];
+}
+
+static void scalar_s16_to_f32(float *dst, const int16_t *src, int n, float scale)
+{
+	for (int i = 0; i < n; i++)
+		dst[i] = (float)src[i] * scale;
+}
+
+static void scalar_f32_to_s16(int16_t *dst, const float *src, int n, float scale)
+{
+	for (int i = 0; i < n; i++) {
+		float val = src[i] * scale;
+
+		if (val > S16_MAX_F) val = S16_MAX_F;
+		if (val < S16_MIN_F) val = S16_MIN_F;
+		dst[i] = (int16_t)val;
+	}
+}
+
+GEOMETRY_KERNELS(scalar, NO_ATTR)
+
+static const struct audio_kernels scalar_kernels = {
+	.name			= "scalar",
+	.deinterleave_s16	= scalar_deinterleave_s16,
+	.interleave_s16		= scalar_interleave_s16,
+	.s16_to_f32		= scalar_s16_to_f32,
+	.f32_to_s16		= scalar_f32_to_s16,
+	.blocks			= scalar_blocks,
+	.num_blocks		= sizeof(scalar_blocks) / sizeof(scalar_blocks[0]),
+};
+
+// ====================== SSE2 / AVX2 =========================
+
+#ifdef HAVE_X86_KERNELS
+
+/* 8x8 int16 transpose; works per 128-bit lane, so the AVX2 variant does two at once */
+#define TRANSPOSE8_S16(T, P, r)							\
+do {										\
+	T a0 = P##_unpacklo_epi16(r[0], r[1]);					\
+	T a1 = P##_unpackhi_epi16(r[0], r[1]);					\
+	T a2 = P##_unpacklo_epi16(r[2], r[3]);					\
+	T a3 = P##_unpackhi_epi16(r[2], r[3]);					\
+	T a4 = P##_unpacklo_epi16(r[4], r[5]);					\
+	T a5 = P##_unpackhi_epi16(r[4], r[5]);					\
+	T a6 = P##_unpacklo_epi16(r[6], r[7]);					\
+	T a7 = P##_unpackhi_epi16(r[6], r[7]);					\
+	T b0 = P##_unpacklo_epi32(a0, a2);					\
+	T b1 = P##_unpackhi_epi32(a0, a2);					\
+	T b2 = P##_unpacklo_epi32(a1, a3);					\
+	T b3 = P##_unpackhi_epi32(a1, a3);					\
+	T b4 = P##_unpacklo_epi32(a4, a6);					\
+	T b5 = P##_unpackhi_epi32(a4, a6);					\
+	T b6 = P##_unpacklo_epi32(a5, a7);					\
+	T b7 = P##_unpackhi_epi32(a5, a7);					\
+	r[0] = P##_unpacklo_epi64(b0, b4);					\
+	r[1] = P##_unpackhi_epi64(b0, b4);					\
+	r[2] = P##_unpacklo_epi64(b1, b5);					\
+	r[3] = P##_unpackhi_epi64(b1, b5);					\
+	r[4] = P##_unpacklo_epi64(b2, b6);					\
+	r[5] = P##_unpackhi_epi64(b2, b6);					\
+	r[6] = P##_unpacklo_epi64(b3, b7);					\
+	r[7] = P##_unpackhi_epi64(b3, b7);					\
+} while (0)
+
+#define SSE2_ATTR	__attribute__((target("sse2")))
+
+/* Stereo: split even/odd samples by sign-extending 32-bit halves, then pack back */
+KERNEL_BODY SSE2_ATTR void sse2_deinterleave2(int16_t *planar, const int16_t *interleaved, int frames)
+{
+	int i = 0;
+
+	for (; i < (frames & ~7); i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(interleaved + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(interleaved + i * 2 + 8));
+		__m128i la = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		__m128i lb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+
+		_mm_storeu_si128((__m128i *)(planar + i), _mm_packs_epi32(la, lb));
+		_mm_storeu_si128((__m128i *)(planar + frames + i),
+				 _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)));
+	}
+	for (; i < frames; i++) {
+		planar[i] = interleaved[i * 2];
+		planar[frames + i] = interleaved[i * 2 + 1];
+	}
+}
+
+KERNEL_BODY SSE2_ATTR void sse2_interleave2(int16_t *interleaved, const int16_t *planar, int frames)
+{
+	int i = 0;
+
+	for (; i < (frames & ~7); i += 8) {
+		__m128i l = _mm_loadu_si128((const __m128i *)(planar + i));
+		__m128i r = _mm_loadu_si128((const __m128i *)(planar + frames + i));
+
+		_mm_storeu_si128((__m128i *)(interleaved + i * 2), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i *)(interleaved + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+	}
+	for (; i < frames; i++) {
+		interleaved[i * 2] = planar[i];
+		interleaved[i * 2 + 1] = planar[frames + i];
+	}
+}
+
+/* Multiples of 8 channels: one 8x8 transpose per group of 8 channels and 8 frames */
+KERNEL_BODY SSE2_ATTR void sse2_deinterleave_body(int16_t *planar, const int16_t *interleaved,
+						  int channels, int frames)
+{
+	if (channels == 2) {
+		sse2_deinterleave2(planar, interleaved, frames);
+		return;
+	}
+	if (channels % 8) {
+		scalar_deinterleave_body(planar, interleaved, channels, frames);
+		return;
+	}
+	for (int g = 0; g < channels; g += 8) {
+		int i = 0;
+
+		for (; i < (frames & ~7); i += 8) {
+			__m128i r[8];
+
+			for (int k = 0; k < 8; k++)
+				r[k] = _mm_loadu_si128((const __m128i *)(interleaved + (i + k) * channels + g));
+			TRANSPOSE8_S16(__m128i, _mm, r);
+			for (int ch = 0; ch < 8; ch++)
+				_mm_storeu_si128((__m128i *)(planar + (g + ch) * frames + i), r[ch]);
+		}
+		for (; i < frames; i++)
+			for (int ch = 0; ch < 8; ch++)
+				planar[(g + ch) * frames + i] = interleaved[i * channels + g + ch];
+	}
+}
+
+KERNEL_BODY SSE2_ATTR void sse2_interleave_body(int16_t *interleaved, const int16_t *planar,
+						int channels, int frames)
+{
+	if (channels == 2) {
+		sse2_interleave2(interleaved, planar, frames);
+		return;
+	}
+	if (channels % 8) {
+		scalar_interleave_body(interleaved, planar, channels, frames);
+		return;
+	}
+	for (int g = 0; g < channels; g += 8) {
+		int i = 0;
+
+		for (; i < (frames & ~7); i += 8) {
+			__m128i r[8];
+
+			for (int ch = 0; ch < 8; ch++)
+				r[ch] = _mm_loadu_si128((const __m128i *)(planar + (g + ch) * frames + i));
+			TRANSPOSE8_S16(__m128i, _mm, r);
+			for (int k = 0; k < 8; k++)
+				_mm_storeu_si128((__m128i *)(interleaved + (i + k) * channels + g), r[k]);
+		}
+		for (; i < frames; i++)
+			for (int ch = 0; ch < 8; ch++)
+				interleaved[i * channels + g + ch] = planar[(g + ch) * frames + i];
+	}
+}
+
+__attribute__((target("sse2")))
+static void sse2_s16_to_f32(float *dst, const int16_t *src, int n, float scale)
+{
+	__m128 vscale = _mm_set1_ps(scale);
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		/* Sign-extend by placing each sample in the top half and shifting back */
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+	}
+	scalar_s16_to_f32(dst + i, src + i, n - i, scale);
+}
+
+__attribute__((target("sse2")))
+static void sse2_f32_to_s16(int16_t *dst, const float *src, int n, float scale)
+{
+	__m128 vscale = _mm_set1_ps(scale);
+	__m128 vmax = _mm_set1_ps(S16_MAX_F);
+	__m128 vmin = _mm_set1_ps(S16_MIN_F);
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128 lo = _mm_mul_ps(_mm_loadu_ps(src + i), vscale);
+		__m128 hi = _mm_mul_ps(_mm_loadu_ps(src + i + 4), vscale);
+
+		lo = _mm_max_ps(_mm_min_ps(lo, vmax), vmin);
+		hi = _mm_max_ps(_mm_min_ps(hi, vmax), vmin);
+		_mm_storeu_si128((__m128i *)(dst + i),
+		                 _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+	}
+	scalar_f32_to_s16(dst + i, src + i, n - i, scale);
+}
+
+GEOMETRY_KERNELS(sse2, SSE2_ATTR)
+
+static const struct audio_kernels sse2_kernels = {
+	.name			= "sse2",
+	.deinterleave_s16	= sse2_deinterleave_s16,
+	.interleave_s16		= sse2_interleave_s16,
+	.s16_to_f32		= sse2_s16_to_f32,
+	.f32_to_s16		= sse2_f32_to_s16,
+	.blocks			= sse2_blocks,
+	.num_blocks		= sizeof(sse2_blocks) / sizeof(sse2_blocks[0]),
+};
+
+#define AVX2_ATTR	__attribute__((target("avx2")))
+
+/*
+ * Two frames per register: frame i in the low lane, frame i + 8 in the high
+ * lane. Stereo stays on the SSE2 path, 16 frames per 256-bit pair gains little.
+ */
+KERNEL_BODY AVX2_ATTR void avx2_deinterleave_body(int16_t *planar, const int16_t *interleaved,
+						  int channels, int frames)
+{
+	if (channels % 8) {
+		sse2_deinterleave_body(planar, interleaved, channels, frames);
+		return;
+	}
+	for (int g = 0; g < channels; g += 8) {
+		int i = 0;
+
+		for (; i < (frames & ~15); i += 16) {
+			__m256i r[8];
+
+			for (int k = 0; k < 8; k++) {
+				__m128i lo = _mm_loadu_si128((const __m128i *)(interleaved + (i + k) * channels + g));
+				__m128i hi = _mm_loadu_si128((const __m128i *)(interleaved + (i + k + 8) * channels + g));
+
+				r[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			}
+			TRANSPOSE8_S16(__m256i, _mm256, r);
+			for (int ch = 0; ch < 8; ch++)
+				_mm256_storeu_si256((__m256i *)(planar + (g + ch) * frames + i), r[ch]);
+		}
+		for (; i < frames; i++)
+			for (int ch = 0; ch < 8; ch++)
+				planar[(g + ch) * frames + i] = interleaved[i * channels + g + ch];
+	}
+}
+
+KERNEL_BODY AVX2_ATTR void avx2_interleave_body(int16_t *interleaved, const int16_t *planar,
+						int channels, int frames)
+{
+	if (channels % 8) {
+		sse2_interleave_body(interleaved, planar, channels, frames);
+		return;
+	}
+	for (int g = 0; g < channels; g += 8) {
+		int i = 0;
+
+		for (; i < (frames & ~15); i += 16) {
+			__m256i r[8];
+
+			for (int ch = 0; ch < 8; ch++)
+				r[ch] = _mm256_loadu_si256((const __m256i *)(planar + (g + ch) * frames + i));
+			TRANSPOSE8_S16(__m256i, _mm256, r);
+			for (int k = 0; k < 8; k++) {
+				_mm_storeu_si128((__m128i *)(interleaved + (i + k) * channels + g),
+				                 _mm256_castsi256_si128(r[k]));
+				_mm_storeu_si128((__m128i *)(interleaved + (i + k + 8) * channels + g),
+				                 _mm256_extracti128_si256(r[k], 1));
+			}
+		}
+		for (; i < frames; i++)
+			for (int ch = 0; ch < 8; ch++)
+				interleaved[i * channels + g + ch] = planar[(g + ch) * frames + i];
+	}
+}
+
+__attribute__((target("avx2")))
+static void avx2_s16_to_f32(float *dst, const int16_t *src, int n, float scale)
+{
+	__m256 vscale = _mm256_set1_ps(scale);
+	int i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)));
+
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), vscale));
+		_mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), vscale));
+	}
+	scalar_s16_to_f32(dst + i, src + i, n - i, scale);
+}
+
+__attribute__((target("avx2")))
+static void avx2_f32_to_s16(int16_t *dst, const float *src, int n, float scale)
+{
+	__m256 vscale = _mm256_set1_ps(scale);
+	__m256 vmax = _mm256_set1_ps(S16_MAX_F);
+	__m256 vmin = _mm256_set1_ps(S16_MIN_F);
+	int i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256 lo = _mm256_mul_ps(_mm256_loadu_ps(src + i), vscale);
+		__m256 hi = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), vscale);
+		__m256i packed;
+
+		lo = _mm256_max_ps(_mm256_min_ps(lo, vmax), vmin);
+		hi = _mm256_max_ps(_mm256_min_ps(hi, vmax), vmin);
+		/* packs works per lane: [lo0-3 hi0-3 | lo4-7 hi4-7], restore order */
+		packed = _mm256_packs_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi));
+		packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)(dst + i), packed);
+	}
+	scalar_f32_to_s16(dst + i, src + i, n - i, scale);
+}
+
+GEOMETRY_KERNELS(avx2, AVX2_ATTR)
+
+static const struct audio_kernels avx2_kernels = {
+	.name			= "avx2",
+	.deinterleave_s16	= avx2_deinterleave_s16,
+	.interleave_s16		= avx2_interleave_s16,
+	.s16_to_f32		= avx2_s16_to_f32,
+	.f32_to_s16		= avx2_f32_to_s16,
+	.blocks			= avx2_blocks,
+	.num_blocks		= sizeof(avx2_blocks) / sizeof(avx2_blocks[0]),
+};
+
+#endif /* HAVE_X86_KERNELS */
+
+// ====================== NEON =========================
+
+#ifdef HAVE_NEON_KERNELS
+
+/* 8x8 int16 transpose with vtrn on 16- and 32-bit pairs, then 64-bit halves */
+static inline void neon_transpose8_s16(int16x8_t r[8])
+{
+	int16x8x2_t t0 = vtrnq_s16(r[0], r[1]);
+	int16x8x2_t t1 = vtrnq_s16(r[2], r[3]);
+	int16x8x2_t t2 = vtrnq_s16(r[4], r[5]);
+	int16x8x2_t t3 = vtrnq_s16(r[6], r[7]);
+	int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+	int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+	int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+	int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+	r[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+	r[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+	r[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+	r[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+	r[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+	r[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+	r[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+	r[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+}
+
+/* Stereo uses the structure loads; multiples of 8 channels one transpose per group */
+KERNEL_BODY void neon_deinterleave_body(int16_t *planar, const int16_t *interleaved,
+					int channels, int frames)
+{
+	if (channels == 2) {
+		int i = 0;
+
+		for (; i < (frames & ~7); i += 8) {
+			int16x8x2_t lr = vld2q_s16(interleaved + i * 2);
+
+			vst1q_s16(planar + i, lr.val[0]);
+			vst1q_s16(planar + frames + i, lr.val[1]);
+		}
+		for (; i < frames; i++) {
+			planar[i] = interleaved[i * 2];
+			planar[frames + i] = interleaved[i * 2 + 1];
+		}
+		return;
+	}
+	if (channels % 8) {
+		scalar_deinterleave_body(planar, interleaved, channels, frames);
+		return;
+	}
+	for (int g = 0; g < channels; g += 8) {
+		int i = 0;
+
+		for (; i < (frames & ~7); i += 8) {
+			int16x8_t r[8];
+
+			for (int k = 0; k < 8; k++)
+				r[k] = vld1q_s16(interleaved + (i + k) * channels + g);
+			neon_transpose8_s16(r);
+			for (int ch = 0; ch < 8; ch++)
+				vst1q_s16(planar + (g + ch) * frames + i, r[ch]);
+		}
+		for (; i < frames; i++)
+			for (int ch = 0; ch < 8; ch++)
+				planar[(g + ch) * frames + i] = interleaved[i * channels + g + ch];
+	}
+}
+
+KERNEL_BODY void neon_interleave_body(int16_t *interleaved, const int16_t *planar,
+				      int channels, int frames)
+{
+	if (channels == 2) {
+		int i = 0;
+
+		for (; i < (frames & ~7); i += 8) {
+			int16x8x2_t lr = { { vld1q_s16(planar + i), vld1q_s16(planar + frames + i) } };
+
+			vst2q_s16(interleaved + i * 2, lr);
+		}
+		for (; i < frames; i++) {
+			interleaved[i * 2] = planar[i];
+			interleaved[i * 2 + 1] = planar[frames + i];
+		}
+		return;
+	}
+	if (channels % 8) {
+		scalar_interleave_body(interleaved, planar, channels, frames);
+		return;
+	}
+	for (int g = 0; g < channels; g += 8) {
+		int i = 0;
+
+		for (; i < (frames & ~7); i += 8) {
+			int16x8_t r[8];
+
+			for (int ch = 0; ch < 8; ch++)
+				r[ch] = vld1q_s16(planar + (g + ch) * frames + i);
+			neon_transpose8_s16(r);
+			for (int k = 0; k < 8; k++)
+				vst1q_s16(interleaved + (i + k) * channels + g, r[k]);
+		}
+		for (; i < frames; i++)
+			for (int ch = 0; ch < 8; ch++)
+				interleaved[i * channels + g + ch] = planar[(g + ch) * frames + i];
+	}
+}
+
+static void neon_s16_to_f32(float *dst, const int16_t *src, int n, float scale)
+{
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t s = vld1q_s16(src + i);
+
+		vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+		vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+	}
+	scalar_s16_to_f32(dst + i, src + i, n - i, scale);
+}
+
+static void neon_f32_to_s16(int16_t *dst, const float *src, int n, float scale)
+{
+	float32x4_t vmax = vdupq_n_f32(S16_MAX_F);
+	float32x4_t vmin = vdupq_n_f32(S16_MIN_F);
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		float32x4_t lo = vmulq_n_f32(vld1q_f32(src + i), scale);
+		float32x4_t hi = vmulq_n_f32(vld1q_f32(src + i + 4), scale);
+
+		lo = vmaxq_f32(vminq_f32(lo, vmax), vmin);
+		hi = vmaxq_f32(vminq_f32(hi, vmax), vmin);
+		vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)),
+		                                vqmovn_s32(vcvtq_s32_f32(hi))));
+	}
+	scalar_f32_to_s16(dst + i, src + i, n - i, scale);
+}
+
+GEOMETRY_KERNELS(neon, NO_ATTR)
+
+static const struct audio_kernels neon_kernels = {
+	.name			= "neon",
+	.deinterleave_s16	= neon_deinterleave_s16,
+	.interleave_s16		= neon_interleave_s16,
+	.s16_to_f32		= neon_s16_to_f32,
+	.f32_to_s16		= neon_f32_to_s16,
+	.blocks			= neon_blocks,
+	.num_blocks		= sizeof(neon_blocks) / sizeof(neon_blocks[0]),
+};
+
+#endif /* HAVE_NEON_KERNELS */
+
+// ====================== Dispatch =========================
+
+#define SELFTEST_FRAMES	67	/* not a multiple of any vector width, exercises the tails */
+#define SELFTEST_SAMPLES	(16 * 512)	/* largest block geometry */
+
+static const struct audio_kernels *active = &scalar_kernels;
+static const struct audio_block_kernels *bound;
+
+static int16_t src[SELFTEST_SAMPLES], ref[SELFTEST_SAMPLES], out[SELFTEST_SAMPLES];
+
+static int selftest_layout(const struct audio_kernels *k, int channels, int frames,
+			   const struct audio_block_kernels *b)
+{
+	size_t size = (size_t)channels * frames * sizeof(int16_t);
+
+	scalar_deinterleave_s16(ref, src, channels, frames);
+	if (b)
+		b->deinterleave_s16(out, src);
+	else
+		k->deinterleave_s16(out, src, channels, frames);
+	if (memcmp(ref, out, size))
+		return -1;
+
+	scalar_interleave_s16(ref, src, channels, frames);
+	if (b)
+		b->interleave_s16(out, src);
+	else
+		k->interleave_s16(out, src, channels, frames);
+	if (memcmp(ref, out, size))
+		return -1;
+	return 0;
+}
+
+/* Compare a candidate against the scalar reference on awkward inputs */
+static int audio_kernels_selftest(const struct audio_kernels *k)
+{
+	static const int layouts[] = { 2, 6, 8, 16 };
+	enum { N = SELFTEST_FRAMES * 8 };
+	float fsrc[N], fref[N], fout[N];
+	unsigned seed = 0x5eed;
+
+	for (int i = 0; i < SELFTEST_SAMPLES; i++) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = (int16_t)(seed >> 16);
+		/* Span past the int16 range, with fractions of both signs */
+		if (i < N)
+			fsrc[i] = (float)((int)(seed >> 8) % 90000 - 45000) + (float)(seed & 0xff) / 256.0f;
+	}
+	src[0] = INT16_MIN;
+	src[1] = INT16_MAX;
+
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+		if (selftest_layout(k, layouts[i], SELFTEST_FRAMES, NULL) < 0)
+			return -1;
+	for (int i = 0; i < k->num_blocks; i++)
+		if (selftest_layout(k, k->blocks[i].channels, k->blocks[i].frames, &k->blocks[i]) < 0)
+			return -1;
+
+	scalar_kernels.s16_to_f32(fref, src, N, 1.0f / 32768.0f);
+	k->s16_to_f32(fout, src, N, 1.0f / 32768.0f);
+	if (memcmp(fref, fout, sizeof(fref)))
+		return -1;
+
+	scalar_kernels.f32_to_s16(ref, fsrc, N, 0.75f);
+	k->f32_to_s16(out, fsrc, N, 0.75f);
+	if (memcmp(ref, out, N * sizeof(int16_t)))
+		return -1;
+
+	return 0;
+}
+
+static int audio_kernels_try(const struct audio_kernels *k)
+{
+	if (audio_kernels_selftest(k) < 0) {
+		printf("Audio kernels %s failed self-test, skipping\n", k->name);
+		return -1;
+	}
+	active = k;
+	return 0;
+}
+
+/*
+ * Pick the widest kernel set the CPU supports that matches the scalar
+ * reference. AUDIO_KERNELS=scalar|sse2|avx2|neon forces a set.
+ */
+int audio_kernels_init(void)
+{
+	const struct audio_kernels *candidates[4];
+	const char *force = getenv("AUDIO_KERNELS");
+	int n = 0;
+
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		candidates[n++] = &avx2_kernels;
+	if (__builtin_cpu_supports("sse2"))
+		candidates[n++] = &sse2_kernels;
+#endif
+#ifdef HAVE_NEON_KERNELS
+	candidates[n++] = &neon_kernels;
+#endif
+	candidates[n++] = &scalar_kernels;
+
+	active = &scalar_kernels;
+	for (int i = 0; i < n; i++) {
+		if (force && strcmp(force, candidates[i]->name) != 0)
+			continue;
+		if (audio_kernels_try(candidates[i]) == 0)
+			break;
+	}
+	if (force && strcmp(force, active->name) != 0)
+		printf("Audio kernels %s not available, using %s\n", force, active->name);
+
+	printf("Audio kernels: %s\n", active->name);
+	return 0;
+}
+
+const struct audio_kernels *audio_kernels_get(void)
+{
+	return active;
+}
+
+/* Call after audio_kernels_init, once the stream geometry is known */
+int audio_kernels_bind(int channels, int frames)
+{
+	bound = NULL;
+	for (int i = 0; i < active->num_blocks; i++) {
+		if (active->blocks[i].channels == channels && active->blocks[i].frames == frames) {
+			bound = &active->blocks[i];
+			break;
+		}
+	}
+	printf("Audio kernels: %d ch x %d frames, %s\n", channels, frames,
+	       bound ? "specialized" : "generic");
+	return bound ? 1 : 0;
+}
+
+void audio_deinterleave_s16(int16_t *planar, const int16_t *interleaved, int channels, int frames)
+{
+	if (bound && bound->channels == channels && bound->frames == frames)
+		bound->deinterleave_s16(planar, interleaved);
+	else
+		active->deinterleave_s16(planar, interleaved, channels, frames);
+}
+
+void audio_interleave_s16(int16_t *interleaved, const int16_t *planar, int channels, int frames)
+{
+	if (bound && bound->channels == channels && bound->frames == frames)
+		bound->interleave_s16(interleaved, planar);
+	else
+		active->interleave_s16(interleaved, planar, channels, frames);
+}
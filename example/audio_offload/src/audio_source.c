@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sndfile.h>
+#include "config.h"
+#include "audio_source.h"
+
+// ====================== File Source =========================
+
+static SNDFILE *sf;
+
+static int file_probe(int *channels, unsigned int *rate)
+{
+	SF_INFO sfinfo = {0};
+	SNDFILE *f = sf_open(app_config.sample_audio_file, SFM_READ, &sfinfo);
+
+	if (!f) {
+		fprintf(stderr, "\n*****ERROR***** Failed to open input WAV: %s\n\n",
+				sf_strerror(NULL));
+		return -1;
+	}
+	*channels = sfinfo.channels;
+	*rate = sfinfo.samplerate;
+	sf_close(f);
+	return 0;
+}
+
+/* The file must already be in the stream format, nothing is converted */
+static int file_open(int channels, unsigned int rate, struct alsa_pcm *sink)
+{
+	SF_INFO sfinfo = {0};
+
+	sf = sf_open(app_config.sample_audio_file, SFM_READ, &sfinfo);
+	if (!sf) {
+		fprintf(stderr, "\n*****ERROR***** Failed to open input WAV: %s\n\n",
+				sf_strerror(NULL));
+		return -1;
+	}
+	if (sfinfo.channels != channels || sfinfo.samplerate != (int)rate) {
+		fprintf(stderr, "\n*****ERROR***** WAV file must be %d-ch %uHz\n\n",
+				channels, rate);
+		sf_close(sf);
+		sf = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+static int file_read(int16_t *data, int frames, struct timespec *t_capture)
+{
+	memset(t_capture, 0, sizeof(*t_capture));
+	return sf_readf_short(sf, data, frames);
+}
+
+static void file_close(void)
+{
+	if (sf)
+		sf_close(sf);
+	sf = NULL;
+}
+
+// ====================== ALSA Capture Source =========================
+
+static struct alsa_pcm capture;
+
+/*
+ * Same geometry as playback, so one capture period becomes one playback
+ * period. Linking puts both on one start trigger and, on a single card,
+ * one clock; without it the two drift apart and xrun now and then.
+ */
+static int capture_open(int channels, unsigned int rate, struct alsa_pcm *sink)
+{
+	const char *device = app_config.capture_device[0] ? app_config.capture_device :
+			     app_config.pcm_device;
+	int err;
+
+	if (!sink) {
+		printf("[ALSA] capture needs a playback stream\n");
+		return -EINVAL;
+	}
+	err = alsa_pcm_open(&capture, device, SND_PCM_STREAM_CAPTURE, channels, rate,
+			    sink->period, sink->buffer / sink->period, 1, app_config.alsa_mmap);
+	if (err < 0)
+		return err;
+	if (capture.rate != sink->rate || capture.period != sink->period)
+		printf("[ALSA] capture runs at %u Hz / %lu-frame periods, playback at %u Hz / %lu\n",
+		       capture.rate, capture.period, sink->rate, sink->period);
+	alsa_pcm_link(&capture, sink);
+	return 0;
+}
+
+static int capture_read(int16_t *data, int frames, struct timespec *t_capture)
+{
+	return alsa_pcm_read(&capture, data, frames, t_capture);
+}
+
+static void capture_close(void)
+{
+	alsa_pcm_close(&capture);
+}
+
+static void capture_log_stats(void)
+{
+	log_alsa_stats(&capture);
+}
+
+// ====================== Selection =========================
+
+static const struct audio_source file_source = {
+	.name		= "file",
+	.probe		= file_probe,
+	.open		= file_open,
+	.read		= file_read,
+	.close		= file_close,
+};
+
+static const struct audio_source capture_source = {
+	.name		= "capture",
+	.open		= capture_open,
+	.read		= capture_read,
+	.close		= capture_close,
+	.log_stats	= capture_log_stats,
+};
+
+static const struct audio_source *sources[] = {
+	&file_source,
+	&capture_source,
+};
+
+const struct audio_source *audio_source_select(const char *name)
+{
+	for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+		if (strcmp(sources[i]->name, name) == 0)
+			return sources[i];
+	}
+	printf("Unknown audio source '%s'\n", name);
+	return NULL;
+}
@@ -20,6 +20,10 @@ static void trim(char *str)
 void init_config_defaults()
 {
 	app_config.pcm_device = strdup("default");
+	app_config.capture_device = strdup("");
+	app_config.audio_source = strdup("file");
+	app_config.offline_output = strdup("/tmp/dsp_offload_out.wav");
+	app_config.streams = strdup("");
 	app_config.uart_device = strdup("/dev/ttyS2");
 	app_config.rproc_dev_name = strdup("/dev/remoteproc0");
 	app_config.dma_heap_reserved = strdup("linux,cma");
@@ -28,19 +32,58 @@ void init_config_defaults()
 	app_config.c7_old_fw_path = strdup("/lib/firmware/ti-ipc/am62axx-c71-fw-old.xe71");
 	app_config.c7_new_fw_path = strdup("/lib/firmware/ti-ipc/am62axx-c71-fw-new.xe71");
 	app_config.c7_state_path= strdup("/sys/class/remoteproc/remoteproc0/state");
+	app_config.transport = strdup("rpmsg");
+	app_config.fftw_wisdom_file = strdup("/var/lib/dsp_offload/fftw_wisdom");
+	app_config.fftw_plan_rigor = strdup("MEASURE");
+	app_config.fir_coeff_file = strdup("");
+	app_config.rec_dir = strdup("/tmp");
+	app_config.rec_format = strdup("wav");
+	app_config.rt_process = strdup("");
+	app_config.rt_read = strdup("");
+	app_config.rt_complete = strdup("");
+	app_config.rt_dsp = strdup("");
+	app_config.rt_play = strdup("");
+	app_config.rt_reactor = strdup("");
+	app_config.rt_workers = strdup("");
 	app_config.c7_proc_id = 8;
 	app_config.remote_endpoint = 14;
 	app_config.data_buffer_size = 4096;
+	app_config.channels = 0;
+	app_config.sample_rate = 0;
+	app_config.block_frames = 0;
+	app_config.graph_id = 0;
+	app_config.stream_priority = 1;
+	app_config.stream_deadline_ms = 0;
+	app_config.dsp_max_inflight = 2;
 	app_config.param_buffer_size = 4096;
+	app_config.pipeline_depth = 3;
+	app_config.loopback_fixed_us = 200;
+	app_config.loopback_ns_per_kb = 0;
+	app_config.loopback_jitter_us = 0;
+	app_config.loopback_job_us = 0;
+	app_config.arm_workers = 1;
+	app_config.log_ring_kb = 64;
+	app_config.cpu_sample_ms = 100;
+	app_config.rec_channel_mask = 0xffff;
+	app_config.rec_file_mb = 64;
+	app_config.rec_mem_kb = 4096;
+	app_config.alsa_period_frames = 256;
+	app_config.alsa_periods = 3;
+	app_config.alsa_start_periods = 2;
 	app_config.fft_filter_enable = true;
 	app_config.is_host_eth_iface = true;
-	app_config.is_dsp_execution = true;
+	app_config.is_dsp_execution = 1;
 	app_config.enable_audio_logging = false;
+	app_config.rt_mlock = false;
+	app_config.alsa_mmap = true;
+	app_config.offline_mode = false;
 }
 
 // ========== Config Loader ==========
 void load_config(const char *filename)
 {
+	init_config_defaults();
+
 	FILE *fp = fopen(filename, "r");
 	if (!fp) {
 		perror("Failed to open config file");
@@ -59,6 +102,22 @@ void load_config(const char *filename)
 				free(app_config.pcm_device);
 				app_config.pcm_device = strdup(val);
 			}
+			else if (strcmp(key, "CAPTURE_DEVICE") == 0) {
+				free(app_config.capture_device);
+				app_config.capture_device = strdup(val);
+			}
+			else if (strcmp(key, "AUDIO_SOURCE") == 0) {
+				free(app_config.audio_source);
+				app_config.audio_source = strdup(val);
+			}
+			else if (strcmp(key, "OFFLINE_OUTPUT") == 0) {
+				free(app_config.offline_output);
+				app_config.offline_output = strdup(val);
+			}
+			else if (strcmp(key, "STREAMS") == 0) {
+				free(app_config.streams);
+				app_config.streams = strdup(val);
+			}
 			else if (strcmp(key, "UART_DEVICE") == 0) {
 				free(app_config.uart_device);
 				app_config.uart_device = strdup(val);
@@ -91,15 +150,92 @@ void load_config(const char *filename)
 				free(app_config.c7_state_path);
 				app_config.c7_state_path = strdup(val);
 			}
+			else if (strcmp(key, "TRANSPORT") == 0) {
+				free(app_config.transport);
+				app_config.transport = strdup(val);
+			}
+			else if (strcmp(key, "FFTW_WISDOM_FILE") == 0) {
+				free(app_config.fftw_wisdom_file);
+				app_config.fftw_wisdom_file = strdup(val);
+			}
+			else if (strcmp(key, "FIR_COEFF_FILE") == 0) {
+				free(app_config.fir_coeff_file);
+				app_config.fir_coeff_file = strdup(val);
+			}
+			else if (strcmp(key, "REC_DIR") == 0) {
+				free(app_config.rec_dir);
+				app_config.rec_dir = strdup(val);
+			}
+			else if (strcmp(key, "REC_FORMAT") == 0) {
+				free(app_config.rec_format);
+				app_config.rec_format = strdup(val);
+			}
+			else if (strcmp(key, "RT_PROCESS") == 0) {
+				free(app_config.rt_process);
+				app_config.rt_process = strdup(val);
+			}
+			else if (strcmp(key, "RT_READ") == 0) {
+				free(app_config.rt_read);
+				app_config.rt_read = strdup(val);
+			}
+			else if (strcmp(key, "RT_COMPLETE") == 0) {
+				free(app_config.rt_complete);
+	free(app_config.rt_dsp);
+				app_config.rt_complete = strdup(val);
+			}
+			else if (strcmp(key, "RT_DSP") == 0) {
+				free(app_config.rt_dsp);
+				app_config.rt_dsp = strdup(val);
+			}
+			else if (strcmp(key, "RT_PLAY") == 0) {
+				free(app_config.rt_play);
+				app_config.rt_play = strdup(val);
+			}
+			else if (strcmp(key, "RT_REACTOR") == 0) {
+				free(app_config.rt_reactor);
+				app_config.rt_reactor = strdup(val);
+			}
+			else if (strcmp(key, "RT_WORKERS") == 0) {
+				free(app_config.rt_workers);
+				app_config.rt_workers = strdup(val);
+			}
+			else if (strcmp(key, "FFTW_PLAN_RIGOR") == 0) {
+				free(app_config.fftw_plan_rigor);
+				app_config.fftw_plan_rigor = strdup(val);
+			}
 			// Integers
 			else if (strcmp(key, "C7_PROC_ID") == 0) app_config.c7_proc_id = atoi(val);
 			else if (strcmp(key, "REMOTE_ENDPT") == 0) app_config.remote_endpoint = atoi(val);
 			else if (strcmp(key, "DATA_SIZE") == 0) app_config.data_buffer_size = atoi(val);
+			else if (strcmp(key, "CHANNELS") == 0) app_config.channels = atoi(val);
+			else if (strcmp(key, "SAMPLE_RATE") == 0) app_config.sample_rate = atoi(val);
+			else if (strcmp(key, "BLOCK_FRAMES") == 0) app_config.block_frames = atoi(val);
+			else if (strcmp(key, "GRAPH_ID") == 0) app_config.graph_id = atoi(val);
+			else if (strcmp(key, "STREAM_PRIORITY") == 0) app_config.stream_priority = atoi(val);
+			else if (strcmp(key, "STREAM_DEADLINE_MS") == 0) app_config.stream_deadline_ms = atoi(val);
+			else if (strcmp(key, "DSP_MAX_INFLIGHT") == 0) app_config.dsp_max_inflight = atoi(val);
 			else if (strcmp(key, "PARAM_SIZE") == 0) app_config.param_buffer_size = atoi(val);
+			else if (strcmp(key, "PIPELINE_DEPTH") == 0) app_config.pipeline_depth = atoi(val);
 			else if (strcmp(key, "DSP_EXEC_MODE") == 0) app_config.is_dsp_execution = atoi(val);
 			else if (strcmp(key, "HOST_ETH_INTERFACE") == 0) app_config.is_host_eth_iface = atoi(val);
 			else if (strcmp(key, "FILTER_ENABLE") == 0) app_config.fft_filter_enable = atoi(val);
 			else if (strcmp(key, "AUDIO_LOGGING_ENABLE") == 0)  app_config.enable_audio_logging = atoi(val);
+			else if (strcmp(key, "LOOPBACK_FIXED_US") == 0) app_config.loopback_fixed_us = atoi(val);
+			else if (strcmp(key, "LOOPBACK_NS_PER_KB") == 0) app_config.loopback_ns_per_kb = atoi(val);
+			else if (strcmp(key, "LOOPBACK_JITTER_US") == 0) app_config.loopback_jitter_us = atoi(val);
+			else if (strcmp(key, "LOOPBACK_JOB_US") == 0) app_config.loopback_job_us = atoi(val);
+			else if (strcmp(key, "ARM_WORKERS") == 0) app_config.arm_workers = atoi(val);
+			else if (strcmp(key, "LOG_RING_KB") == 0) app_config.log_ring_kb = atoi(val);
+			else if (strcmp(key, "CPU_SAMPLE_MS") == 0) app_config.cpu_sample_ms = atoi(val);
+			else if (strcmp(key, "REC_CHANNELS") == 0) app_config.rec_channel_mask = strtoul(val, NULL, 0);
+			else if (strcmp(key, "REC_FILE_MB") == 0) app_config.rec_file_mb = atoi(val);
+			else if (strcmp(key, "REC_MEM_KB") == 0) app_config.rec_mem_kb = atoi(val);
+			else if (strcmp(key, "RT_MLOCK") == 0) app_config.rt_mlock = atoi(val);
+			else if (strcmp(key, "ALSA_PERIOD_FRAMES") == 0) app_config.alsa_period_frames = atoi(val);
+			else if (strcmp(key, "ALSA_PERIODS") == 0) app_config.alsa_periods = atoi(val);
+			else if (strcmp(key, "ALSA_START_PERIODS") == 0) app_config.alsa_start_periods = atoi(val);
+			else if (strcmp(key, "ALSA_MMAP") == 0) app_config.alsa_mmap = atoi(val);
+			else if (strcmp(key, "OFFLINE_MODE") == 0) app_config.offline_mode = atoi(val);
 		}
 	}
 	fclose(fp);
@@ -108,28 +244,69 @@ void load_config(const char *filename)
 void print_config()
 {
 	printf("PCM Device       : %s\n", app_config.pcm_device);
+	printf("Audio source : %s, capture device %s\n", app_config.audio_source,
+	       app_config.capture_device[0] ? app_config.capture_device : app_config.pcm_device);
+	printf("Offline mode : %d, output %s\n", app_config.offline_mode, app_config.offline_output);
+	printf("Main stream : graph %d, priority %d, deadline %d ms (0 = block), %d DSP jobs in flight\n",
+	       app_config.graph_id, app_config.stream_priority, app_config.stream_deadline_ms,
+	       app_config.dsp_max_inflight);
+	printf("Extra streams : %s\n", app_config.streams[0] ? app_config.streams : "none");
+	printf("ALSA : %d-frame periods x %d, start at %d periods, mmap %d\n",
+	       app_config.alsa_period_frames, app_config.alsa_periods, app_config.alsa_start_periods,
+	       app_config.alsa_mmap);
 	printf("UART Device       : %s\n", app_config.uart_device);
 	printf("Remoteproc Device : %s\n", app_config.rproc_dev_name);
 	printf("DMA Heap Reserved : %s\n", app_config.dma_heap_reserved);
 	printf("Sample Audio File : %s\n", app_config.sample_audio_file);
 	printf("Remote endpoint : %d\n",app_config.remote_endpoint);
 	printf("Date buffer size : %d\n", app_config.data_buffer_size);
+	printf("Stream : %d ch, %d Hz, %d-frame blocks (0 = auto)\n", app_config.channels,
+	       app_config.sample_rate, app_config.block_frames);
 	printf("param buffer size : %d\n", app_config.param_buffer_size);
+	printf("Pipeline depth : %d\n", app_config.pipeline_depth);
+	printf("ARM workers : %d\n", app_config.arm_workers);
+	printf("Log ring : %d KB\n", app_config.log_ring_kb);
+	printf("CPU sample period : %d ms\n", app_config.cpu_sample_ms);
 	printf("is DSP mode execution : %d\n", app_config.is_dsp_execution);
 	printf("Host eth interface : %d\n", app_config.is_host_eth_iface);
 	printf("Filter state : %d\n", app_config.fft_filter_enable);
 	printf("Audio logging to file : %d\n", app_config.enable_audio_logging);
+	printf("Recorder : %s/*.%s, channels 0x%x, %d MB files, %d KB memory\n", app_config.rec_dir,
+	       app_config.rec_format, app_config.rec_channel_mask, app_config.rec_file_mb,
+	       app_config.rec_mem_kb);
+	printf("RT profile : mlock %d, process '%s', read '%s', complete '%s', dsp '%s', play '%s', reactor '%s', workers '%s'\n",
+	       app_config.rt_mlock, app_config.rt_process, app_config.rt_read, app_config.rt_complete,
+	       app_config.rt_dsp, app_config.rt_play, app_config.rt_reactor, app_config.rt_workers);
 	printf("C7 new : %s\n", app_config.c7_new_fw_path);
 	printf("C7 old : %s\n", app_config.c7_old_fw_path);
 	printf("C7 state : %s\n", app_config.c7_state_path);
 	printf("C7 link : %s\n", app_config.fw_link_path);
+	printf("Transport : %s\n", app_config.transport);
+	printf("FFTW wisdom : %s (%s)\n", app_config.fftw_wisdom_file, app_config.fftw_plan_rigor);
+	printf("FIR coefficients : %s\n", app_config.fir_coeff_file[0] ? app_config.fir_coeff_file : "built-in");
 }
 
 void cleanup_config()
 {
 	free(app_config.pcm_device);
+	free(app_config.capture_device);
+	free(app_config.audio_source);
+	free(app_config.offline_output);
+	free(app_config.streams);
 	free(app_config.uart_device);
 	free(app_config.rproc_dev_name);
 	free(app_config.dma_heap_reserved);
 	free(app_config.sample_audio_file);
+	free(app_config.transport);
+	free(app_config.fftw_wisdom_file);
+	free(app_config.fftw_plan_rigor);
+	free(app_config.fir_coeff_file);
+	free(app_config.rec_dir);
+	free(app_config.rec_format);
+	free(app_config.rt_process);
+	free(app_config.rt_read);
+	free(app_config.rt_complete);
+	free(app_config.rt_play);
+	free(app_config.rt_reactor);
+	free(app_config.rt_workers);
 }
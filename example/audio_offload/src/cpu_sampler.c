@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "cpu_sampler.h"
+#include "host_interface.h"
+
+#define STAT_BUF_SIZE		4096
+
+static uint64_t ts_to_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* Busy and total jiffies of one "cpu" line, per core or the aggregate */
+struct cpu_ticks {
+	unsigned long long busy;
+	unsigned long long total;
+};
+
+static float ticks_util(struct cpu_ticks *prev, struct cpu_ticks cur)
+{
+	unsigned long long total = cur.total - prev->total;
+	float util = total ? 100.0f * (cur.busy - prev->busy) / total : 0.0f;
+
+	*prev = cur;
+	return util;
+}
+
+// ====================== CPU Sampler =========================
+
+/* Parse the aggregate and per-core lines of /proc/stat into the snapshot */
+static void sample_stat(struct cpu_sampler *s, struct cpu_snapshot *snap,
+                        struct cpu_ticks *prev_total, struct cpu_ticks *prev_core)
+{
+	char buf[STAT_BUF_SIZE];
+	ssize_t len = pread(s->stat_fd, buf, sizeof(buf) - 1, 0);
+	char *line = buf;
+
+	if (len <= 0)
+		return;
+	buf[len] = '\0';
+
+	while (line && strncmp(line, "cpu", 3) == 0) {
+		unsigned long long user, nice, sys, idle, iowait = 0, irq = 0, softirq = 0, steal = 0;
+		struct cpu_ticks t;
+		int core = -1;
+		char *p = line + 3;
+
+		if (*p != ' ')
+			core = strtol(p, &p, 10);
+		if (sscanf(p, "%llu %llu %llu %llu %llu %llu %llu %llu",
+		           &user, &nice, &sys, &idle, &iowait, &irq, &softirq, &steal) >= 4) {
+			t.busy = user + nice + sys + irq + softirq + steal;
+			t.total = t.busy + idle + iowait;
+			if (core < 0)
+				snap->total = ticks_util(prev_total, t);
+			else if (core < CPU_SAMPLER_MAX_CORES) {
+				snap->core[core] = ticks_util(&prev_core[core], t);
+				if (core + 1 > snap->cores)
+					snap->cores = core + 1;
+			}
+		}
+		line = strchr(line, '\n');
+		if (line)
+			line++;
+	}
+}
+
+static void sample_threads(struct cpu_sampler *s, struct cpu_snapshot *snap, uint64_t period_ns)
+{
+	pthread_mutex_lock(&s->reg_lock);
+	for (int i = 0; i < s->nthreads; i++) {
+		struct cpu_thread_sample *t = &snap->thread[i];
+		struct timespec ts;
+		uint64_t ns;
+
+		t->name = s->reg[i].name;
+		/* An exited thread keeps its last total and reads idle */
+		if (clock_gettime(s->reg[i].clock, &ts) < 0) {
+			t->util = 0.0f;
+			t->cpu_ns = s->reg[i].last_ns;
+			continue;
+		}
+		ns = ts_to_ns(&ts);
+		t->util = period_ns && ns >= s->reg[i].last_ns ?
+		          100.0f * (ns - s->reg[i].last_ns) / period_ns : 0.0f;
+		t->cpu_ns = ns;
+		s->reg[i].last_ns = ns;
+	}
+	snap->threads = s->nthreads;
+	pthread_mutex_unlock(&s->reg_lock);
+}
+
+static void sample_rusage(struct cpu_snapshot *snap, struct rusage *prev)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) < 0)
+		return;
+	snap->vol_ctxsw = ru.ru_nvcsw - prev->ru_nvcsw;
+	snap->invol_ctxsw = ru.ru_nivcsw - prev->ru_nivcsw;
+	snap->minflt = ru.ru_minflt - prev->ru_minflt;
+	snap->majflt = ru.ru_majflt - prev->ru_majflt;
+	*prev = ru;
+}
+
+static void publish(struct cpu_sampler *s, const struct cpu_snapshot *snap)
+{
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	s->snap = *snap;
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+static void *sampler_main(void *arg)
+{
+	struct cpu_sampler *s = arg;
+	struct cpu_ticks prev_total = { 0 }, prev_core[CPU_SAMPLER_MAX_CORES] = { { 0 } };
+	struct rusage prev_ru = { 0 };
+	struct cpu_snapshot snap;
+	struct timespec ts, sleep = {
+		.tv_sec = s->period_ms / 1000,
+		.tv_nsec = (s->period_ms % 1000) * 1000000L,
+	};
+	uint64_t last_ns = 0;
+
+	getrusage(RUSAGE_SELF, &prev_ru);
+	while (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE)) {
+		memset(&snap, 0, sizeof(snap));
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		snap.ts_ns = ts_to_ns(&ts);
+		sample_stat(s, &snap, &prev_total, prev_core);
+		sample_threads(s, &snap, last_ns ? snap.ts_ns - last_ns : 0);
+		sample_rusage(&snap, &prev_ru);
+		last_ns = snap.ts_ns;
+		publish(s, &snap);
+		nanosleep(&sleep, NULL);
+	}
+	return NULL;
+}
+
+int cpu_sampler_start(struct cpu_sampler *s, int period_ms)
+{
+	memset(s, 0, sizeof(*s));
+	pthread_mutex_init(&s->reg_lock, NULL);
+	s->period_ms = period_ms > 0 ? period_ms : 100;
+	s->stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+	if (s->stat_fd < 0) {
+		printf("Failed to open /proc/stat: %s\n", strerror(errno));
+		return -errno;
+	}
+	if (pthread_create(&s->thread, NULL, sampler_main, s) != 0) {
+		printf("Failed to start CPU sampler\n");
+		close(s->stat_fd);
+		s->stat_fd = -1;
+		return -EAGAIN;
+	}
+	cpu_sampler_add_thread(s, "sampler", s->thread);
+	return 0;
+}
+
+void cpu_sampler_stop(struct cpu_sampler *s)
+{
+	if (s->stat_fd < 0)
+		return;
+	__atomic_store_n(&s->stop, 1, __ATOMIC_RELEASE);
+	pthread_join(s->thread, NULL);
+	close(s->stat_fd);
+	s->stat_fd = -1;
+	pthread_mutex_destroy(&s->reg_lock);
+}
+
+/* Track a thread's CPU time; a thread registered again under the same name replaces the old one */
+int cpu_sampler_add_thread(struct cpu_sampler *s, const char *name, pthread_t thread)
+{
+	clockid_t clock;
+	struct timespec ts;
+	int i, ret = 0;
+
+	if (pthread_getcpuclockid(thread, &clock) != 0)
+		return -ESRCH;
+
+	pthread_mutex_lock(&s->reg_lock);
+	for (i = 0; i < s->nthreads; i++)
+		if (strcmp(s->reg[i].name, name) == 0)
+			break;
+	if (i == CPU_SAMPLER_MAX_THREADS) {
+		ret = -ENOSPC;
+	} else {
+		s->reg[i].name = name;
+		s->reg[i].clock = clock;
+		s->reg[i].last_ns = clock_gettime(clock, &ts) == 0 ? ts_to_ns(&ts) : 0;
+		if (i == s->nthreads)
+			s->nthreads++;
+	}
+	pthread_mutex_unlock(&s->reg_lock);
+	return ret;
+}
+
+/* Copy the latest snapshot; retries only while the sampler is mid-publish */
+void cpu_sampler_read(struct cpu_sampler *s, struct cpu_snapshot *out)
+{
+	uint32_t seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		*out = s->snap;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq)
+			return;
+	}
+}
+
+/* System-wide utilisation over the last period, % */
+float cpu_sampler_total(struct cpu_sampler *s)
+{
+	uint32_t seq;
+	float total;
+
+	for (;;) {
+		seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		total = s->snap.total;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq)
+			return total;
+	}
+}
+
+void log_cpu_snapshot(struct cpu_sampler *s)
+{
+	struct cpu_snapshot snap;
+	struct log_record *r;
+
+	cpu_sampler_read(s, &snap);
+	if ((r = log_begin(LOG_EV_CPU_SYS)) != NULL) {
+		r->a[0].f = snap.total;
+		r->a[1].i = snap.vol_ctxsw;
+		r->a[2].i = snap.invol_ctxsw;
+		r->a[3].i = snap.minflt;
+		r->a[4].i = snap.majflt;
+		log_end(r);
+	}
+	for (int i = 0; i < snap.cores; i++) {
+		if ((r = log_begin(LOG_EV_CPU_CORE)) == NULL)
+			return;
+		r->a[0].i = i;
+		r->a[1].f = snap.core[i];
+		log_end(r);
+	}
+	for (int i = 0; i < snap.threads; i++) {
+		if ((r = log_begin(LOG_EV_CPU_THREAD)) == NULL)
+			return;
+		r->a[0].s = snap.thread[i].name;
+		r->a[1].f = snap.thread[i].util;
+		r->a[2].f = snap.thread[i].cpu_ns / 1e6;
+		log_end(r);
+	}
+}
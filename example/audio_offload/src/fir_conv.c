@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include "fir_conv.h"
+#include "audio_kernels.h"
+
+/* The FFTW planner and wisdom store are not thread-safe, only fftwf_execute is */
+static pthread_mutex_t planner_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define CACHE_LINE	64
+
+static void *alloc_lines(size_t bytes)
+{
+	void *p = NULL;
+
+	if (posix_memalign(&p, CACHE_LINE, (bytes + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1)))
+		return NULL;
+	memset(p, 0, bytes);
+	return p;
+}
+
+// ====================== Plans and State =========================
+
+/* Map FFTW_PLAN_RIGOR names to planner flags, MEASURE by default */
+unsigned fir_conv_rigor(const char *name)
+{
+	if (!name)
+		return FFTW_MEASURE;
+	if (strcasecmp(name, "ESTIMATE") == 0)
+		return FFTW_ESTIMATE;
+	if (strcasecmp(name, "PATIENT") == 0)
+		return FFTW_PATIENT;
+	if (strcasecmp(name, "EXHAUSTIVE") == 0)
+		return FFTW_EXHAUSTIVE;
+	if (strcasecmp(name, "MEASURE") != 0)
+		printf("Unknown FFTW plan rigor %s, using MEASURE\n", name);
+	return FFTW_MEASURE;
+}
+
+int fir_conv_init(struct fir_conv *fc, int block, int channels, int groups,
+                  unsigned rigor, const char *wisdom_file)
+{
+	int per_line = CACHE_LINE / sizeof(fftwf_complex);
+	int fft_size = 2 * block;
+	int wisdom = 0, ok;
+	size_t fdl_len;
+
+	memset(fc, 0, sizeof(*fc));
+	if (groups < 1)
+		groups = 1;
+	if (groups > channels)
+		groups = channels;
+	if (groups > FIR_MAX_GROUPS)
+		groups = FIR_MAX_GROUPS;
+	fc->block = block;
+	fc->fft_size = fft_size;
+	fc->channels = channels;
+	fc->bins = block + 1;
+	fc->spec_dist = (fc->bins + per_line - 1) / per_line * per_line;
+	fc->groups = groups;
+	for (int g = 0; g <= groups; g++)
+		fc->first[g] = g * channels / groups;
+	fc->max_partitions = (FIR_MAX_TAPS + block - 1) / block;
+	pthread_mutex_init(&fc->load_lock, NULL);
+
+	fdl_len = (size_t)fc->max_partitions * channels * fc->spec_dist;
+	fc->in = alloc_lines((size_t)channels * fft_size * sizeof(float));
+	fc->fdl = alloc_lines(fdl_len * sizeof(fftwf_complex));
+	fc->acc = alloc_lines((size_t)channels * fc->spec_dist * sizeof(fftwf_complex));
+	fc->out = alloc_lines((size_t)channels * fft_size * sizeof(float));
+	fc->planar = alloc_lines((size_t)channels * block * sizeof(int16_t));
+	fc->h_time = alloc_lines(fft_size * sizeof(float));
+	for (int i = 0; i < 2; i++)
+		fc->filters[i].h = alloc_lines((size_t)fc->max_partitions * fc->spec_dist *
+		                               sizeof(fftwf_complex));
+	ok = fc->in && fc->fdl && fc->acc && fc->out && fc->planar && fc->h_time &&
+	     fc->filters[0].h && fc->filters[1].h;
+	if (!ok) {
+		printf("FIR convolution buffer allocation failed\n");
+		fir_conv_destroy(fc);
+		return -ENOMEM;
+	}
+	fc->active = &fc->filters[0];
+	fc->pending = &fc->filters[1];
+
+	pthread_mutex_lock(&planner_lock);
+	if (wisdom_file && wisdom_file[0])
+		wisdom = fftwf_import_wisdom_from_filename(wisdom_file);
+
+	/*
+	 * One batched plan per group and direction. The forward plan is run
+	 * with fftwf_execute_dft_r2c() into whichever delay line slot is
+	 * newest; every slot has the alignment of slot 0, which it is planned on.
+	 */
+	for (int g = 0; g < groups; g++) {
+		int c0 = fc->first[g], howmany = fc->first[g + 1] - c0;
+
+		fc->fwd[g] = fftwf_plan_many_dft_r2c(1, &fft_size, howmany,
+		                                     fc->in + c0 * fft_size, NULL, 1, fft_size,
+		                                     fc->fdl + c0 * fc->spec_dist, NULL,
+		                                     1, fc->spec_dist, rigor);
+		fc->bwd[g] = fftwf_plan_many_dft_c2r(1, &fft_size, howmany,
+		                                     fc->acc + c0 * fc->spec_dist, NULL,
+		                                     1, fc->spec_dist,
+		                                     fc->out + c0 * fft_size, NULL, 1, fft_size, rigor);
+		ok = ok && fc->fwd[g] && fc->bwd[g];
+	}
+	fc->hplan = fftwf_plan_dft_r2c_1d(fft_size, fc->h_time, fc->filters[0].h, rigor);
+	ok = ok && fc->hplan;
+
+	if (ok && wisdom_file && wisdom_file[0] &&
+	    !fftwf_export_wisdom_to_filename(wisdom_file))
+		printf("Failed to save FFTW wisdom to %s\n", wisdom_file);
+	pthread_mutex_unlock(&planner_lock);
+
+	/* Planning may scribble over the arrays */
+	memset(fc->in, 0, (size_t)channels * fft_size * sizeof(float));
+	memset(fc->fdl, 0, fdl_len * sizeof(fftwf_complex));
+
+	if (!ok) {
+		printf("FFTW planning failed for %d x %d\n", channels, fft_size);
+		fir_conv_destroy(fc);
+		return -EINVAL;
+	}
+	printf("FIR convolution ready: %d ch, block %d, %d groups (wisdom %s)\n", channels, block,
+	       groups, wisdom ? "loaded" : "not loaded");
+	return 0;
+}
+
+void fir_conv_destroy(struct fir_conv *fc)
+{
+	pthread_mutex_lock(&planner_lock);
+	for (int g = 0; g < FIR_MAX_GROUPS; g++) {
+		if (fc->fwd[g])
+			fftwf_destroy_plan(fc->fwd[g]);
+		if (fc->bwd[g])
+			fftwf_destroy_plan(fc->bwd[g]);
+	}
+	if (fc->hplan)
+		fftwf_destroy_plan(fc->hplan);
+	pthread_mutex_unlock(&planner_lock);
+	free(fc->in);
+	free(fc->fdl);
+	free(fc->acc);
+	free(fc->out);
+	free(fc->planar);
+	free(fc->h_time);
+	free(fc->filters[0].h);
+	free(fc->filters[1].h);
+	pthread_mutex_destroy(&fc->load_lock);
+	memset(fc, 0, sizeof(*fc));
+}
+
+// ====================== Filter Coefficients =========================
+
+/*
+ * Transform coefficients into partition spectra and queue them; the
+ * processing thread picks them up at the next block boundary.
+ */
+int fir_conv_set_filter(struct fir_conv *fc, const float *coeffs, int taps)
+{
+	struct fir_filter *f;
+	float scale = 1.0f / fc->fft_size;
+
+	if (taps < 1 || taps > FIR_MAX_TAPS)
+		return -E2BIG;
+
+	pthread_mutex_lock(&fc->load_lock);
+	f = fc->pending;
+	f->taps = taps;
+	f->partitions = (taps + fc->block - 1) / fc->block;
+	for (int p = 0; p < f->partitions; p++) {
+		int n = taps - p * fc->block;
+
+		if (n > fc->block)
+			n = fc->block;
+		memset(fc->h_time, 0, fc->fft_size * sizeof(float));
+		for (int i = 0; i < n; i++)
+			fc->h_time[i] = coeffs[p * fc->block + i] * scale;
+		fftwf_execute_dft_r2c(fc->hplan, fc->h_time, f->h + p * fc->spec_dist);
+	}
+	__atomic_store_n(&fc->pending_ready, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&fc->load_lock);
+	return 0;
+}
+
+/* Text file with one coefficient per line; '#' starts a comment line */
+int fir_conv_load_file(struct fir_conv *fc, const char *path)
+{
+	static float coeffs[FIR_MAX_TAPS];
+	static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+	char line[128];
+	int taps = 0, ret;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		printf("Failed to open FIR coefficient file %s: -%d\n", path, errno);
+		return -errno;
+	}
+
+	pthread_mutex_lock(&file_lock);
+	while (fgets(line, sizeof(line), fp)) {
+		char *end;
+		float v;
+
+		if (line[0] == '#')
+			continue;
+		v = strtof(line, &end);
+		if (end == line)
+			continue;
+		if (taps == FIR_MAX_TAPS) {
+			printf("FIR coefficient file %s has more than %d taps\n", path, FIR_MAX_TAPS);
+			taps = 0;
+			break;
+		}
+		coeffs[taps++] = v;
+	}
+	fclose(fp);
+
+	ret = taps ? fir_conv_set_filter(fc, coeffs, taps) : -EINVAL;
+	pthread_mutex_unlock(&file_lock);
+	if (ret == 0)
+		printf("Loaded %d-tap FIR filter from %s\n", taps, path);
+	return ret;
+}
+
+/* Blackman-windowed sinc lowpass with unity DC gain */
+int fir_conv_set_lowpass(struct fir_conv *fc, float cutoff_hz, float rate, int taps)
+{
+	float coeffs[FIR_MAX_TAPS];
+	double fc_norm = cutoff_hz / rate, sum = 0.0;
+	int mid = (taps - 1) / 2;
+
+	if (taps < 1 || taps > FIR_MAX_TAPS)
+		return -E2BIG;
+	for (int i = 0; i < taps; i++) {
+		double x = i - mid;
+		double sinc = x == 0 ? 2.0 * fc_norm : sin(2.0 * M_PI * fc_norm * x) / (M_PI * x);
+		double w = taps == 1 ? 1.0 : 0.42 - 0.5 * cos(2.0 * M_PI * i / (taps - 1)) +
+		                             0.08 * cos(4.0 * M_PI * i / (taps - 1));
+
+		coeffs[i] = sinc * w;
+		sum += coeffs[i];
+	}
+	for (int i = 0; i < taps; i++)
+		coeffs[i] /= sum;
+	return fir_conv_set_filter(fc, coeffs, taps);
+}
+
+// ====================== Block Processing =========================
+
+/* Slide each channel's input window: newest block becomes the previous one */
+static void push_history(struct fir_conv *fc, const int16_t *data)
+{
+	const struct audio_kernels *k = audio_kernels_get();
+	int block = fc->block;
+
+	audio_deinterleave_s16(fc->planar, data, fc->channels, block);
+	for (int ch = 0; ch < fc->channels; ch++) {
+		float *in = fc->in + ch * fc->fft_size;
+
+		memcpy(in, in + block, block * sizeof(float));
+		k->s16_to_f32(in + block, fc->planar + ch * block, block, 1.0f);
+	}
+}
+
+/* Start a block for all channels; runs on the calling thread before the groups fork */
+void fir_conv_load(struct fir_conv *fc, const int16_t *data)
+{
+	if (__atomic_load_n(&fc->pending_ready, __ATOMIC_ACQUIRE) &&
+	    pthread_mutex_trylock(&fc->load_lock) == 0) {
+		struct fir_filter *f = fc->active;
+
+		fc->active = fc->pending;
+		fc->pending = f;
+		__atomic_store_n(&fc->pending_ready, 0, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&fc->load_lock);
+	}
+	if (fc->stale) {
+		memset(fc->fdl, 0, (size_t)fc->max_partitions * fc->channels * fc->spec_dist *
+		                   sizeof(fftwf_complex));
+		fc->stale = false;
+	}
+	fc->head = (fc->head + 1) % fc->max_partitions;
+	push_history(fc, data);
+}
+
+/* Transform the group's newest input window into the delay line */
+void fir_conv_forward(struct fir_conv *fc, int group)
+{
+	int c0 = fc->first[group];
+
+	fftwf_execute_dft_r2c(fc->fwd[group], fc->in + c0 * fc->fft_size,
+	                      fc->fdl + ((size_t)fc->head * fc->channels + c0) * fc->spec_dist);
+}
+
+static void complex_mac(fftwf_complex *restrict acc, const fftwf_complex *restrict x,
+                        const fftwf_complex *restrict h, int bins, bool first)
+{
+	for (int k = 0; k < bins; k++) {
+		float re = x[k][0] * h[k][0] - x[k][1] * h[k][1];
+		float im = x[k][0] * h[k][1] + x[k][1] * h[k][0];
+
+		acc[k][0] = first ? re : acc[k][0] + re;
+		acc[k][1] = first ? im : acc[k][1] + im;
+	}
+}
+
+/* Multiply the delay line with every partition and return the group to the time domain */
+void fir_conv_filter(struct fir_conv *fc, int group)
+{
+	const struct fir_filter *f = fc->active;
+
+	for (int ch = fc->first[group]; ch < fc->first[group + 1]; ch++) {
+		fftwf_complex *acc = fc->acc + ch * fc->spec_dist;
+
+		for (int p = 0; p < f->partitions; p++) {
+			int slot = (fc->head - p + fc->max_partitions) % fc->max_partitions;
+			const fftwf_complex *x = fc->fdl + ((size_t)slot * fc->channels + ch) * fc->spec_dist;
+
+			complex_mac(acc, x, f->h + p * fc->spec_dist, fc->bins, p == 0);
+		}
+	}
+	fftwf_execute(fc->bwd[group]);
+}
+
+/* Channels [first_ch, end_ch) of the newest output block -> planar s16, saturated */
+void fir_conv_store_planar(struct fir_conv *fc, int16_t *planar, int first_ch, int end_ch)
+{
+	const struct audio_kernels *k = audio_kernels_get();
+
+	/* Overlap-save: only the second half of each circular convolution is valid */
+	for (int ch = first_ch; ch < end_ch; ch++)
+		k->f32_to_s16(planar + ch * fc->block, fc->out + ch * fc->fft_size + fc->block,
+		              fc->block, 1.0f);
+}
+
+void fir_conv_store(struct fir_conv *fc, int16_t *data)
+{
+	fir_conv_store_planar(fc, fc->planar, 0, fc->channels);
+	audio_interleave_s16(data, fc->planar, fc->channels, fc->block);
+}
+
+/* Pass a block through unfiltered; the delay line restarts when filtering resumes */
+void fir_conv_bypass(struct fir_conv *fc, const int16_t *data)
+{
+	push_history(fc, data);
+	fc->stale = true;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
@@ -6,341 +7,672 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <arpa/inet.h>
+#include <time.h>
 #include "host_interface.h"
 #include "config.h"
+#include "audio_kernels.h"
+#include "cpu_sampler.h"
+#include "recorder.h"
+#include "rt_profile.h"
 
 #define LOG_PORT    	8888
 #define CMD_PORT    	8889
 #define INDATA_PORT	8890
 #define OUTDATA_PORT	8891
-#define SEND_BUFFER_SIZE 16384
-
-typedef struct {
-	char log[1024];
-} logEntry;
-
-int uart_fd;
-int server_log_fd, client_log_fd;
-int server_cmd_fd, client_cmd_fd;
-int server_indata_fd, client_indata_fd;
-int server_outdata_fd, client_outdata_fd;
-struct sockaddr_in serv_addr, client_addr;
-socklen_t addr_len = sizeof(client_addr);
-FILE *fp_in = NULL;
-FILE *fp_out = NULL;
-pthread_t log_thread, cmd_thread, net_thread_log, net_thread_cmd, net_thread_indata, net_thread_outdata;
-uint8_t send_inbuffer[SEND_BUFFER_SIZE];
-size_t send_inoffset = 0;
-uint8_t send_outbuffer[SEND_BUFFER_SIZE];
-size_t send_outoffset = 0;
-logEntry log_queue[LOG_QUEUE_SIZE];
-int log_head = 0, log_tail = 0;
-pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
-bool isCmdConnected = false;
+
+/* Clients over all ports; each has its own bounded output queue */
+#define HOST_MAX_CLIENTS	16
+#define LOG_CLIENT_QUEUE	(64 * 1024)
+#define DATA_CLIENT_QUEUE	(256 * 1024)
+/* The reactor drains the log and tap rings at least this often; one audio block is ~5 ms */
+#define REACTOR_TICK_MS		2
+#define REACTOR_MAX_EVENTS	32
+
+/* Frames borrowed per direction; each holds a pipeline slot until the next tick */
+#define TAP_RING_SLOTS		16
+#define TAP_MAX_FRAMES		1024
+#define TAP_MAX_CHANNELS	16
+
+enum host_chan {
+	CHAN_LOG,
+	CHAN_CMD,
+	CHAN_INDATA,
+	CHAN_OUTDATA,
+	CHAN_COUNT
+};
+
+static const int chan_ports[CHAN_COUNT] = { LOG_PORT, CMD_PORT, INDATA_PORT, OUTDATA_PORT };
+static const char *const chan_names[CHAN_COUNT] = { "log", "cmd", "IN data", "OUT data" };
+
+/* epoll_event.data.u32 = kind | index */
+#define EV_LISTEN		0x10000
+#define EV_CLIENT		0x20000
+#define EV_INDEX(u)		((u) & 0xffff)
+
+struct host_client {
+	int fd;				/* -1 = free slot */
+	enum host_chan chan;
+	bool uart;			/* UART: takes commands and receives the log */
+	bool want_out;			/* EPOLLOUT armed */
+	char *out;			/* pending output, [out_off, out_len) */
+	size_t out_off;
+	size_t out_len;
+	size_t out_cap;
+	uint64_t dropped;		/* whole chunks/lines refused under backpressure */
+	char line[512];
+	int line_len;
+};
+
+/* Play stage -> reactor, single producer and single consumer */
+struct tap_ring {
+	struct tap_frame frames[TAP_RING_SLOTS];
+	uint32_t head __attribute__((aligned(64)));
+	uint32_t tail __attribute__((aligned(64)));
+};
+
+_Static_assert(sizeof(struct tap_header) == 24, "tap header layout is part of the wire format");
+
+int uart_fd = -1;
+pthread_t reactor_thread;
+struct log_ring log_ring;
+static int epoll_fd = -1;
+static int listen_fds[CHAN_COUNT] = { -1, -1, -1, -1 };
+static struct host_client clients[HOST_MAX_CLIENTS];
+static struct tap_ring taps[TAP_DIRS];
+static int tap_listeners[TAP_DIRS];		/* data clients, read by tap_publish() */
+static const char tap_tags[TAP_DIRS][4] = { "INPT", "OUTP" };
+static const char *const tap_names[TAP_DIRS] = { "in", "out" };
+static const char *const rec_thread_names[TAP_DIRS] = { "rec_in", "rec_out" };
+/* AUDIO_LOGGING_ENABLE captures, opened by the reactor on the first frame */
+static bool tap_recording;
+static struct recorder recorders[TAP_DIRS];
+static unsigned long rec_ring_drops[TAP_DIRS];	/* refused by a full tap ring while recording */
+static char rec_prefix[TAP_DIRS][200];
+static int host_stop;
 
 extern void enable_filter(bool value);
+extern int load_fir(const char *path);
+extern struct cpu_sampler cpu_sampler;
+
+//====================== Audio Taps =========================
 
-void* wait_for_indata_client(void* arg)
+int tap_publish(enum tap_dir dir, const struct tap_frame *frame)
 {
-	struct sockaddr_in client;
-	socklen_t client_len = sizeof(client);
-	listen(server_indata_fd, 1);
-	printf("Waiting for GUI IN data  connection on port %d...\n", INDATA_PORT);
-	client_indata_fd = accept(server_indata_fd, (struct sockaddr *)&client, &client_len);
-	printf("Log channel connected: %s\n", inet_ntoa(client.sin_addr));
-	fflush(stdout);
-	return NULL;
+	struct tap_ring *r = &taps[dir];
+	uint32_t head = r->head;
+
+	if (frame->frames > TAP_MAX_FRAMES || frame->channels > TAP_MAX_CHANNELS)
+		return -EINVAL;
+	if (!__atomic_load_n(&tap_listeners[dir], __ATOMIC_RELAXED) &&
+	    !__atomic_load_n(&tap_recording, __ATOMIC_RELAXED))
+		return -ENOTCONN;
+	if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= TAP_RING_SLOTS) {
+		if (__atomic_load_n(&tap_recording, __ATOMIC_RELAXED))
+			__atomic_add_fetch(&rec_ring_drops[dir], 1, __ATOMIC_RELAXED);
+		return -EAGAIN;
+	}
+	r->frames[head % TAP_RING_SLOTS] = *frame;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
 }
 
-void* wait_for_outdata_client(void* arg)
+/* Copy the masked channels out as planar blocks; returns the number of channels */
+static int tap_extract(int16_t *dst, const struct tap_frame *f)
 {
-	struct sockaddr_in client;
-	socklen_t client_len = sizeof(client);
-	listen(server_outdata_fd, 1);
-	printf("Waiting for GUI Out data  connection on port %d...\n", OUTDATA_PORT);
-	client_outdata_fd = accept(server_outdata_fd, (struct sockaddr *)&client, &client_len);
-	printf("Log channel connected: %s\n", inet_ntoa(client.sin_addr));
-	fflush(stdout);
-	return NULL;
+	uint32_t mask = f->channel_mask & ((1u << f->channels) - 1);
+	int n = 0;
+
+	if (mask == (1u << f->channels) - 1) {
+		audio_deinterleave_s16(dst, f->buf, f->channels, f->frames);
+		return f->channels;
+	}
+	for (int ch = 0; ch < f->channels; ch++) {
+		int16_t *out = dst + n * f->frames;
+
+		if (!(mask & (1u << ch)))
+			continue;
+		for (int i = 0; i < f->frames; i++)
+			out[i] = f->buf[i * f->channels + ch];
+		n++;
+	}
+	return n;
 }
 
-void* wait_for_log_client(void* arg)
+//====================== Logging =========================
+
+struct log_record *log_begin(enum log_event event)
 {
-	struct sockaddr_in client;
-	socklen_t client_len = sizeof(client);
-	listen(server_log_fd, 1);
-	printf("Waiting for GUI log connection on port %d...\n", LOG_PORT);
-	client_log_fd = accept(server_log_fd, (struct sockaddr *)&client, &client_len);
-	printf("Log channel connected: %s\n", inet_ntoa(client.sin_addr));
-	fflush(stdout);
-	return NULL;
+	return log_ring_reserve(&log_ring, event);
 }
 
-void* wait_for_cmd_client(void* arg)
+void log_end(struct log_record *rec)
 {
-	struct sockaddr_in client;
-	socklen_t client_len = sizeof(client);
-	listen(server_cmd_fd, 1);
-	printf("Waiting for GUI cmd connection on port %d...\n", CMD_PORT);
-	client_cmd_fd = accept(server_cmd_fd, (struct sockaddr *)&client, &client_len);
-	printf("Cmd channel connected: %s\n", inet_ntoa(client.sin_addr));
-	printf("Cmd channel accepted on fd %d\n", client_cmd_fd);
-	isCmdConnected = true;
-	fflush(stdout);
-	return NULL;
+	log_ring_commit(&log_ring, rec);
 }
 
-int init_indata_interface()
+static const char *mode_name(int64_t mode)
 {
-	struct sockaddr_in server;
-	int opt = 1;
-	server_indata_fd = socket(AF_INET, SOCK_STREAM, 0);
-	setsockopt(server_indata_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-	server.sin_family = AF_INET;
-	server.sin_port = htons(INDATA_PORT);
-	server.sin_addr.s_addr = INADDR_ANY;
-	bind(server_indata_fd, (struct sockaddr *)&server, sizeof(server));
-	pthread_create(&net_thread_indata, NULL, wait_for_indata_client, NULL);
-	return 0;
+	return mode == 0 ? "CPU" : mode == 1 ? "DSP" : "HYBRID";
 }
 
-int init_outdata_interface()
+/* Writer side: turn one record into its text line, returns the length */
+static int format_record(char *buf, size_t size, const struct log_record *r)
 {
-	struct sockaddr_in server;
-	int opt = 1;
-	server_outdata_fd = socket(AF_INET, SOCK_STREAM, 0);
-	setsockopt(server_outdata_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-	server.sin_family = AF_INET;
-	server.sin_port = htons(OUTDATA_PORT);
-	server.sin_addr.s_addr = INADDR_ANY;
-	bind(server_outdata_fd, (struct sockaddr *)&server, sizeof(server));
-	pthread_create(&net_thread_outdata, NULL, wait_for_outdata_client, NULL);
-	return 0;
+	const union log_arg *a = r->a;
+
+	switch (r->event) {
+	case LOG_EV_FRAME:
+		return snprintf(buf, size,
+				"Frame %ld: AvgAmp=%.2f, Latency=%.2fms, Mode=%s CPULoad=%.1f%% DSPLoad=%.1f%%\n",
+				(long)a[0].i, a[1].f, a[2].f, mode_name(a[3].i), a[4].f, a[5].f);
+	case LOG_EV_SUMMARY_FRAMES:
+		return snprintf(buf, size, "[Live Summary] Frames: %ld\n", (long)a[0].i);
+	case LOG_EV_SUMMARY_LATENCY:
+		return snprintf(buf, size, "[Live Summary] Latency (ms): Min: %.2f, Max: %.2f, Avg: %.2f\n",
+				a[0].f, a[1].f, a[2].f);
+	case LOG_EV_SUMMARY_AMP:
+		return snprintf(buf, size, "[Live Summary] Amp: Min: %.2f, Max: %.2f, Avg: %.2f\n",
+				a[0].f, a[1].f, a[2].f);
+	case LOG_EV_SUMMARY_CPU:
+		return snprintf(buf, size, "[Live Summary] CPU Load (%%): Min: %.1f, Max: %.1f, Avg: %.1f\n",
+				a[0].f, a[1].f, a[2].f);
+	case LOG_EV_SUMMARY_DSP:
+		return snprintf(buf, size, "[Live Summary] DSP Load (%%): Min: %.1f, Max: %.1f, Avg: %.1f\n",
+				a[0].f, a[1].f, a[2].f);
+	case LOG_EV_PIPELINE:
+		return snprintf(buf, size, "[Pipeline] %s: Depth Avg: %.2f, Max: %ld, Stalls: %ld/%ld\n",
+				a[0].s, a[1].f, (long)a[2].i, (long)a[3].i, (long)a[4].i);
+	case LOG_EV_WORKER:
+		return snprintf(buf, size,
+				"[Workers] w%ld: Jobs: %ld, Avg: %.3f ms, Max: %.3f ms, Wake: %.1f us\n",
+				(long)a[0].i, (long)a[1].i, a[2].f, a[3].f, a[4].f);
+	case LOG_EV_HYBRID:
+		return snprintf(buf, size,
+				"[Hybrid] DSP Channels: %ld/%ld, ARM/ch: %.3f ms, DSP/ch: %.3f ms, Slack: %.2f ms, Moves: %ld\n",
+				(long)a[0].i, (long)a[1].i, a[2].f, a[3].f, a[4].f, (long)a[5].i);
+	case LOG_EV_PCT_INTERVAL:
+	case LOG_EV_PCT_TOTAL:
+		return snprintf(buf, size,
+				"[Percentiles] %s %s: p50: %.2f, p90: %.2f, p99: %.2f, p99.9: %.2f, Max: %.2f\n",
+				a[0].s, r->event == LOG_EV_PCT_TOTAL ? "Total" : "Interval",
+				a[1].f, a[2].f, a[3].f, a[4].f, a[5].f);
+	case LOG_EV_CPU_SYS:
+		return snprintf(buf, size,
+				"[CPU] Total: %.1f%%, Ctxsw: %ld vol/%ld invol, Faults: %ld minor/%ld major\n",
+				a[0].f, (long)a[1].i, (long)a[2].i, (long)a[3].i, (long)a[4].i);
+	case LOG_EV_CPU_CORE:
+		return snprintf(buf, size, "[CPU] core%ld: %.1f%%\n", (long)a[0].i, a[1].f);
+	case LOG_EV_CPU_THREAD:
+		return snprintf(buf, size, "[CPU] %s: %.1f%%, Time: %.1f ms\n", a[0].s, a[1].f, a[2].f);
+	case LOG_EV_ALSA:
+		return snprintf(buf, size,
+				"[ALSA] %s: Xruns: %ld, Delay Avg: %.2f ms, Max: %.2f ms, Period: %ld, Buffer: %ld\n",
+				a[0].s, (long)a[1].i, a[2].f, a[3].f, (long)a[4].i, (long)a[5].i);
+	case LOG_EV_ROUNDTRIP:
+		return snprintf(buf, size, "[ALSA] Round trip (ms): Avg: %.2f, Min: %.2f, Max: %.2f, Frames: %ld\n",
+				a[0].f, a[1].f, a[2].f, (long)a[3].i);
+	case LOG_EV_STREAM:
+		return snprintf(buf, size, "[Stream] %s: graph %ld, prio %ld, jobs %ld, deadline misses %ld, dropped %ld\n",
+				a[0].s, (long)a[1].i, (long)a[2].i, (long)a[3].i, (long)a[4].i, (long)a[5].i);
+	case LOG_EV_STREAM_TIME:
+		return snprintf(buf, size,
+				"[Stream] %s (ms): Queued Avg: %.2f, Max: %.2f, Latency Avg: %.2f, Max: %.2f, DSP load: %.1f%%\n",
+				a[0].s, a[1].f, a[2].f, a[3].f, a[4].f, a[5].f);
+	default:
+		return snprintf(buf, size, "[Log] Unknown event %u\n", r->event);
+	}
 }
 
-int init_log_interface()
+
+//====================== I/O Reactor =========================
+
+static void set_nonblock(int fd)
 {
-	struct sockaddr_in server;
-	int opt = 1;
-	server_log_fd = socket(AF_INET, SOCK_STREAM, 0);
-	setsockopt(server_log_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-	server.sin_family = AF_INET;
-	server.sin_port = htons(LOG_PORT);
-	server.sin_addr.s_addr = INADDR_ANY;
-	bind(server_log_fd, (struct sockaddr *)&server, sizeof(server));
-	pthread_create(&net_thread_log, NULL, wait_for_log_client, NULL);
-	return 0;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 }
 
-int init_cmd_interface()
+static void client_arm(struct host_client *c, int idx, bool want_out)
 {
-	struct sockaddr_in server;
-	int opt = 1;
-	server_cmd_fd = socket(AF_INET, SOCK_STREAM, 0);
-	setsockopt(server_cmd_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-	server.sin_family = AF_INET;
-	server.sin_port = htons(CMD_PORT);
-	server.sin_addr.s_addr = INADDR_ANY;
-	bind(server_cmd_fd, (struct sockaddr *)&server, sizeof(server));
-	pthread_create(&net_thread_cmd, NULL, wait_for_cmd_client, NULL);
-	return 0;
+	struct epoll_event ev = {
+		.events = EPOLLIN | EPOLLRDHUP | (want_out ? EPOLLOUT : 0),
+		.data.u32 = EV_CLIENT | idx,
+	};
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+	c->want_out = want_out;
 }
 
-//====================== Logging Thread =========================
-void flush_send_input_buffer() {
-	if((client_indata_fd >= 0) && app_config.is_host_eth_iface)
-	{
-		if (send_inoffset > 0) {
-			send(client_indata_fd, send_inbuffer, send_inoffset, 0);
-			send_inoffset = 0;
+static int client_add(int fd, enum host_chan chan, bool uart)
+{
+	struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP };
+	struct host_client *c = NULL;
+	int idx;
+
+	for (idx = 0; idx < HOST_MAX_CLIENTS; idx++) {
+		if (clients[idx].fd < 0) {
+			c = &clients[idx];
+			break;
 		}
 	}
-	else
-		send_inoffset = 0;
+	if (!c) {
+		printf("Host %s client refused: %d clients connected\n", chan_names[chan], HOST_MAX_CLIENTS);
+		close(fd);
+		return -ENOSPC;
+	}
+
+	memset(c, 0, sizeof(*c));
+	c->chan = chan;
+	c->uart = uart;
+	if (chan != CHAN_CMD || uart) {
+		c->out_cap = chan == CHAN_INDATA || chan == CHAN_OUTDATA ?
+		             DATA_CLIENT_QUEUE : LOG_CLIENT_QUEUE;
+		c->out = malloc(c->out_cap);
+		if (!c->out) {
+			close(fd);
+			c->fd = -1;
+			return -ENOMEM;
+		}
+	}
+	set_nonblock(fd);
+	ev.data.u32 = EV_CLIENT | idx;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		free(c->out);
+		close(fd);
+		c->fd = -1;
+		return -errno;
+	}
+	c->fd = fd;
+	if (chan == CHAN_INDATA || chan == CHAN_OUTDATA)
+		__atomic_add_fetch(&tap_listeners[chan - CHAN_INDATA], 1, __ATOMIC_RELAXED);
+	return idx;
 }
 
-void enqueue_input_buffer(const char* tag, int16_t *buf, int num_frames, int num_channels, int ch)
+static void client_close(struct host_client *c)
 {
-	int tag_size = strlen(tag);
-	int size = num_frames * sizeof(int16_t);
+	printf("Host %s client on fd %d disconnected, %lu chunks dropped\n",
+	       c->uart ? "UART" : chan_names[c->chan], c->fd, (unsigned long)c->dropped);
+	if (c->chan == CHAN_INDATA || c->chan == CHAN_OUTDATA)
+		__atomic_sub_fetch(&tap_listeners[c->chan - CHAN_INDATA], 1, __ATOMIC_RELAXED);
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	free(c->out);
+	c->out = NULL;
+	c->fd = -1;
+}
 
-	if (send_inoffset + tag_size + size > SEND_BUFFER_SIZE) {
-		flush_send_input_buffer();
+/* Queue a whole chunk or nothing, so slow clients lose blocks but never see a torn one */
+static void client_queue(struct host_client *c, const struct iovec *iov, int iovcnt, size_t skip)
+{
+	size_t len = 0;
+
+	for (int i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+	len -= skip;
+	if (c->out_len - c->out_off + len > c->out_cap) {
+		c->dropped++;
+		return;
+	}
+	if (c->out_len + len > c->out_cap) {
+		memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+		c->out_len -= c->out_off;
+		c->out_off = 0;
 	}
-	memcpy(send_inbuffer + send_inoffset, tag, tag_size);
-	send_inoffset += tag_size;
-	for(int i = 0; i < num_frames; i++) {
-		((int16_t*)(send_inbuffer + send_inoffset))[i] = buf[i * num_channels + ch];
-		if(app_config.enable_audio_logging) {
-			if(fp_in != NULL)
-				fprintf(fp_in, "%d\n", buf[i * num_channels + ch]);
+	for (int i = 0; i < iovcnt; i++) {
+		size_t part = iov[i].iov_len;
+		const char *base = iov[i].iov_base;
+
+		if (skip >= part) {
+			skip -= part;
+			continue;
 		}
+		memcpy(c->out + c->out_len, base + skip, part - skip);
+		c->out_len += part - skip;
+		skip = 0;
 	}
-	send_inoffset += size;
 }
 
-void flush_send_output_buffer() {
-	if((client_outdata_fd >= 0) && app_config.is_host_eth_iface)
-	{
-		if (send_outoffset > 0) {
-			send(client_outdata_fd, send_outbuffer, send_outoffset, 0);
-			send_outoffset = 0;
+/*
+ * Idle clients get the chunk written straight from the caller's buffers;
+ * only what the socket does not take is copied into the client's queue.
+ * A client's queue always fits one chunk, so a partial write never drops.
+ */
+static void client_send(struct host_client *c, int idx, const struct iovec *iov, int iovcnt)
+{
+	ssize_t sent = 0;
+
+	if (c->out_off == c->out_len) {
+		sent = writev(c->fd, iov, iovcnt);
+		if (sent < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				client_close(c);
+				return;
+			}
+			sent = 0;
 		}
 	}
-	else
-		send_outoffset = 0;
+	client_queue(c, iov, iovcnt, sent);
+	if (c->out_len > c->out_off && !c->want_out)
+		client_arm(c, idx, true);
 }
 
-void enqueue_output_buffer(const char* tag, int16_t *buf, int num_frames, int num_channels, int ch)
+static void client_flush(struct host_client *c, int idx)
 {
-	int tag_size = strlen(tag);
-	int size = num_frames * sizeof(int16_t);
+	while (c->out_off < c->out_len) {
+		ssize_t n = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
 
-	if (send_outoffset + tag_size + size > SEND_BUFFER_SIZE) {
-		flush_send_output_buffer();
-	}
-	memcpy(send_outbuffer + send_outoffset, tag, tag_size);
-	send_outoffset += tag_size;
-	for(int i = 0; i < num_frames; i++) {
-		((int16_t*)(send_outbuffer + send_outoffset))[i] = buf[i * num_channels + ch];
-		if(app_config.enable_audio_logging) {
-			if(fp_out != NULL)
-				fprintf(fp_out, "%d\n", buf[i * num_channels + ch]);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			client_close(c);
+			return;
 		}
+		c->out_off += n;
+	}
+	if (c->out_off == c->out_len)
+		c->out_off = c->out_len = 0;
+	if ((c->out_len > 0) != c->want_out)
+		client_arm(c, idx, c->out_len > 0);
+}
+
+static void broadcast(enum host_chan chan, const struct iovec *iov, int iovcnt)
+{
+	for (int i = 0; i < HOST_MAX_CLIENTS; i++) {
+		struct host_client *c = &clients[i];
+
+		if (c->fd >= 0 && (c->chan == chan || (chan == CHAN_LOG && c->uart)))
+			client_send(c, i, iov, iovcnt);
 	}
-	send_outoffset += size;
 }
 
-void enqueue_log(const char *msg)
+static void handle_command(const char *line)
 {
-	if(client_log_fd >= 0) {
-		pthread_mutex_lock(&log_mutex);
-		snprintf(log_queue[log_tail].log, sizeof(log_queue[log_tail].log), "%s", msg);
-		log_tail = (log_tail + 1) % LOG_QUEUE_SIZE;
-		pthread_cond_signal(&log_cond);
-		pthread_mutex_unlock(&log_mutex);
+	if (strncmp(line, "SET FFT FILTER ", 15) == 0) {
+		int32_t v = 0;
+
+		sscanf(line + 15, "%d", &v);
+		enable_filter(v);
+	} else if (strncmp(line, "LOAD FIR ", 9) == 0) {
+		load_fir(line + 9);
 	}
 }
 
-void *log_writer(void *arg)
+static void client_read(struct host_client *c)
 {
-	if(client_log_fd >= 0) {
-		while (1) {
-			pthread_mutex_lock(&log_mutex);
-			while (log_head == log_tail)
-				pthread_cond_wait(&log_cond, &log_mutex);
-			char msg[256];
-			strlcpy(msg, log_queue[log_head].log, sizeof(msg));
-			log_head = (log_head + 1) % LOG_QUEUE_SIZE;
-			pthread_mutex_unlock(&log_mutex);
-			if (client_log_fd >= 0) {
-				if(app_config.is_host_eth_iface)
-					dprintf(client_log_fd, "%s\n", msg);
-				else
-					dprintf(uart_fd, "%s\n", msg);
+	char buf[256];
+	ssize_t n;
+
+	while ((n = read(c->fd, buf, sizeof(buf))) > 0) {
+		/* Only the command channel talks back; anything else is discarded */
+		if (c->chan != CHAN_CMD)
+			continue;
+		for (int i = 0; i < n; i++) {
+			char ch = buf[i];
+
+			if (ch == '\r')
+				continue;
+			if (ch == '\n' || c->line_len >= (int)sizeof(c->line) - 1) {
+				c->line[c->line_len] = '\0';
+				if (c->line_len > 0)
+					handle_command(c->line);
+				c->line_len = 0;
+			} else {
+				c->line[c->line_len++] = ch;
 			}
-			fflush(stdout);
 		}
 	}
-	return NULL;
+	if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		client_close(c);
 }
 
-void *cmd_listener(void *arg)
+static void accept_clients(enum host_chan chan)
 {
-	char buf[256];
-	int n;
-	fd_set readset;
-	struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
-	int cmd_fd;
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int fd;
 
-	while(!isCmdConnected)
-		sleep(1);
+	while ((fd = accept4(listen_fds[chan], (struct sockaddr *)&addr, &len,
+	                     SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		if (client_add(fd, chan, false) >= 0)
+			printf("GUI %s channel connected: %s on fd %d\n",
+			       chan_names[chan], inet_ntoa(addr.sin_addr), fd);
+		len = sizeof(addr);
+	}
+}
 
-	app_config.is_host_eth_iface ? (cmd_fd = client_cmd_fd) : (cmd_fd = uart_fd);
+/* Format everything the audio side logged and queue it for the log clients */
+static void drain_log(void)
+{
+	static uint64_t reported;
+	struct log_record *rec;
+	char out[4096];
+	size_t len = 0;
+	uint64_t drops;
 
-	while (1) {
-		FD_ZERO(&readset);
-		FD_SET(cmd_fd, &readset);
+	while ((rec = log_ring_peek(&log_ring)) != NULL) {
+		char line[256];
+		int n = format_record(line, sizeof(line), rec);
 
-		int ret = select(cmd_fd+1, &readset, NULL, NULL, &tv);
-		if (ret < 0) {
-			perror("select");
-			continue;
+		log_ring_consume(&log_ring);
+		if (n >= (int)sizeof(line))
+			n = sizeof(line) - 1;
+		if (len + n > sizeof(out)) {
+			broadcast(CHAN_LOG, &(struct iovec){ out, len }, 1);
+			len = 0;
 		}
-		if (ret == 0) {
-			continue;
+		memcpy(out + len, line, n);
+		len += n;
+	}
+	drops = log_ring_drops(&log_ring);
+	if (drops != reported && len + 64 <= sizeof(out)) {
+		len += snprintf(out + len, sizeof(out) - len,
+				"[Log] Dropped %lu records\n", (unsigned long)(drops - reported));
+		reported = drops;
+	}
+	if (len > 0)
+		broadcast(CHAN_LOG, &(struct iovec){ out, len }, 1);
+}
+
+/* The stream format is only known once frames arrive */
+static void rec_start(enum tap_dir dir, const struct tap_frame *f)
+{
+	struct recorder *rec = &recorders[dir];
+
+	if (recorder_open(rec, rec_prefix[dir], strcmp(app_config.rec_format, "raw") != 0,
+			  app_config.rec_channel_mask, f->channels, f->rate,
+			  (uint64_t)app_config.rec_file_mb << 20,
+			  (size_t)app_config.rec_mem_kb * 1024 / TAP_DIRS) < 0) {
+		printf("Recorder: cannot start the %s capture\n", tap_names[dir]);
+		__atomic_store_n(&tap_recording, false, __ATOMIC_RELAXED);
+		return;
+	}
+	cpu_sampler_add_thread(&cpu_sampler, rec_thread_names[dir], rec->thread);
+}
+
+/* Charge the frames the play stage could not queue to the recorder's drop count */
+static void rec_collect_drops(enum tap_dir dir)
+{
+	unsigned long lost = __atomic_exchange_n(&rec_ring_drops[dir], 0, __ATOMIC_RELAXED);
+
+	if (lost)
+		recorder_count_drops(&recorders[dir], lost);
+}
+
+static void tap_send(enum tap_dir dir, const struct tap_frame *f)
+{
+	static int16_t payload[TAP_MAX_CHANNELS * TAP_MAX_FRAMES];
+	struct tap_header hdr = {
+		.seq = f->seq,
+		.ts_ns = f->ts_ns,
+		.channel_mask = f->channel_mask & ((1u << f->channels) - 1),
+		.frames = f->frames,
+	};
+	int channels = tap_extract(payload, f);
+	struct iovec iov[2] = {
+		{ &hdr, sizeof(hdr) },
+		{ payload, (size_t)channels * f->frames * sizeof(int16_t) },
+	};
+
+	if (__atomic_load_n(&tap_recording, __ATOMIC_RELAXED)) {
+		if (!recorders[dir].nbufs)
+			rec_start(dir, f);
+		if (recorders[dir].nbufs) {
+			rec_collect_drops(dir);
+			recorder_write(&recorders[dir], f->buf, f->frames);
 		}
-		if (FD_ISSET(cmd_fd, &readset)) {
-			n = read(cmd_fd, buf, sizeof(buf)-1);
-			if (n <= 0) {
-				printf("cmd_listener: read returned %d\n", n);
-				close(cmd_fd);
-				break;
-			}
-			buf[n] = '\0';
-
-			static char linebuf[512];
-			static int lineofs = 0;
-			for (int i = 0; i < n; i++) {
-				char c = buf[i];
-				if (c == '\r') continue;
-				if (c == '\n' || lineofs >= (int)sizeof(linebuf)-1) {
-					linebuf[lineofs] = '\0';
-					if (lineofs > 0) {
-						if (strncmp(linebuf, "SET FFT FILTER ", 15)==0) {
-							int32_t v;
-							sscanf(linebuf+15, "%d",&v);
-							enable_filter(v);
-						}
-					}
-					lineofs = 0;
-				} else {
-					linebuf[lineofs++] = c;
-				}
+	}
+	/* The frame is not touched after this; the owner may recycle it */
+	f->release(f->ctx);
+	memcpy(hdr.tag, tap_tags[dir], sizeof(hdr.tag));
+	broadcast(CHAN_INDATA + dir, iov, 2);
+}
+
+static void drain_tap(enum tap_dir dir)
+{
+	struct tap_ring *r = &taps[dir];
+	uint32_t tail = r->tail;
+
+	while (tail != __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) {
+		struct tap_frame f = r->frames[tail % TAP_RING_SLOTS];
+
+		__atomic_store_n(&r->tail, ++tail, __ATOMIC_RELEASE);
+		tap_send(dir, &f);
+	}
+}
+
+/*
+ * Single I/O thread: owns every listening and client socket (non-blocking),
+ * formats the log and fans the taps out to all connected clients.
+ */
+static void *reactor_main(void *arg)
+{
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+
+	while (!__atomic_load_n(&host_stop, __ATOMIC_ACQUIRE)) {
+		int n = epoll_wait(epoll_fd, events, REACTOR_MAX_EVENTS, REACTOR_TICK_MS);
+
+		for (int i = 0; i < n; i++) {
+			uint32_t tag = events[i].data.u32;
+			struct host_client *c = &clients[EV_INDEX(tag)];
+
+			if (tag & EV_LISTEN) {
+				accept_clients(EV_INDEX(tag));
+				continue;
 			}
+			if (c->fd < 0)
+				continue;
+			if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+				client_read(c);
+			if (c->fd >= 0 && (events[i].events & EPOLLOUT))
+				client_flush(c, EV_INDEX(tag));
 		}
+
+		drain_log();
+		drain_tap(TAP_INPUT);
+		drain_tap(TAP_OUTPUT);
+		for (int i = 0; i < HOST_MAX_CLIENTS; i++)
+			if (clients[i].fd >= 0 && clients[i].out_len > clients[i].out_off)
+				client_flush(&clients[i], i);
+	}
+	for (int dir = 0; dir < TAP_DIRS; dir++) {
+		if (recorders[dir].nbufs)
+			rec_collect_drops(dir);
+		recorder_close(&recorders[dir]);
 	}
 	return NULL;
 }
 
+static int listen_port(enum host_chan chan)
+{
+	struct sockaddr_in server = {
+		.sin_family = AF_INET,
+		.sin_port = htons(chan_ports[chan]),
+		.sin_addr.s_addr = INADDR_ANY,
+	};
+	struct epoll_event ev = { .events = EPOLLIN, .data.u32 = EV_LISTEN | chan };
+	int opt = 1, fd;
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	if (bind(fd, (struct sockaddr *)&server, sizeof(server)) < 0 || listen(fd, 4) < 0 ||
+	    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		printf("Cannot listen on port %d: %s\n", chan_ports[chan], strerror(errno));
+		close(fd);
+		return -errno;
+	}
+	listen_fds[chan] = fd;
+	printf("Waiting for GUI %s connections on port %d...\n", chan_names[chan], chan_ports[chan]);
+	return 0;
+}
+
+static int open_uart(void)
+{
+	struct termios tty;
+
+	uart_fd = open(app_config.uart_device, O_RDWR | O_NOCTTY);
+	if (uart_fd < 0)
+		return -errno;
+
+	tcgetattr(uart_fd, &tty);
+	cfsetospeed(&tty, B115200);
+	cfsetispeed(&tty, B115200);
+	tty.c_cflag |= (CLOCAL | CREAD);
+	tty.c_cflag &= ~CSIZE;
+	tty.c_cflag |= CS8;
+	tty.c_cflag &= ~PARENB & ~CSTOPB & ~CRTSCTS;
+	tty.c_lflag = tty.c_oflag = 0;
+	tty.c_cc[VMIN] = 1;
+	tcsetattr(uart_fd, TCSANOW, &tty);
+	return client_add(uart_fd, CHAN_CMD, true);
+}
+
 void init_host_interface()
 {
+	for (int i = 0; i < HOST_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+		perror("epoll_create1"), exit(1);
+
 	if(app_config.is_host_eth_iface) {
-		init_log_interface();
-		init_cmd_interface();
-		init_indata_interface();
-		init_outdata_interface();
-	} else {
-		uart_fd = open(app_config.uart_device, O_RDWR | O_NOCTTY);
-		if (uart_fd < 0) perror("UART open failed"), exit(1);
-
-		struct termios tty;
-		tcgetattr(uart_fd, &tty);
-		cfsetospeed(&tty, B115200);
-		cfsetispeed(&tty, B115200);
-		tty.c_cflag |= (CLOCAL | CREAD);
-		tty.c_cflag &= ~CSIZE;
-		tty.c_cflag |= CS8;
-		tty.c_cflag &= ~PARENB & ~CSTOPB & ~CRTSCTS;
-		tty.c_lflag = tty.c_oflag = 0;
-		tty.c_cc[VMIN] = 1;
-		tcsetattr(uart_fd, TCSANOW, &tty);
-		isCmdConnected = true;
+		for (int chan = 0; chan < CHAN_COUNT; chan++)
+			listen_port(chan);
+	} else if (open_uart() < 0) {
+		perror("UART open failed");
+		exit(1);
 	}
 	setvbuf(stdout, NULL, _IONBF, 0);
-	pthread_create(&log_thread, NULL, log_writer, NULL);
-	pthread_create(&cmd_thread, NULL, cmd_listener, NULL);
-
+	if (log_ring_init(&log_ring, (size_t)app_config.log_ring_kb * 1024) == 0)
+		printf("Log ring: %u records\n", log_ring.mask + 1);
 	if(app_config.enable_audio_logging) {
-		fp_in = fopen("/tmp/wave_in_ch0.txt", "w");
-		fp_out = fopen("/tmp/wave_out_ch0.txt", "w");
-		if (!fp_in || !fp_out)
-			fprintf(stderr, "\n*****ERROR***** log file open error: %s\n\n", strerror(errno));
+		char stamp[32];
+		time_t now = time(NULL);
+
+		strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+		for (int dir = 0; dir < TAP_DIRS; dir++)
+			snprintf(rec_prefix[dir], sizeof(rec_prefix[dir]), "%s/rec_%s_%s",
+				 app_config.rec_dir, tap_names[dir], stamp);
+		__atomic_store_n(&tap_recording, true, __ATOMIC_RELAXED);
 	}
+	pthread_create(&reactor_thread, NULL, reactor_main, NULL);
+	cpu_sampler_add_thread(&cpu_sampler, "reactor", reactor_thread);
+	rt_apply("reactor", reactor_thread, app_config.rt_reactor);
+
 }
 
+/* Stops the I/O thread and flushes the recordings; the audio side must be idle */
+void close_host_interface()
+{
+	if (__atomic_exchange_n(&host_stop, 1, __ATOMIC_ACQ_REL))
+		return;
+	pthread_join(reactor_thread, NULL);
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "hybrid.h"
+#include "host_interface.h"
+
+#define HYBRID_EMA_ALPHA	0.125f
+/* DSP utilisation (params_t.dsp_load, %) above which it must shed channels */
+#define HYBRID_DSP_LOAD_MAX	90.0f
+
+// ====================== Hybrid ARM+DSP Load Balancer =========================
+
+void hybrid_init(struct hybrid_balancer *b, int channels, float frame_ms)
+{
+	b->channels = channels;
+	b->dsp_channels = channels / 2;
+	b->frame_ms = frame_ms;
+	b->arm_ch_ms = 0.0f;
+	b->dsp_ch_ms = 0.0f;
+	b->slack_ms = frame_ms;
+	b->moves = 0;
+	b->pinned = false;
+}
+
+int hybrid_dsp_channels(struct hybrid_balancer *b)
+{
+	return __atomic_load_n(&b->dsp_channels, __ATOMIC_RELAXED);
+}
+
+static float ema(float avg, float sample)
+{
+	return avg == 0.0f ? sample : avg + HYBRID_EMA_ALPHA * (sample - avg);
+}
+
+/*
+ * Feed back one finished frame that was split with dsp_channels on the DSP.
+ * The split follows the point where both sides take equally long, one
+ * channel per frame, and both sides always keep at least one channel so
+ * their costs stay measurable. A frame that missed its deadline moves a
+ * channel off the slower side whatever the costs say. mask_done is false
+ * when the firmware did not confirm the channel mask: it then processed
+ * every channel, the costs mean nothing, and all channels stay on the DSP.
+ */
+void hybrid_update(struct hybrid_balancer *b, int dsp_channels, float arm_ms, float dsp_ms,
+                   float dsp_load, bool mask_done)
+{
+	int arm_channels = b->channels - dsp_channels;
+	int cur = b->dsp_channels, target, limit = b->channels - 1;
+
+	if (b->pinned)
+		return;
+	if (!mask_done) {
+		printf("[Hybrid] DSP firmware ignores channel_mask, running all channels on the DSP\n");
+		__atomic_store_n(&b->dsp_channels, b->channels, __ATOMIC_RELAXED);
+		b->pinned = true;
+		return;
+	}
+
+	if (dsp_channels > 0)
+		b->dsp_ch_ms = ema(b->dsp_ch_ms, dsp_ms / dsp_channels);
+	if (arm_channels > 0)
+		b->arm_ch_ms = ema(b->arm_ch_ms, arm_ms / arm_channels);
+	b->slack_ms = b->frame_ms - (arm_ms > dsp_ms ? arm_ms : dsp_ms);
+
+	if (b->arm_ch_ms + b->dsp_ch_ms <= 0.0f)
+		return;
+	target = (int)(b->channels * b->arm_ch_ms / (b->arm_ch_ms + b->dsp_ch_ms) + 0.5f);
+	if (b->slack_ms < 0.0f) {
+		if (dsp_ms > arm_ms && target >= dsp_channels)
+			target = dsp_channels - 1;
+		else if (arm_ms >= dsp_ms && target <= dsp_channels)
+			target = dsp_channels + 1;
+	}
+
+	/* A saturated DSP cannot take more, whatever the latency says */
+	if (dsp_load > HYBRID_DSP_LOAD_MAX && dsp_channels > 0) {
+		int fit = (int)(dsp_channels * HYBRID_DSP_LOAD_MAX / dsp_load);
+
+		if (fit < limit)
+			limit = fit;
+	}
+	if (target > limit)
+		target = limit;
+	if (target < 1)
+		target = 1;
+
+	if (target != cur) {
+		cur += target > cur ? 1 : -1;
+		__atomic_store_n(&b->dsp_channels, cur, __ATOMIC_RELAXED);
+		b->moves++;
+	}
+}
+
+void log_hybrid_stats(struct hybrid_balancer *b)
+{
+	struct log_record *r = log_begin(LOG_EV_HYBRID);
+
+	if (!r)
+		return;
+	r->a[0].i = hybrid_dsp_channels(b);
+	r->a[1].i = b->channels;
+	r->a[2].f = b->arm_ch_ms;
+	r->a[3].f = b->dsp_ch_ms;
+	r->a[4].f = b->slack_ms;
+	r->a[5].i = b->moves;
+	log_end(r);
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "log_ring.h"
+
+// ====================== SPSC Log Ring =========================
+
+/* bytes is rounded down to a power of two records, at least 16 */
+int log_ring_init(struct log_ring *ring, size_t bytes)
+{
+	size_t count = 16;
+
+	memset(ring, 0, sizeof(*ring));
+	while (count * 2 * sizeof(struct log_record) <= bytes)
+		count *= 2;
+
+	if (posix_memalign((void **)&ring->recs, 64, count * sizeof(struct log_record)) != 0) {
+		printf("Failed to allocate %zu log records\n", count);
+		return -ENOMEM;
+	}
+	/* Fault the pages in now, not on the first records from the audio thread */
+	memset(ring->recs, 0, count * sizeof(struct log_record));
+	ring->mask = count - 1;
+	return 0;
+}
+
+void log_ring_destroy(struct log_ring *ring)
+{
+	free(ring->recs);
+	ring->recs = NULL;
+}
+
+/* Returns the record to fill, or NULL (and one more drop) if the ring is full */
+struct log_record *log_ring_reserve(struct log_ring *ring, uint16_t event)
+{
+	uint32_t head = ring->head;
+	struct log_record *rec;
+	struct timespec ts;
+
+	if (!ring->recs)
+		return NULL;
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->mask) {
+		__atomic_store_n(&ring->drops, ring->drops + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	rec = &ring->recs[head & ring->mask];
+	rec->event = event;
+	rec->ts_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return rec;
+}
+
+/* Publish the record returned by the last log_ring_reserve() */
+void log_ring_commit(struct log_ring *ring, struct log_record *rec)
+{
+	(void)rec;
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/* Oldest unread record, or NULL if the ring is empty */
+struct log_record *log_ring_peek(struct log_ring *ring)
+{
+	uint32_t tail = ring->tail;
+
+	if (!ring->recs || tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+		return NULL;
+	return &ring->recs[tail & ring->mask];
+}
+
+/* Release the record returned by log_ring_peek() back to the producer */
+void log_ring_consume(struct log_ring *ring)
+{
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t log_ring_drops(struct log_ring *ring)
+{
+	return __atomic_load_n(&ring->drops, __ATOMIC_RELAXED);
+}
@@ -6,95 +6,204 @@
 
 #define MAX_LOG_LINE 2048*12
 
-// ====================== Metrics & Logging  =========================
+// ====================== Log-Linear Histograms =========================
 
-float get_cpu_load()
+void hist_init(struct hist *h, double scale)
 {
-	static long last_user=0, last_nice=0, last_system=0, last_idle=0;
-	long user, nice, system, idle;
-	FILE *fp = fopen("/proc/stat", "r");
-	if (!fp) return -1;
-	fscanf(fp, "cpu %ld %ld %ld %ld", &user, &nice, &system, &idle);
-	fclose(fp);
-	long total = (user-last_user)+(nice-last_nice)+(system-last_system);
-	long total_all = total + (idle-last_idle);
-	last_user=user;
-	last_nice=nice;
-	last_system=system;
-	last_idle=idle;
-	return total_all ? (100.0f * total / total_all) : 0.0f;
+	h->scale = scale;
+	hist_reset(h);
 }
 
-void update_metrics(float lat, float amp, float cpu, float dsp,
-                    double *total_latency, double *min_latency, double *max_latency,
-                    double *total_amp, double *min_amp, double *max_amp,
-                    double *total_cpu, double *min_cpu, double *max_cpu,
-                    double *total_dsp, double *min_dsp, double *max_dsp)
+void hist_reset(struct hist *h)
 {
-	*total_latency += lat;
-	if (lat < *min_latency) *min_latency = lat;
-	if (lat > *max_latency) *max_latency = lat;
+	h->count = 0;
+	h->sum = 0.0;
+	h->min = 0.0;
+	h->max = 0.0;
+	memset(h->counts, 0, sizeof(h->counts));
+}
 
-	*total_amp += amp;
-	if (amp < *min_amp) *min_amp = amp;
-	if (amp > *max_amp) *max_amp = amp;
+static int hist_index(uint64_t v)
+{
+	int shift;
 
-	*total_cpu += cpu;
-	if (cpu < *min_cpu) *min_cpu = cpu;
-	if (cpu > *max_cpu) *max_cpu = cpu;
+	if (v < 2 * HIST_SUB_COUNT)
+		return v;
+	if (v > UINT32_MAX)
+		v = UINT32_MAX;
+	shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+	return shift * HIST_SUB_COUNT + (v >> shift);
+}
 
-	*total_dsp += dsp;
-	if (dsp < *min_dsp) *min_dsp = dsp;
-	if (dsp > *max_dsp) *max_dsp = dsp;
+/* Middle of the value range covered by bucket idx, in units */
+static double hist_value(int idx)
+{
+	int shift;
+
+	if (idx < 2 * HIST_SUB_COUNT)
+		return idx;
+	shift = idx / HIST_SUB_COUNT - 1;
+	return ((double)(idx - shift * HIST_SUB_COUNT) + 0.5) * (1ULL << shift);
 }
 
-void log_input_audio(int16_t *buf, int num_frames, int num_channels, int ch)
+void hist_record(struct hist *h, double value)
 {
-	int16_t size = num_frames * num_channels * 2;
-	int16_t inbuf[size];
+	double units = value * h->scale;
+
+	h->counts[hist_index(units > 0.0 ? (uint64_t)(units + 0.5) : 0)]++;
+	if (!h->count || value < h->min)
+		h->min = value;
+	if (!h->count || value > h->max)
+		h->max = value;
+	h->sum += value;
+	h->count++;
+}
+
+void hist_merge(struct hist *dst, const struct hist *src)
+{
+	if (!src->count)
+		return;
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (!dst->count || src->max > dst->max)
+		dst->max = src->max;
+	dst->sum += src->sum;
+	dst->count += src->count;
+	for (int i = 0; i < HIST_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+}
+
+/* Value at or below which pct percent of the samples fall, clamped to the exact max */
+double hist_percentile(const struct hist *h, double pct)
+{
+	uint64_t rank, seen = 0;
+
+	if (!h->count)
+		return 0.0;
+	rank = (uint64_t)(pct / 100.0 * h->count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->counts[i];
+		if (seen >= rank) {
+			double v = hist_value(i) / h->scale;
+
+			return v > h->max ? h->max : v < h->min ? h->min : v;
+		}
+	}
+	return h->max;
+}
+
+// ====================== Metrics & Logging  =========================
+
+/* Name used in the log lines and histogram units per value of each metric */
+static const struct {
+	const char *name;
+	double scale;
+} metric_desc[METRIC_COUNT] = {
+	[METRIC_LATENCY]	= { "Latency (ms)", 1000.0 },	/* us resolution */
+	[METRIC_AMP]		= { "Amp", 1.0 },
+	[METRIC_CPU]		= { "CPU Load (%)", 100.0 },
+	[METRIC_DSP]		= { "DSP Load (%)", 100.0 },
+};
 
-	memcpy(inbuf, buf, size);
-	enqueue_input_buffer("INPT", inbuf, num_frames, num_channels, ch);
+void metrics_init(struct metrics *m)
+{
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		hist_init(&m->interval[i], metric_desc[i].scale);
+		hist_init(&m->total[i], metric_desc[i].scale);
+	}
 }
 
-void log_output_audio(int16_t *buf, int num_frames, int num_channels, int ch)
+/* Fold another thread's or stream's metrics into dst */
+void metrics_merge(struct metrics *dst, const struct metrics *src)
 {
-	int16_t size = num_frames * num_channels * 2;
-	int16_t outbuf[size];
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		hist_merge(&dst->interval[i], &src->interval[i]);
+		hist_merge(&dst->total[i], &src->total[i]);
+	}
+}
 
-	memcpy(outbuf, buf, size);
-	enqueue_output_buffer("OUTP", outbuf, num_frames, num_channels, ch);
+void update_metrics(struct metrics *m, float lat, float amp, float cpu, float dsp)
+{
+	hist_record(&m->interval[METRIC_LATENCY], lat);
+	hist_record(&m->interval[METRIC_AMP], amp);
+	hist_record(&m->interval[METRIC_CPU], cpu);
+	hist_record(&m->interval[METRIC_DSP], dsp);
 }
 
 void log_frame_metrics(int exec_mode, int frames, float amp, float lat, float cpu, float dsp)
 {
-	char logbuf[256];
-	snprintf(logbuf, sizeof(logbuf),
-			"Frame %d: AvgAmp=%.2f, Latency=%.2fms, Mode=%s CPULoad=%.1f%% DSPLoad=%.1f%%",
-			frames, amp, lat, exec_mode == 0 ? "CPU" : "DSP", cpu, dsp);
-	enqueue_log(logbuf);
+	struct log_record *r = log_begin(LOG_EV_FRAME);
+
+	if (!r)
+		return;
+	r->a[0].i = frames;
+	r->a[1].f = amp;
+	r->a[2].f = lat;
+	r->a[3].i = exec_mode;
+	r->a[4].f = cpu;
+	r->a[5].f = dsp;
+	log_end(r);
 }
 
-void log_summary(int frames, double total_latency, double min_latency, double max_latency,
-                 double total_amp, double min_amp, double max_amp,
-                 double total_cpu, double min_cpu, double max_cpu,
-                 double total_dsp, double min_dsp, double max_dsp)
+static void log_min_max_avg(enum log_event event, double min, double max, double avg)
 {
-	char buf[256];
-	snprintf(buf, sizeof(buf), "[Live Summary] Frames: %d", frames);
-	enqueue_log(buf);
-	snprintf(buf, sizeof(buf), "[Live Summary] Latency (ms): Min: %.2f, Max: %.2f, Avg: %.2f",
-			min_latency, max_latency, total_latency / frames);
-	enqueue_log(buf);
-	snprintf(buf, sizeof(buf), "[Live Summary] Amp: Min: %.2f, Max: %.2f, Avg: %.2f",
-			min_amp, max_amp, total_amp / frames);
-	enqueue_log(buf);
-	snprintf(buf, sizeof(buf), "[Live Summary] CPU Load (%%): Min: %.1f, Max: %.1f, Avg: %.1f",
-			min_cpu, max_cpu, total_cpu / frames);
-	enqueue_log(buf);
-	snprintf(buf, sizeof(buf), "[Live Summary] DSP Load (%%): Min: %.1f, Max: %.1f, Avg: %.1f",
-			min_dsp, max_dsp, total_dsp / frames);
-	enqueue_log(buf);
+	struct log_record *r = log_begin(event);
+
+	if (!r)
+		return;
+	r->a[0].f = min;
+	r->a[1].f = max;
+	r->a[2].f = avg;
+	log_end(r);
+}
+
+static void log_percentiles(enum log_event event, const char *name, const struct hist *h)
+{
+	struct log_record *r;
+
+	if (!h->count || !(r = log_begin(event)))
+		return;
+	r->a[0].s = name;
+	r->a[1].f = hist_percentile(h, 50.0);
+	r->a[2].f = hist_percentile(h, 90.0);
+	r->a[3].f = hist_percentile(h, 99.0);
+	r->a[4].f = hist_percentile(h, 99.9);
+	r->a[5].f = h->max;
+	log_end(r);
+}
+
+/*
+ * Close the current interval: fold it into the totals, log the running
+ * min/max/avg and the interval and total percentiles, then start a new one.
+ */
+void log_summary(struct metrics *m)
+{
+	static const enum log_event min_max_avg[METRIC_COUNT] = {
+		LOG_EV_SUMMARY_LATENCY, LOG_EV_SUMMARY_AMP, LOG_EV_SUMMARY_CPU, LOG_EV_SUMMARY_DSP,
+	};
+	struct log_record *r;
+
+	for (int i = 0; i < METRIC_COUNT; i++)
+		hist_merge(&m->total[i], &m->interval[i]);
+	if (!m->total[METRIC_LATENCY].count)
+		return;
+
+	if ((r = log_begin(LOG_EV_SUMMARY_FRAMES)) != NULL) {
+		r->a[0].i = m->total[METRIC_LATENCY].count;
+		log_end(r);
+	}
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		struct hist *t = &m->total[i];
+
+		log_min_max_avg(min_max_avg[i], t->min, t->max, t->sum / t->count);
+	}
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		log_percentiles(LOG_EV_PCT_INTERVAL, metric_desc[i].name, &m->interval[i]);
+		log_percentiles(LOG_EV_PCT_TOTAL, metric_desc[i].name, &m->total[i]);
+		hist_reset(&m->interval[i]);
+	}
 }
 
 
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sndfile.h>
+#include "offline.h"
+
+static SNDFILE *out;
+
+// ====================== Output File =========================
+
+int offline_open(const char *path, int channels, int rate)
+{
+	SF_INFO info = {
+		.samplerate = rate,
+		.channels = channels,
+		.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16,
+	};
+
+	out = sf_open(path, SFM_WRITE, &info);
+	if (!out) {
+		fprintf(stderr, "\n*****ERROR***** Failed to create %s: %s\n\n", path, sf_strerror(NULL));
+		return -1;
+	}
+	printf("[Offline] Writing %s\n", path);
+	return 0;
+}
+
+int offline_write(const int16_t *data, int frames)
+{
+	return sf_writef_short(out, data, frames) == frames ? frames : -1;
+}
+
+void offline_close(void)
+{
+	if (out)
+		sf_close(out);
+	out = NULL;
+}
+
+// ====================== Throughput Report =========================
+
+static double tv_ms(struct timeval a, struct timeval b)
+{
+	return (b.tv_sec - a.tv_sec) * 1000.0 + (b.tv_usec - a.tv_usec) / 1000.0;
+}
+
+void offline_begin(struct offline_stats *st)
+{
+	clock_gettime(CLOCK_MONOTONIC, &st->t_start);
+	getrusage(RUSAGE_SELF, &st->ru_start);
+}
+
+/*
+ * Called once every stage has exited. Stage busy time is what each stage
+ * spent between taking a frame and asking for the next; the complete stage
+ * includes waiting for DSP replies.
+ */
+void offline_report(struct offline_stats *st, slot_queue_t **queues, int num_queues, int rate)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	struct timespec t_end;
+	struct rusage ru;
+	double wall_ms, audio_ms, cpu_ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	getrusage(RUSAGE_SELF, &ru);
+	wall_ms = (t_end.tv_sec - st->t_start.tv_sec) * 1000.0 +
+		  (t_end.tv_nsec - st->t_start.tv_nsec) / 1e6;
+	audio_ms = st->frames * 1000.0 / rate;
+	cpu_ms = tv_ms(st->ru_start.ru_utime, ru.ru_utime) + tv_ms(st->ru_start.ru_stime, ru.ru_stime);
+	if (wall_ms <= 0.0)
+		wall_ms = 1e-3;
+
+	printf("[Offline] %lu frames (%.2f s of audio) in %.3f s: %.2fx real time, %.0f frames/s\n",
+	       st->frames, audio_ms / 1000.0, wall_ms / 1000.0, audio_ms / wall_ms,
+	       st->frames * 1000.0 / wall_ms);
+	for (int i = 0; i < num_queues; i++) {
+		slot_queue_t *q = queues[i];
+
+		printf("[Offline] %-8s busy %9.2f ms (%5.1f%% of wall), CPU %9.2f ms, %lu blocks\n",
+		       q->name, q->busy_ns / 1e6, q->busy_ns / 1e4 / wall_ms, q->cpu_ns / 1e6, q->pops);
+	}
+	printf("[Offline] CPU: %.2f ms, %.2f cores busy (%.1f%% of %ld), %.3f ms per second of audio\n",
+	       cpu_ms, cpu_ms / wall_ms, cpu_ms * 100.0 / wall_ms / cores, cores,
+	       audio_ms > 0.0 ? cpu_ms * 1000.0 / audio_ms : 0.0);
+	if (st->dsp_frames)
+		printf("[Offline] DSP: %.3f ms per block submit-to-reply, %.1f%% average reported load\n",
+		       st->dsp_ms_sum / st->dsp_frames, st->dsp_load_sum / st->dsp_frames);
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "pipeline.h"
+#include "host_interface.h"
+
+volatile sig_atomic_t exit_requested;
+
+// ====================== Pipeline Stage Queues =========================
+
+void slot_queue_init(slot_queue_t *q, const char *name)
+{
+	memset(q, 0, sizeof(*q));
+	q->name = name;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+}
+
+void slot_queue_destroy(slot_queue_t *q)
+{
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->cond);
+}
+
+void slot_queue_push(slot_queue_t *q, int idx)
+{
+	pthread_mutex_lock(&q->lock);
+	q->slots[q->tail] = idx;
+	q->tail = (q->tail + 1) % PIPELINE_MAX_DEPTH;
+	q->count++;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/* Blocks until a slot is queued; returns -1 once closed and drained */
+int slot_queue_pop(slot_queue_t *q)
+{
+	struct timespec now;
+	int idx = -1;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (q->t_popped.tv_sec)
+		q->busy_ns += (now.tv_sec - q->t_popped.tv_sec) * 1000000000LL +
+			      now.tv_nsec - q->t_popped.tv_nsec;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->count == 0 && !q->closed)
+		q->stalls++;
+	while (q->count == 0 && !q->closed)
+		pthread_cond_wait(&q->cond, &q->lock);
+
+	if (q->count > 0) {
+		q->depth_sum += q->count;
+		if (q->count > q->max_depth)
+			q->max_depth = q->count;
+		q->pops++;
+
+		idx = q->slots[q->head];
+		q->head = (q->head + 1) % PIPELINE_MAX_DEPTH;
+		q->count--;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	if (idx >= 0) {
+		clock_gettime(CLOCK_MONOTONIC, &q->t_popped);
+	} else {
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+		q->cpu_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+	}
+	return idx;
+}
+
+void slot_queue_close(slot_queue_t *q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->closed = true;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+void log_pipeline_stats(slot_queue_t **queues, int num_queues)
+{
+	for (int i = 0; i < num_queues; i++) {
+		slot_queue_t *q = queues[i];
+		struct log_record *r = log_begin(LOG_EV_PIPELINE);
+
+		if (!r)
+			continue;
+		pthread_mutex_lock(&q->lock);
+		r->a[0].s = q->name;
+		r->a[1].f = q->pops ? (double)q->depth_sum / q->pops : 0.0;
+		r->a[2].i = q->max_depth;
+		r->a[3].i = q->stalls;
+		r->a[4].i = q->pops;
+		pthread_mutex_unlock(&q->lock);
+		log_end(r);
+	}
+}
+
+// ====================== DSP Job Completion =========================
+
+/*
+ * Wait for a DSP job. Once Ctrl+C is seen the DSP gets PIPELINE_EXIT_WAIT_MS
+ * more to answer, then the job is abandoned with -ECANCELED so that a wedged
+ * DSP cannot keep main() from tearing down and restoring the firmware.
+ */
+int pipeline_wait_job(struct rpmsg_sched *s, uint32_t job, ipc_msg_buf_t *reply)
+{
+	int waited = 0;
+	int ret;
+
+	while ((ret = rpmsg_sched_wait(s, job, reply, PIPELINE_WAIT_TICK_MS)) == -ETIMEDOUT) {
+		if (!exit_requested)
+			continue;
+		waited += PIPELINE_WAIT_TICK_MS;
+		if (waited >= PIPELINE_EXIT_WAIT_MS)
+			return -ECANCELED;
+	}
+	return ret;
+}
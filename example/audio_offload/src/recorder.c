@@ -0,0 +1,304 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "recorder.h"
+
+#define REC_MIN_BUFS		2
+#define REC_MAX_FILE		(0xffffffffULL - REC_BUF_SIZE)	/* WAV sizes are 32 bit */
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+	put_le16(p, v);
+	put_le16(p + 2, v >> 16);
+}
+
+/* Sizes of 0xffffffff mark a stream still being written, so a crash leaves a playable file */
+static void wav_header(uint8_t *h, int channels, int rate, uint32_t data_bytes)
+{
+	memcpy(h, "RIFF", 4);
+	put_le32(h + 4, data_bytes == 0xffffffff ? data_bytes : data_bytes + REC_WAV_HEADER - 8);
+	memcpy(h + 8, "WAVEfmt ", 8);
+	put_le32(h + 16, 16);
+	put_le16(h + 20, 1);				/* PCM */
+	put_le16(h + 22, channels);
+	put_le32(h + 24, rate);
+	put_le32(h + 28, rate * channels * 2);
+	put_le16(h + 32, channels * 2);
+	put_le16(h + 34, 16);
+	memcpy(h + 36, "data", 4);
+	put_le32(h + 40, data_bytes);
+}
+
+// ====================== Writer Thread =========================
+
+static void rec_file_open(struct recorder *r)
+{
+	snprintf(r->path, sizeof(r->path), "%s_%03d.%s", r->prefix, r->file_index++,
+		 r->wav ? "wav" : "raw");
+	r->direct = true;
+	r->fd = open(r->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+	if (r->fd < 0 && errno == EINVAL) {
+		/* tmpfs and some others refuse O_DIRECT */
+		r->direct = false;
+		r->fd = open(r->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	}
+	if (r->fd < 0)
+		printf("Recorder: cannot create %s: %s\n", r->path, strerror(errno));
+	r->written = 0;
+}
+
+static void rec_file_write(struct recorder *r, struct rec_buf *b)
+{
+	/* Only a file's last buffer is partial; O_DIRECT writes it padded, then truncates */
+	size_t len = r->direct ? (b->len + REC_ALIGN - 1) & ~(size_t)(REC_ALIGN - 1) : b->len;
+	size_t off = 0;
+
+	while (off < len) {
+		ssize_t n = write(r->fd, b->data + off, len - off);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			printf("Recorder: write to %s failed: %s\n", r->path, strerror(errno));
+			close(r->fd);
+			r->fd = -1;
+			return;
+		}
+		off += n;
+	}
+	r->written += b->len;
+}
+
+static void rec_file_close(struct recorder *r)
+{
+	if (r->direct)
+		fcntl(r->fd, F_SETFL, fcntl(r->fd, F_GETFL) & ~O_DIRECT);
+	if (ftruncate(r->fd, r->written) < 0)
+		printf("Recorder: truncating %s failed: %s\n", r->path, strerror(errno));
+	if (r->wav && r->written >= REC_WAV_HEADER) {
+		uint8_t h[REC_WAV_HEADER];
+
+		wav_header(h, r->channels, r->rate, r->written - REC_WAV_HEADER);
+		if (pwrite(r->fd, h, sizeof(h), 0) != sizeof(h))
+			printf("Recorder: header of %s not updated: %s\n", r->path, strerror(errno));
+	}
+	close(r->fd);
+	r->fd = -1;
+	printf("Recorder: closed %s, %llu bytes%s, %lu frames dropped so far\n", r->path,
+	       (unsigned long long)r->written, r->direct ? " (O_DIRECT)" : "",
+	       __atomic_load_n(&r->drops, __ATOMIC_RELAXED));
+}
+
+static void *rec_writer(void *arg)
+{
+	struct recorder *r = arg;
+
+	while (1) {
+		struct rec_buf *b;
+		int idx;
+
+		pthread_mutex_lock(&r->lock);
+		while (r->full_count == 0 && !r->stop)
+			pthread_cond_wait(&r->cond, &r->lock);
+		if (r->full_count == 0) {
+			pthread_mutex_unlock(&r->lock);
+			break;
+		}
+		idx = r->full[r->full_head];
+		r->full_head = (r->full_head + 1) % REC_MAX_BUFS;
+		r->full_count--;
+		pthread_mutex_unlock(&r->lock);
+
+		b = &r->bufs[idx];
+		if (b->first)
+			rec_file_open(r);
+		if (r->fd >= 0)
+			rec_file_write(r, b);
+		if (b->last && r->fd >= 0)
+			rec_file_close(r);
+		b->len = 0;
+		b->first = b->last = false;
+
+		pthread_mutex_lock(&r->lock);
+		r->free_list[r->nfree++] = idx;
+		pthread_mutex_unlock(&r->lock);
+	}
+	return NULL;
+}
+
+// ====================== Producer =========================
+
+static void rec_submit(struct recorder *r, struct rec_buf *b)
+{
+	pthread_mutex_lock(&r->lock);
+	r->full[(r->full_head + r->full_count) % REC_MAX_BUFS] = b - r->bufs;
+	r->full_count++;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/* Takes n free buffers or none */
+static bool rec_take(struct recorder *r, struct rec_buf **out, int n)
+{
+	bool ok;
+
+	pthread_mutex_lock(&r->lock);
+	ok = r->nfree >= n;
+	for (int i = 0; ok && i < n; i++)
+		out[i] = &r->bufs[r->free_list[--r->nfree]];
+	pthread_mutex_unlock(&r->lock);
+	return ok;
+}
+
+int recorder_open(struct recorder *r, const char *prefix, bool wav, uint32_t channel_mask,
+                  int src_channels, int rate, uint64_t file_limit, size_t mem_budget)
+{
+	memset(r, 0, sizeof(*r));
+	snprintf(r->prefix, sizeof(r->prefix), "%s", prefix);
+	r->wav = wav;
+	r->src_channels = src_channels;
+	r->channel_mask = channel_mask & ((1u << src_channels) - 1);
+	r->channels = __builtin_popcount(r->channel_mask);
+	r->rate = rate;
+	r->fd = -1;
+	if (r->channels == 0)
+		return -EINVAL;
+
+	r->file_limit = file_limit;
+	if (r->file_limit > REC_MAX_FILE)
+		r->file_limit = REC_MAX_FILE;
+	if (r->file_limit < REC_BUF_SIZE)
+		r->file_limit = REC_BUF_SIZE;
+
+	r->nbufs = mem_budget / REC_BUF_SIZE;
+	if (r->nbufs < REC_MIN_BUFS)
+		r->nbufs = REC_MIN_BUFS;
+	if (r->nbufs > REC_MAX_BUFS)
+		r->nbufs = REC_MAX_BUFS;
+	for (int i = 0; i < r->nbufs; i++) {
+		if (posix_memalign((void **)&r->bufs[i].data, REC_ALIGN, REC_BUF_SIZE)) {
+			r->nbufs = i;
+			recorder_close(r);
+			return -ENOMEM;
+		}
+		/* Fault the pages in now rather than on the first frames */
+		memset(r->bufs[i].data, 0, REC_BUF_SIZE);
+		r->free_list[r->nfree++] = i;
+	}
+
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	if (pthread_create(&r->thread, NULL, rec_writer, r)) {
+		int nbufs = r->nbufs;
+
+		r->nbufs = 0;
+		for (int i = 0; i < nbufs; i++)
+			free(r->bufs[i].data);
+		return -EAGAIN;
+	}
+	return 0;
+}
+
+/* Count frames lost before they reached recorder_write(); same thread as it */
+void recorder_count_drops(struct recorder *r, unsigned long frames)
+{
+	__atomic_store_n(&r->drops, r->drops + frames, __ATOMIC_RELAXED);
+}
+
+/*
+ * Called from one thread. Frames go whole into the current file or are
+ * dropped whole, so files always hold complete sample frames.
+ */
+void recorder_write(struct recorder *r, const int16_t *frames, int num_frames)
+{
+	size_t bytes = (size_t)num_frames * r->channels * sizeof(int16_t);
+	int16_t packed[num_frames * r->channels];
+	const uint8_t *src = (const uint8_t *)packed;
+	struct rec_buf *spare[2];
+	size_t room, hdr;
+	int need, used = 0;
+
+	if (!r->nbufs || bytes == 0 || bytes > REC_BUF_SIZE - REC_WAV_HEADER)
+		return;
+
+	/* Rotate before a frame would cross the size limit */
+	if (r->file_open && r->file_bytes + bytes > r->file_limit) {
+		r->cur->last = true;
+		rec_submit(r, r->cur);
+		r->cur = NULL;
+		r->file_open = false;
+	}
+
+	hdr = r->file_open || !r->wav ? 0 : REC_WAV_HEADER;
+	room = r->cur ? REC_BUF_SIZE - r->cur->len : 0;
+	need = hdr + bytes > room ? 1 : 0;
+	if (need && !rec_take(r, spare, need)) {
+		__atomic_store_n(&r->drops, r->drops + 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	for (int i = 0, k = 0; i < num_frames; i++) {
+		for (int ch = 0; ch < r->src_channels; ch++)
+			if (r->channel_mask & (1u << ch))
+				packed[k++] = frames[i * r->src_channels + ch];
+	}
+
+	if (!r->file_open) {
+		r->cur = spare[used++];
+		r->cur->first = true;
+		if (r->wav)
+			wav_header(r->cur->data, r->channels, r->rate, 0xffffffff);
+		r->cur->len = hdr;
+		r->file_bytes = hdr;
+		r->file_open = true;
+	}
+	while (bytes > 0) {
+		size_t n;
+
+		if (r->cur->len == REC_BUF_SIZE) {
+			rec_submit(r, r->cur);
+			r->cur = spare[used++];
+		}
+		n = REC_BUF_SIZE - r->cur->len;
+		if (n > bytes)
+			n = bytes;
+		memcpy(r->cur->data + r->cur->len, src, n);
+		r->cur->len += n;
+		r->file_bytes += n;
+		src += n;
+		bytes -= n;
+	}
+}
+
+/* Flushes the current file and stops the writer; the producer must be idle */
+void recorder_close(struct recorder *r)
+{
+	if (r->thread) {
+		if (r->cur) {
+			r->cur->last = true;
+			rec_submit(r, r->cur);
+			r->cur = NULL;
+		}
+		pthread_mutex_lock(&r->lock);
+		r->stop = true;
+		pthread_cond_signal(&r->cond);
+		pthread_mutex_unlock(&r->lock);
+		pthread_join(r->thread, NULL);
+		r->thread = 0;
+		pthread_mutex_destroy(&r->lock);
+		pthread_cond_destroy(&r->cond);
+	}
+	for (int i = 0; i < r->nbufs; i++)
+		free(r->bufs[i].data);
+	r->nbufs = 0;
+}
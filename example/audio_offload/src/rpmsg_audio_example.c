@@ -1,289 +1,757 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <unistd.h>
 #include <alsa/asoundlib.h>
-#include <sndfile.h>
-#include <fftw3.h>
 #include "config.h"
 #include "rpmsg_audio_example.h"
 #include "rpmsg.h"
+#include "rpmsg_async.h"
+#include "rpmsg_sched.h"
 #include "dmabuf.h"
+#include "transport.h"
 #include "fw_loader.h"
 #include "metrics.h"
+#include "cpu_sampler.h"
 #include "host_interface.h"
+#include "pipeline.h"
+#include "fir_conv.h"
+#include "audio_kernels.h"
+#include "worker_pool.h"
+#include "hybrid.h"
+#include "rt_profile.h"
+#include "alsa_pcm.h"
+#include "audio_source.h"
+#include "offline.h"
+#include "streams.h"
 #include <signal.h>
+#include <errno.h>
 
-#define DATA_BUFFER_SIZE  (FRAME_SIZE * NUM_FRAMES)
-
-int16_t inputbuf[DATA_BUFFER_SIZE];
-int16_t outputbuf[DATA_BUFFER_SIZE];
 int current_channel = 0;
-struct dma_buf_params  data_dma_buf_params;
+struct dmabuf_pool  data_dma_buf_pool;
 struct dma_buf_params  options_dma_buf_params;
-snd_pcm_t *pcm;
-SNDFILE *sf;
+struct alsa_pcm playback;
+const struct audio_source *source;
+struct offline_stats offline;
+
+/* Frame ring: free -> read -> process -> play -> free */
+audio_slot_t slots[PIPELINE_MAX_DEPTH];
+int num_slots;
+slot_queue_t free_queue, process_queue, complete_queue, play_queue;
+pthread_t read_thread, complete_thread, play_thread;
+struct rpmsg_async dsp_async;
+struct rpmsg_sched dsp_sched;
+int main_stream;
+struct fir_conv fir;
+struct worker_pool arm_pool;
+struct hybrid_balancer balancer;
+struct cpu_sampler cpu_sampler;
+int16_t *merge_planar;		/* complete stage scratch of merge_hybrid() */
+static const char *const worker_names[WORKER_POOL_MAX] = {
+	"worker0", "worker1", "worker2", "worker3", "worker4", "worker5", "worker6", "worker7",
+};
+/* Serializes params buffer access between the cmd thread and the complete stage */
+pthread_mutex_t params_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool rt_profile_enabled()
+{
+	const char *specs[] = { app_config.rt_process, app_config.rt_read, app_config.rt_complete,
+				app_config.rt_dsp, app_config.rt_play, app_config.rt_reactor,
+				app_config.rt_workers };
+
+	for (int i = 0; i < 7; i++)
+		if (specs[i][0])
+			return true;
+	return app_config.rt_mlock;
+}
 
+/* Firmware is only switched when talking to a real C7x */
+static bool is_remote_fw_managed()
+{
+	return current_mode != EXEC_ARM && strcmp(transport_name(), "rpmsg") == 0;
+}
+
+/*
+ * Only async-signal-safe calls here. DSP waits give up shortly after this is
+ * set, so the pipeline always drains and the firmware is always restored.
+ */
 void handle_sigint(int sig) {
-	DBG("\n Caught signal %d (Ctrl+C). Cleaning up...\n", sig);
-	if(current_mode) {
-		switch_firmware(app_config.c7_old_fw_path,
-                                app_config.fw_link_path, app_config.c7_state_path);
-	}
-	cleanup_config();
-	exit(0);
+	exit_requested = 1;
+}
+
+static params_t *slot_params(audio_slot_t *slot)
+{
+	return (params_t *)((uint8_t *)lbuf.params_buf + slot->params_off);
 }
 
 void enable_filter(bool state)
 {
-	if(current_mode == EXEC_DSP) {
-		dmabuf_sync(options_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_START);
-		dspParams->filter_enabled = state;
-		dmabuf_sync(options_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_END);
-	} else
+	if(current_mode != EXEC_ARM) {
+		pthread_mutex_lock(&params_lock);
+		for (int i = 0; i < num_slots; i++) {
+			dmabuf_begin_cpu_access_range(&options_dma_buf_params, DMABUF_DIR_WRITE,
+			                              slots[i].params_off, sizeof(params_t));
+			slot_params(&slots[i])->filter_enabled = state;
+			dmabuf_end_cpu_access_range(&options_dma_buf_params, DMABUF_DIR_WRITE,
+			                            slots[i].params_off, sizeof(params_t));
+		}
+		pthread_mutex_unlock(&params_lock);
+		streams_set_filter(state);
+	}
+	if(current_mode != EXEC_DSP)
 		filter_enabled = state;
 }
 
 // ====================== ARM-Side Audio Processing =======================
 
-void process_on_arm()
+/* Default ARM filter when no FIR_COEFF_FILE is given */
+#define FIR_DEFAULT_CUTOFF_HZ	5000
+#define FIR_DEFAULT_TAPS	255
+
+struct arm_job {
+	int first_group;	/* groups before this one are filtered by the DSP */
+};
+
+/*
+ * One worker's share of a frame. Every group's new block goes into the
+ * delay line, even when the DSP filters it, so a channel that moves back
+ * to ARM in hybrid mode continues from up-to-date state.
+ */
+static void process_arm_groups(int worker, void *arg)
 {
-	const int N = NUM_FRAMES;
-	int16_t *data = (int16_t *)lbuf.data_buf;
+	struct arm_job *job = arg;
 
-	for (int ch = 0; ch < CHANNELS; ++ch) {
-		double input[N], output[N];
-		fftw_complex spectrum[N];
-		fftw_plan fwd, bwd;
+	for (int g = worker; g < fir.groups; g += arm_pool.count) {
+		fir_conv_forward(&fir, g);
+		if (g >= job->first_group)
+			fir_conv_filter(&fir, g);
+	}
+}
 
-		for (int i = 0; i < N; ++i) {
-			input[i] = (double)data[i * CHANNELS + ch];
-		}
+void process_on_arm(int16_t *data)
+{
+	struct arm_job job = { .first_group = 0 };
 
-		fwd = fftw_plan_dft_r2c_1d(N, input, spectrum, FFTW_ESTIMATE);
-		fftw_execute(fwd);
+	if (!filter_enabled) {
+		fir_conv_bypass(&fir, data);
+		return;
+	}
+	fir_conv_load(&fir, data);
+	worker_pool_run(&arm_pool, process_arm_groups, &job);
+	fir_conv_store(&fir, data);
+}
 
-		if(filter_enabled) {
-			for (int i = 0; i < N/2 + 1; i++) {
-				float freq = i * SAMPLE_RATE / NUM_FRAMES;
-				if(freq >= 5000) {
-					spectrum[i][0] = 0.0;
-					spectrum[i][1] = 0.0;
-				}
-			}
-		}
+int load_fir(const char *path)
+{
+	return fir_conv_load_file(&fir, path);
+}
+/*
+ * Queue the slot's descriptor to the DSP, then a copy of the block to every
+ * extra stream; the reply is collected by complete_on_dsp()
+ */
+int process_on_dsp(audio_slot_t *slot)
+{
+	uint32_t mask = current_mode == EXEC_HYBRID ? (1u << slot->dsp_channels) - 1 : ALL_CHANNELS_MASK;
+	int ret = 0;
 
-		bwd = fftw_plan_dft_c2r_1d(N, spectrum, output, FFTW_ESTIMATE);
-		fftw_execute(bwd);
+	pthread_mutex_lock(&params_lock);
+	dmabuf_begin_cpu_access_range(&options_dma_buf_params, DMABUF_DIR_WRITE,
+	                              slot->params_off, sizeof(params_t));
+	slot_params(slot)->channel_mask = mask;
+	slot_params(slot)->mask_done = 0;
+	dmabuf_end_cpu_access_range(&options_dma_buf_params, DMABUF_DIR_WRITE,
+	                            slot->params_off, sizeof(params_t));
+	pthread_mutex_unlock(&params_lock);
 
-		for (int i = 0; i < N; ++i) {
-			int16_t val = (int16_t)(output[i] / N);
-			if (val > 32767) val = 32767;
-			if (val < -32768) val = -32768;
-			data[i * CHANNELS + ch] = (int16_t)val;
-		}
-		fftw_destroy_plan(fwd);
-		fftw_destroy_plan(bwd);
+	/* Clean only the samples the read stage wrote */
+	dmabuf_end_cpu_access_range(slot->dbuf, DMABUF_DIR_WRITE, 0, slot->frames * FRAME_SIZE);
+
+	ret = rpmsg_sched_submit(&dsp_sched, main_stream, &slot->ibuf, &slot->t_read, slot, &slot->ticket);
+	if (ret < 0) {
+		printf("rpmsg_sched_submit failed for frame %d, ret = %d\n", slot->seq, ret);
+		slot->ticket = 0;
 	}
+	streams_submit(slot->input, slot->frames * FRAME_SIZE, ALL_CHANNELS_MASK, &slot->t_read,
+		       app_config.offline_mode);
+	return ret;
 }
-void process_on_dsp()
+
+void complete_on_dsp(audio_slot_t *slot)
 {
 	int ret = 0;
-	int i = 0;
-	int packet_len;
-	packet_len = sizeof(ibuf);
 
-	ret = send_msg(rpmsg_fd, (char *)&ibuf, sizeof(ibuf));
-	if (ret < 0) {
-		printf("send_msg failed for iteration %d, ret = %d\n", i, ret);
+	if (!slot->ticket)
 		return;
-	}
-	if (ret != packet_len) {
-		printf("bytes written does not match send request, ret = %d, packet_len = %d\n", i, ret);
+	ret = pipeline_wait_job(&dsp_sched, slot->ticket, &slot->ibuf);
+	if (ret == -ECANCELED) {
+		printf("No DSP reply for frame %d, abandoning it\n", slot->seq);
+		slot->ticket = 0;
 		return;
 	}
-	ret = recv_msg(rpmsg_fd, 256, (char *)&ibuf, &packet_len);
+	if (ret < 0)
+		printf("rpmsg_sched_wait failed for frame %d, ret = %d\n", slot->seq, ret);
 
-	if (ret < 0) {
-		printf("recv_msg failed for iteration %d, ret = %d\n", i, ret);
-		return;
-	}
+	dmabuf_begin_cpu_access_range(slot->dbuf, DMABUF_DIR_READ, 0, slot->frames * FRAME_SIZE);
 }
 
-
 double time_diff_ms(struct timespec a, struct timespec b)
 {
 	return (b.tv_sec-a.tv_sec)*1000.0 + (b.tv_nsec-a.tv_nsec)/1e6;
 }
 
-void *run_audio_processing_thread(void *arg)
+// ====================== Hybrid ARM+DSP Processing =======================
+
+/*
+ * The DSP takes channels [0, dsp_channels) in the data dma-buf while the ARM
+ * cores process the rest from the slot's input copy into private scratch.
+ * Nothing touches the dma-buf until the DSP has finished, so the two never
+ * write the same cache lines.
+ */
+void process_hybrid(audio_slot_t *slot)
 {
-	const char* input_file = (const char *)arg;
-	double total_latency=0, min_latency=1e6, max_latency=0;
-	int frames = 0;
-	double total_amp = 0.0, min_amp = 1e9, max_amp = -1e9;
-	double total_cpu = 0.0, min_cpu = 1e9, max_cpu = -1e9;
-	double total_dsp = 0.0, min_dsp = 1e9, max_dsp = -1e9;
-	sf_count_t frames_read;
-	struct timespec t1, t2;
-
-	SF_INFO sfinfo = {0};
-	SNDFILE *infile = sf_open(input_file, SFM_READ, &sfinfo);
-	if (!infile) {
-		fprintf(stderr, "\n*****ERROR***** Failed to open input WAV: %s\n\n",
-				sf_strerror(NULL));
-		start_requested = EXIT_PLAY;
-		pthread_exit(infile);
+	struct arm_job job;
+	struct timespec t0, t1;
+
+	slot->dsp_channels = hybrid_dsp_channels(&balancer);
+	job.first_group = slot->dsp_channels;
+	process_on_dsp(slot);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (filter_enabled) {
+		fir_conv_load(&fir, slot->input);
+		worker_pool_run(&arm_pool, process_arm_groups, &job);
+		fir_conv_store_planar(&fir, slot->arm_out, slot->dsp_channels, num_channels);
+	} else {
+		fir_conv_bypass(&fir, slot->input);
+		audio_deinterleave_s16(slot->arm_out, slot->input, num_channels, num_frames);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	slot->arm_ms = time_diff_ms(t0, t1);
+}
 
-	if (sfinfo.channels != CHANNELS || sfinfo.samplerate != SAMPLE_RATE) {
-		fprintf(stderr, "\n*****ERROR***** WAV file must be %d-ch %dHz\n\n",
-				CHANNELS, SAMPLE_RATE);
-		sf_close(infile);
-		start_requested = EXIT_PLAY;
-		pthread_exit(infile);
-	}
+/* Overlay the ARM channels on the DSP output once the buffer is back with the CPU */
+void merge_hybrid(audio_slot_t *slot)
+{
+	int first = slot->dsp_channels;
 
-	snd_pcm_t *pcm_handle;
-	int rc = snd_pcm_open(&pcm_handle, "default", SND_PCM_STREAM_PLAYBACK, 0);
-	if (rc < 0) {
-		fprintf(stderr, "\n*****ERROR***** snd_pcm_open error: %s\n\n",
-				snd_strerror(rc));
-		sf_close(infile);
-		start_requested = EXIT_PLAY;
-		pthread_exit(infile);
-	}
-
-	rc = snd_pcm_set_params(pcm_handle,
-                            SND_PCM_FORMAT_S16_LE,
-                            SND_PCM_ACCESS_RW_INTERLEAVED,
-                            CHANNELS,
-                            SAMPLE_RATE,
-                            1,
-                            500000);
-	if (rc < 0) {
-		fprintf(stderr, "\n*****ERROR***** snd_pcm_set_params error: %s\n\n",
-				snd_strerror(rc));
-		snd_pcm_close(pcm_handle);
-		sf_close(infile);
-		start_requested = EXIT_PLAY;
-		pthread_exit(infile);
-	}
+	dmabuf_begin_cpu_access_range(slot->dbuf, DMABUF_DIR_WRITE, 0, num_frames * FRAME_SIZE);
+	audio_deinterleave_s16(merge_planar, slot->data, num_channels, num_frames);
+	memcpy(merge_planar + first * num_frames, slot->arm_out + first * num_frames,
+	       (num_channels - first) * num_frames * sizeof(int16_t));
+	audio_interleave_s16(slot->data, merge_planar, num_channels, num_frames);
+}
 
-	while(1) {
-		memset(inputbuf, 0, sizeof(inputbuf));
-		memset(outputbuf, 0, sizeof(outputbuf));
-		dmabuf_sync(data_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_START);
-		frames_read = sf_readf_short(infile, (short *)lbuf.data_buf, NUM_FRAMES);
-		if(frames_read != NUM_FRAMES)
+// ====================== Pipeline Stages =======================
+
+/* Read stage: fill free slots from the audio source */
+void *read_stage(void *arg)
+{
+	int idx, seq = 0;
+
+	while (!exit_requested && (idx = slot_queue_pop(&free_queue)) >= 0) {
+		audio_slot_t *slot = &slots[idx];
+
+		/*
+		 * The CPU keeps ownership until the slot is handed to the DSP, so in
+		 * ARM mode the data buffers never need cache maintenance at all.
+		 */
+		dmabuf_begin_cpu_access(slot->dbuf, DMABUF_DIR_WRITE);
+		slot->frames = source->read(slot->data, num_frames, &slot->t_capture);
+		if (slot->frames != num_frames) {
+			dmabuf_end_cpu_access(slot->dbuf, DMABUF_DIR_WRITE);
 			break;
+		}
+		memcpy(slot->input, slot->data, num_frames * FRAME_SIZE);
+
+		clock_gettime(CLOCK_MONOTONIC, &slot->t_read);
+		slot->seq = ++seq;
+		slot_queue_push(&process_queue, idx);
+	}
+	slot_queue_close(&process_queue);
+	return NULL;
+}
 
-		memcpy(inputbuf, lbuf.data_buf,  NUM_FRAMES * CHANNELS *sizeof(int16_t));
-		dmabuf_sync(data_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_END);
+/* The last reference to a played slot returns it to the reader */
+static void slot_release(void *ctx)
+{
+	audio_slot_t *slot = ctx;
 
-		clock_gettime(CLOCK_MONOTONIC, &t1);
-		current_mode ? process_on_dsp() : process_on_arm();
-		clock_gettime(CLOCK_MONOTONIC, &t2);
+	if (__atomic_sub_fetch(&slot->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		slot_queue_push(&free_queue, slot - slots);
+}
 
-		double lat = time_diff_ms(t1, t2);
-		long sum = 0;
+/* Lend a slot buffer to a tap; the host I/O thread extracts the channel and releases it */
+static void tap_slot(audio_slot_t *slot, enum tap_dir dir, const int16_t *buf)
+{
+	struct tap_frame frame = {
+		.buf = buf,
+		.frames = slot->frames,
+		.channels = num_channels,
+		.rate = sample_rate,
+		.channel_mask = 1u << current_channel,
+		.seq = slot->seq,
+		.ts_ns = slot->t_read.tv_sec * 1000000000ULL + slot->t_read.tv_nsec,
+		.release = slot_release,
+		.ctx = slot,
+	};
+
+	__atomic_add_fetch(&slot->refs, 1, __ATOMIC_RELAXED);
+	if (tap_publish(dir, &frame) < 0)
+		slot_release(slot);
+}
+
+/* Play stage: hand processed slots to ALSA (or the offline file) and the taps, then recycle them */
+void *play_stage(void *arg)
+{
+	int idx;
 
-		dmabuf_sync(data_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_START);
-		dmabuf_sync(options_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_START);
+	while ((idx = slot_queue_pop(&play_queue)) >= 0) {
+		audio_slot_t *slot = &slots[idx];
 
-		for (int i = 0; i < NUM_FRAMES; i++)
-			sum += abs(lbuf.data_buf[i * CHANNELS + current_channel]);
-		float amp = (float)(sum / (NUM_FRAMES * CHANNELS));
-		float cpu = get_cpu_load();
-		float dsp = (current_mode == EXEC_DSP ?  dspParams->dsp_load : 0.0f);
-		update_metrics(lat, amp, cpu, dsp, &total_latency, &min_latency, &max_latency,
-		               &total_amp, &min_amp, &max_amp, &total_cpu, &min_cpu, &max_cpu,
-			       &total_dsp, &min_dsp, &max_dsp);
+		if (app_config.offline_mode) {
+			if (offline_write(slot->data, slot->frames) < 0)
+				printf("[Offline] frame %d not written\n", slot->seq);
+			offline.frames += slot->frames;
+		} else if (alsa_pcm_write(&playback, slot->data, slot->frames, &slot->t_capture) < 0) {
+			printf("[ALSA] playback: frame %d dropped\n", slot->seq);
+		}
+		slot->refs = 1;
+		tap_slot(slot, TAP_INPUT, slot->input);
+		tap_slot(slot, TAP_OUTPUT, slot->data);
+		slot_release(slot);
+	}
+	/* The taps hold slots for at most a reactor tick; wait before the queues go away */
+	for (int i = 0; i < num_slots; i++)
+		while (__atomic_load_n(&slots[i].refs, __ATOMIC_ACQUIRE) > 0)
+			usleep(1000);
+	/* Unblock the reader if playback stopped early */
+	slot_queue_close(&free_queue);
+	return NULL;
+}
+
+/*
+ * Complete stage: collects DSP replies in submission order, so several
+ * frames can be outstanding on the DSP, then records metrics.
+ */
+void *complete_stage(void *arg)
+{
+	static struct metrics metrics;
+	int frames = 0;
+	slot_queue_t *queues[] = { &free_queue, &process_queue, &complete_queue, &play_queue };
+	struct timespec t2;
+	int idx;
+
+	metrics_init(&metrics);
+	while ((idx = slot_queue_pop(&complete_queue)) >= 0) {
+		audio_slot_t *slot = &slots[idx];
+
+		float dsp_ms = 0.0f;
+
+		if (current_mode != EXEC_ARM) {
+			complete_on_dsp(slot);
+			clock_gettime(CLOCK_MONOTONIC, &t2);
+			dsp_ms = time_diff_ms(slot->t_start, t2);
+			if (current_mode == EXEC_HYBRID) {
+				merge_hybrid(slot);
+				clock_gettime(CLOCK_MONOTONIC, &t2);
+			}
+			slot->latency = time_diff_ms(slot->t_start, t2);
+		}
+
+		float lat = slot->latency;
+		float dsp = 0.0f;
+		bool mask_done = false;
+		long sum = 0;
+
+		for (int i = 0; i < num_frames; i++)
+			sum += abs(slot->data[i * num_channels + current_channel]);
+		float amp = (float)(sum / (num_frames * num_channels));
+		float cpu = cpu_sampler_total(&cpu_sampler);
+		if (current_mode != EXEC_ARM) {
+			pthread_mutex_lock(&params_lock);
+			dmabuf_begin_cpu_access_range(&options_dma_buf_params, DMABUF_DIR_READ,
+			                              slot->params_off, sizeof(params_t));
+			dsp = slot_params(slot)->dsp_load;
+			mask_done = slot_params(slot)->mask_done == slot_params(slot)->channel_mask;
+			dmabuf_end_cpu_access_range(&options_dma_buf_params, DMABUF_DIR_READ,
+			                            slot->params_off, sizeof(params_t));
+			pthread_mutex_unlock(&params_lock);
+		}
+		if (current_mode == EXEC_HYBRID)
+			hybrid_update(&balancer, slot->dsp_channels, slot->arm_ms, dsp_ms, dsp,
+			              mask_done);
+		update_metrics(&metrics, lat, amp, cpu, dsp);
+		if (current_mode != EXEC_ARM) {
+			offline.dsp_ms_sum += dsp_ms;
+			offline.dsp_load_sum += dsp;
+			offline.dsp_frames++;
+		}
 
 		log_frame_metrics(current_mode, ++frames, amp, lat, cpu, dsp);
+		slot_queue_push(&play_queue, idx);
 
-		snd_pcm_writei(pcm_handle, (short *)lbuf.data_buf, frames_read);
-		memcpy(outputbuf, lbuf.data_buf, NUM_FRAMES * CHANNELS *sizeof(int16_t));
-		log_input_audio(inputbuf, NUM_FRAMES, CHANNELS, current_channel);
-		log_output_audio(outputbuf, NUM_FRAMES, CHANNELS, current_channel);
-		dmabuf_sync(options_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_END);
-		dmabuf_sync(data_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_END);
 		if (frames % 10 == 0) {
-			log_summary(frames, total_latency, min_latency, max_latency,
-			            total_amp, min_amp, max_amp,
-			            total_cpu, min_cpu, max_cpu,
-			            total_dsp, min_dsp, max_dsp);
+			if (current_mode != EXEC_ARM) {
+				struct hist *h = &metrics.interval[METRIC_DSP];
+
+				log_stream_stats(&dsp_sched, h->count ? h->sum / h->count : 0.0);
+			}
+			log_summary(&metrics);
+			log_pipeline_stats(queues, 4);
+			if (current_mode != EXEC_DSP)
+				log_worker_stats(&arm_pool);
+			if (current_mode == EXEC_HYBRID)
+				log_hybrid_stats(&balancer);
+			log_cpu_snapshot(&cpu_sampler);
+			log_alsa_stats(&playback);
+			if (source->log_stats)
+				source->log_stats();
 		}
 	}
+	slot_queue_close(&play_queue);
+	log_pipeline_stats(queues, 4);
+	log_alsa_stats(&playback);
+	if (source->log_stats)
+		source->log_stats();
+	log_worker_stats(&arm_pool);
+	return NULL;
+}
+
+/* Process stage: runs on the audio thread, ARM inline or DSP submission per frame */
+void *run_audio_processing_thread(void *arg)
+{
+	slot_queue_t *queues[] = { &free_queue, &process_queue, &complete_queue, &play_queue };
+	struct timespec t2;
+	int idx;
+
+	rt_apply("process", pthread_self(), app_config.rt_process);
+	/* Playback opens first: a capture source links to it and inherits its geometry */
+	if (app_config.offline_mode) {
+		if (offline_open(app_config.offline_output, num_channels, sample_rate) < 0) {
+			start_requested = EXIT_PLAY;
+			pthread_exit(NULL);
+		}
+	} else if (alsa_pcm_open(&playback, app_config.pcm_device, SND_PCM_STREAM_PLAYBACK, num_channels,
+	                         sample_rate, app_config.alsa_period_frames, app_config.alsa_periods,
+	                         app_config.alsa_start_periods, app_config.alsa_mmap) < 0) {
+		start_requested = EXIT_PLAY;
+		pthread_exit(NULL);
+	} else if (num_frames % playback.period) {
+		printf("[ALSA] %d-frame pipeline frames are not a multiple of the %lu-frame period\n",
+		       num_frames, playback.period);
+	}
+	if (source->open(num_channels, sample_rate, app_config.offline_mode ? NULL : &playback) < 0) {
+		offline_close();
+		alsa_pcm_close(&playback);
+		start_requested = EXIT_PLAY;
+		pthread_exit(NULL);
+	}
 
-	snd_pcm_close(pcm_handle);
-	sf_close(infile);
+	slot_queue_init(&free_queue, "read");
+	slot_queue_init(&process_queue, "process");
+	slot_queue_init(&complete_queue, "complete");
+	slot_queue_init(&play_queue, "play");
+	for (int i = 0; i < num_slots; i++)
+		slot_queue_push(&free_queue, i);
+
+	offline_begin(&offline);
+	if (pthread_create(&read_thread, NULL, read_stage, NULL) != 0) {
+		printf("Failed to start the read stage\n");
+		goto close;
+	}
+	if (pthread_create(&complete_thread, NULL, complete_stage, NULL) != 0) {
+		printf("Failed to start the complete stage\n");
+		goto stop_read;
+	}
+	if (pthread_create(&play_thread, NULL, play_stage, NULL) != 0) {
+		printf("Failed to start the play stage\n");
+		goto stop_complete;
+	}
+	cpu_sampler_add_thread(&cpu_sampler, "process", pthread_self());
+	cpu_sampler_add_thread(&cpu_sampler, "read", read_thread);
+	cpu_sampler_add_thread(&cpu_sampler, "complete", complete_thread);
+	cpu_sampler_add_thread(&cpu_sampler, "play", play_thread);
+	rt_apply("read", read_thread, app_config.rt_read);
+	rt_apply("complete", complete_thread, app_config.rt_complete);
+	rt_apply("play", play_thread, app_config.rt_play);
+
+	while ((idx = slot_queue_pop(&process_queue)) >= 0) {
+		audio_slot_t *slot = &slots[idx];
+
+		clock_gettime(CLOCK_MONOTONIC, &slot->t_start);
+		if (current_mode == EXEC_DSP) {
+			process_on_dsp(slot);
+		} else if (current_mode == EXEC_HYBRID) {
+			process_hybrid(slot);
+		} else {
+			dmabuf_begin_cpu_access(slot->dbuf, DMABUF_DIR_RW);
+			process_on_arm(slot->data);
+			clock_gettime(CLOCK_MONOTONIC, &t2);
+			slot->latency = time_diff_ms(slot->t_start, t2);
+		}
+		slot_queue_push(&complete_queue, idx);
+	}
+	slot_queue_close(&complete_queue);
+	streams_drain();
+
+	pthread_join(read_thread, NULL);
+	pthread_join(complete_thread, NULL);
+	pthread_join(play_thread, NULL);
+	if (app_config.offline_mode)
+		offline_report(&offline, queues, 4, sample_rate);
+	for (int i = 0; i < 4; i++)
+		slot_queue_destroy(queues[i]);
+
+	source->close();
+	alsa_pcm_close(&playback);
+	offline_close();
 	printf("TEST STATUS: PASSED\n");
 	start_requested = EXIT_PLAY;
 	pthread_exit(0);
 	return NULL;
+
+	/* A stage failed to start: stop the ones already running, nothing is played */
+stop_complete:
+	slot_queue_close(&complete_queue);
+	pthread_join(complete_thread, NULL);
+stop_read:
+	slot_queue_close(&free_queue);
+	pthread_join(read_thread, NULL);
+close:
+	for (int i = 0; i < 4; i++)
+		slot_queue_destroy(queues[i]);
+	source->close();
+	alsa_pcm_close(&playback);
+	offline_close();
+	start_requested = EXIT_PLAY;
+	pthread_exit(NULL);
+	return NULL;
 }
 
 void init_rpmsg_buffer(int graph_id)
 {
-	lbuf.data_buf = data_dma_buf_params.kern_addr;
 	lbuf.params_buf = options_dma_buf_params.kern_addr ;
-	lbuf.data_size = data_dma_buf_params.size;
 	lbuf.params_size = options_dma_buf_params.size;
+	lbuf.data_size = data_dma_buf_pool.buf_size;
 
-	ibuf.data_buffer = (uint32_t)data_dma_buf_params.phys_addr;
 	ibuf.params_buffer = (uint32_t)options_dma_buf_params.phys_addr;
-	ibuf.data_size = data_dma_buf_params.size;
-	ibuf.params_size = options_dma_buf_params.size;
+	ibuf.params_size = PARAMS_STRIDE;
+	ibuf.data_size = data_dma_buf_pool.buf_size;
 	ibuf.graph_id = graph_id;
 
+	/* Every slot keeps its own data dma-buf for the lifetime of the stream */
+	num_slots = data_dma_buf_pool.count;
+	for (int i = 0; i < num_slots; i++) {
+		slots[i].dbuf = dmabuf_pool_acquire(&data_dma_buf_pool);
+		slots[i].data = (int16_t *)slots[i].dbuf->kern_addr;
+		slots[i].input = calloc(num_frames * num_channels, sizeof(int16_t));
+		slots[i].arm_out = calloc(num_frames * num_channels, sizeof(int16_t));
+		slots[i].params_off = i * PARAMS_STRIDE;
+		slots[i].ibuf = ibuf;
+		slots[i].ibuf.data_buffer = (uint32_t)slots[i].dbuf->phys_addr;
+		slots[i].ibuf.params_buffer += slots[i].params_off;
+	}
+	merge_planar = calloc(num_frames * num_channels, sizeof(int16_t));
+	lbuf.data_buf = (uint32_t *)slots[0].data;
+	ibuf.data_buffer = slots[0].ibuf.data_buffer;
+
 	dspParams = (params_t*)lbuf.params_buf;
 }
 
+void cleanup_rpmsg_buffer()
+{
+	for (int i = 0; i < num_slots; i++) {
+		free(slots[i].input);
+		free(slots[i].arm_out);
+		dmabuf_pool_release(&data_dma_buf_pool, slots[i].dbuf);
+	}
+	free(merge_planar);
+	merge_planar = NULL;
+	num_slots = 0;
+}
+
 // ============================== Main ====================================
 
-int main(int argc, char **argv)
+/*
+ * CHANNELS and SAMPLE_RATE of 0 take the source's own format (a file's
+ * header); a source without one defaults to 8 ch at 48 kHz. BLOCK_FRAMES of
+ * 0 fits the block to DATA_SIZE.
+ */
+static int resolve_geometry(void)
 {
-	const char* input_file = NULL;
+	int channels = 0;
+	unsigned int rate = 0;
+
+	if (source->probe && source->probe(&channels, &rate) < 0)
+		return -1;
+	if (app_config.channels)
+		channels = app_config.channels;
+	if (app_config.sample_rate)
+		rate = app_config.sample_rate;
+	num_channels = channels ? channels : 8;
+	sample_rate = rate ? rate : 48000;
+	if (num_channels < 1 || num_channels > MAX_CHANNELS) {
+		printf("%d channels not supported, 1-%d\n", num_channels, MAX_CHANNELS);
+		return -1;
+	}
 
+	num_frames = app_config.block_frames ? app_config.block_frames :
+		     app_config.data_buffer_size / FRAME_SIZE;
+	if (num_frames < MIN_BLOCK_FRAMES || num_frames > MAX_BLOCK_FRAMES) {
+		printf("Block of %d frames out of range (%d-%d), using 256\n", num_frames,
+		       MIN_BLOCK_FRAMES, MAX_BLOCK_FRAMES);
+		num_frames = 256;
+	}
+	if (app_config.data_buffer_size < num_frames * FRAME_SIZE) {
+		printf("DATA_SIZE %d is less than one block, raised to %d\n",
+		       app_config.data_buffer_size, num_frames * FRAME_SIZE);
+		app_config.data_buffer_size = num_frames * FRAME_SIZE;
+	}
+	printf("Stream: %d ch, %u Hz, %d-frame blocks (%.2f ms)\n", num_channels, sample_rate,
+	       num_frames, num_frames * 1000.0 / sample_rate);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
 	load_config(CFG_FILE_PATH);
-	input_file = app_config.sample_audio_file;
+	if (app_config.is_dsp_execution < EXEC_ARM || app_config.is_dsp_execution > EXEC_HYBRID) {
+		printf("DSP_EXEC_MODE %d out of range, using DSP\n", app_config.is_dsp_execution);
+		app_config.is_dsp_execution = EXEC_DSP;
+	}
 	current_mode = (ExecMode)app_config.is_dsp_execution;
 
+	if (transport_select(app_config.transport) < 0)
+		return -1;
+	if (app_config.offline_mode && strcmp(app_config.audio_source, "file") != 0) {
+		printf("OFFLINE_MODE reads SAMPLE_AUDIO_FILE, ignoring AUDIO_SOURCE=%s\n",
+		       app_config.audio_source);
+		free(app_config.audio_source);
+		app_config.audio_source = strdup("file");
+	}
+	source = audio_source_select(app_config.audio_source);
+	if (!source)
+		return -1;
+	if (streams_parse(app_config.streams) < 0)
+		return -1;
+	if (current_mode == EXEC_ARM && streams_count()) {
+		printf("STREAMS run on the DSP, ignored in ARM mode\n");
+		streams_parse("");
+	}
+	if (strcmp(transport_name(), "loopback") == 0) {
+		struct loopback_model model = {
+			.fixed_us = app_config.loopback_fixed_us,
+			.ns_per_kb = app_config.loopback_ns_per_kb,
+			.jitter_us = app_config.loopback_jitter_us,
+			.job_us = app_config.loopback_job_us,
+		};
+		loopback_set_model(&model);
+	}
+
 	// Register signal handler for SIGINT
 	signal(SIGINT, handle_sigint);
 
-	if(current_mode) {
+	if(is_remote_fw_managed()) {
 		// Load Test firmware
 		switch_firmware(app_config.c7_new_fw_path,
 				app_config.fw_link_path, app_config.c7_state_path);
 		sleep(1);
 	}
-	app_config.data_buffer_size = FRAME_SIZE * NUM_FRAMES;
+	if (resolve_geometry() < 0)
+		return -1;
+	if (current_mode == EXEC_HYBRID && num_channels < 2) {
+		printf("Hybrid mode needs 2 or more channels to split, using DSP\n");
+		current_mode = EXEC_DSP;
+	}
+	if (app_config.pipeline_depth < 1 || app_config.pipeline_depth > PIPELINE_MAX_DEPTH) {
+		printf("PIPELINE_DEPTH %d out of range, using 3\n", app_config.pipeline_depth);
+		app_config.pipeline_depth = 3;
+	}
+	/* Nothing paces an offline run, so keep as many frames in flight as the slots allow */
+	if (app_config.offline_mode)
+		app_config.pipeline_depth = PIPELINE_MAX_DEPTH;
+	/* Every stream keeps up to pipeline_depth jobs in the scheduler */
+	if ((1 + streams_count()) * app_config.pipeline_depth > RPMSG_SCHED_MAX_JOBS) {
+		app_config.pipeline_depth = RPMSG_SCHED_MAX_JOBS / (1 + streams_count());
+		printf("PIPELINE_DEPTH lowered to %d for %d streams\n", app_config.pipeline_depth,
+		       1 + streams_count());
+	}
+	/* Lock memory before anything is allocated, so all of it is faulted in up front */
+	if (app_config.rt_mlock)
+		rt_lock_memory();
+	if (rt_profile_enabled())
+		rt_check();
+	audio_kernels_init();
+	audio_kernels_bind(num_channels, num_frames);
+	if (cpu_sampler_start(&cpu_sampler, app_config.cpu_sample_ms) < 0)
+		return -1;
+	if (worker_pool_init(&arm_pool, app_config.arm_workers) < 0)
+		return -1;
+	for (int i = 1; i < arm_pool.count; i++) {
+		struct rt_sched sched;
+
+		cpu_sampler_add_thread(&cpu_sampler, worker_names[i], arm_pool.threads[i]);
+		/* Workers keep their core-per-worker placement, the profile only sets the policy */
+		if (rt_parse(app_config.rt_workers, &sched) == 0) {
+			sched.cpu = -1;
+			rt_apply_sched(worker_names[i], arm_pool.threads[i], &sched);
+		}
+	}
+	/* Hybrid mode moves single channels between ARM and DSP, so it plans per channel */
+	hybrid_init(&balancer, num_channels, num_frames * 1000.0f / sample_rate);
+	if (fir_conv_init(&fir, num_frames, num_channels,
+			current_mode == EXEC_HYBRID ? num_channels : arm_pool.count,
+			fir_conv_rigor(app_config.fftw_plan_rigor), app_config.fftw_wisdom_file) < 0)
+		return -1;
+	if (!app_config.fir_coeff_file[0] || fir_conv_load_file(&fir, app_config.fir_coeff_file) < 0)
+		fir_conv_set_lowpass(&fir, FIR_DEFAULT_CUTOFF_HZ, sample_rate, FIR_DEFAULT_TAPS);
 	rpmsg_fd = init_rpmsg(app_config.c7_proc_id, app_config.remote_endpoint);
-	dmabuf_heap_init(app_config.dma_heap_reserved,
-			app_config.data_buffer_size, app_config.rproc_dev_name,
-			&data_dma_buf_params);
+	if (rpmsg_fd >= 0)
+		rpmsg_async_init(&dsp_async, rpmsg_fd);
+	if (dmabuf_pool_init(app_config.dma_heap_reserved,
+			app_config.data_buffer_size, app_config.pipeline_depth,
+			app_config.rproc_dev_name, &data_dma_buf_pool) < 0) {
+		fprintf(stderr, "\n*****ERROR***** data dma-buf pool allocation failed\n\n");
+		return -1;
+	}
+	/* Every DSP job, of the main stream or an extra one, is ordered by the scheduler */
+	if (rpmsg_fd >= 0) {
+		uint32_t block_us = (uint64_t)num_frames * 1000000 / sample_rate;
+
+		if (rpmsg_sched_init(&dsp_sched, &dsp_async, app_config.dsp_max_inflight) < 0)
+			return -1;
+		cpu_sampler_add_thread(&cpu_sampler, "dsp", rpmsg_sched_thread(&dsp_sched));
+		rt_apply("dsp", rpmsg_sched_thread(&dsp_sched),
+			 app_config.rt_dsp[0] ? app_config.rt_dsp : app_config.rt_complete);
+		main_stream = rpmsg_sched_add_stream(&dsp_sched, "main", app_config.graph_id,
+						     app_config.stream_priority,
+						     app_config.stream_deadline_ms ?
+						     app_config.stream_deadline_ms * 1000u : block_us);
+		if (streams_init(&dsp_sched, app_config.pipeline_depth, app_config.data_buffer_size,
+				 block_us) < 0)
+			return -1;
+	}
+	if (app_config.param_buffer_size < app_config.pipeline_depth * PARAMS_STRIDE)
+		app_config.param_buffer_size = app_config.pipeline_depth * PARAMS_STRIDE;
 	dmabuf_heap_init(app_config.dma_heap_reserved,
 			app_config.param_buffer_size, app_config.rproc_dev_name,
 			&options_dma_buf_params);
-	init_rpmsg_buffer(0);
+	init_rpmsg_buffer(app_config.graph_id);
 	init_host_interface();
 
-	if(current_mode) {
-		dmabuf_sync(options_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_END);
-		dspParams->filter_enabled = app_config.fft_filter_enable;
-		dmabuf_sync(options_dma_buf_params.dma_buf_fd, DMA_BUF_SYNC_END);
-	}
-	else
-		filter_enabled = app_config.fft_filter_enable;
+	enable_filter(app_config.fft_filter_enable);
 
 	DBG("dmabuf for data buffer::  Kernel: %p Phy: 0x%x Size = %d\n",
 			lbuf.data_buf, ibuf.data_buffer, lbuf.data_size);
 	DBG("dmabuf for params buffer::  Kernel: %p Phy: 0x%x Size = %d\n",
 			lbuf.params_buf, ibuf.params_buffer, lbuf.params_size);
 
-	DBG("Execution on : %s\n", current_mode ? "DSP" : "ARM");
-	DBG("Audio File: %s\n", input_file);
+	DBG("Pipeline depth : %d data buffers\n", num_slots);
+	DBG("Execution on : %s\n", current_mode == EXEC_HYBRID ? "ARM+DSP" : current_mode ? "DSP" : "ARM");
+	DBG("Audio source: %s\n", strcmp(source->name, "file") == 0 ?
+			app_config.sample_audio_file : source->name);
+
+	bool audio_started = false;
 
 	while (1)
 	{
@@ -291,22 +759,38 @@ int main(int argc, char **argv)
 		{
 			start_requested = STOP_PLAY;
 			int ret = pthread_create(&audio_processing_thread, NULL,
-					run_audio_processing_thread, (void *)input_file);
+					run_audio_processing_thread, NULL);
 			if(ret != 0) {
 				fprintf(stderr, "\n*****ERROR***** create thread faild: %s\n\n",
 						snd_strerror(ret));
 				break;
 			}
+			audio_started = true;
 		}
 		else if(start_requested == EXIT_PLAY)
 			break;
 		else
 			sleep(2);
 	}
-
-	dmabuf_heap_destroy(&data_dma_buf_params);
+	if (exit_requested)
+		printf("\nCaught Ctrl+C, cleaning up...\n");
+	if (audio_started)
+		pthread_join(audio_processing_thread, NULL);
+
+	cleanup_rpmsg_buffer();
+	if (rpmsg_fd >= 0) {
+		rpmsg_sched_destroy(&dsp_sched);
+		streams_destroy();
+		rpmsg_async_destroy(&dsp_async);
+		cleanup_rpmsg(rpmsg_fd);
+	}
+	dmabuf_pool_destroy(&data_dma_buf_pool);
 	dmabuf_heap_destroy(&options_dma_buf_params);
-	if(current_mode) {
+	fir_conv_destroy(&fir);
+	worker_pool_destroy(&arm_pool);
+	close_host_interface();
+	cpu_sampler_stop(&cpu_sampler);
+	if(is_remote_fw_managed()) {
 		// Revert to original firmware
 		switch_firmware(app_config.c7_old_fw_path,
                                 app_config.fw_link_path, app_config.c7_state_path);
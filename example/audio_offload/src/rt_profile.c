@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "rt_profile.h"
+
+// ====================== Helpers =========================
+
+static const char *policy_name(int policy)
+{
+	return policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER";
+}
+
+static long read_long(const char *path, long fallback)
+{
+	FILE *fp = fopen(path, "r");
+	long v = fallback;
+
+	if (fp) {
+		if (fscanf(fp, "%ld", &v) != 1)
+			v = fallback;
+		fclose(fp);
+	}
+	return v;
+}
+
+/* Parses a kernel cpulist ("1-3,5") */
+static void read_cpulist(const char *path, cpu_set_t *set)
+{
+	char buf[256], *p = buf;
+	FILE *fp = fopen(path, "r");
+
+	CPU_ZERO(set);
+	if (!fp)
+		return;
+	if (!fgets(buf, sizeof(buf), fp))
+		buf[0] = '\0';
+	fclose(fp);
+
+	while (*p >= '0' && *p <= '9') {
+		long first = strtol(p, &p, 10), last = first;
+
+		if (*p == '-')
+			last = strtol(p + 1, &p, 10);
+		for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, set);
+		if (*p == ',')
+			p++;
+	}
+}
+
+static void format_cpus(const cpu_set_t *set, char *out, size_t size)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	size_t len = 0;
+
+	out[0] = '\0';
+	for (int cpu = 0; cpu < ncpus && cpu < CPU_SETSIZE && len < size; cpu++) {
+		if (CPU_ISSET(cpu, set))
+			len += snprintf(out + len, size - len, "%s%d", len ? "," : "", cpu);
+	}
+}
+
+// ====================== Thread Scheduling =========================
+
+/* Returns 1 for an empty spec (leave the thread alone), 0 when parsed, -EINVAL otherwise */
+int rt_parse(const char *spec, struct rt_sched *s)
+{
+	const char *p = spec;
+	size_t n;
+
+	s->policy = SCHED_OTHER;
+	s->prio = 0;
+	s->cpu = -1;
+	if (!spec || !spec[0])
+		return 1;
+
+	n = strcspn(p, ":@");
+	if (n == 4 && strncmp(p, "fifo", 4) == 0)
+		s->policy = SCHED_FIFO;
+	else if (n == 2 && strncmp(p, "rr", 2) == 0)
+		s->policy = SCHED_RR;
+	else if (!(n == 5 && strncmp(p, "other", 5) == 0))
+		return -EINVAL;
+	p += n;
+
+	if (*p == ':')
+		s->prio = strtol(p + 1, (char **)&p, 10);
+	if (*p == '@')
+		s->cpu = strtol(p + 1, (char **)&p, 10);
+	if (*p != '\0' || s->cpu >= CPU_SETSIZE ||
+	    s->prio < sched_get_priority_min(s->policy) || s->prio > sched_get_priority_max(s->policy))
+		return -EINVAL;
+	return 0;
+}
+
+/* Applies s, then reads the thread back so the log shows what is really in effect */
+int rt_apply_sched(const char *name, pthread_t thread, const struct rt_sched *s)
+{
+	struct sched_param sp = { .sched_priority = s->prio };
+	cpu_set_t set, isolated, both;
+	char cpus[128];
+	int policy, ret = 0, err;
+
+	if (s->cpu >= 0) {
+		CPU_ZERO(&set);
+		CPU_SET(s->cpu, &set);
+		err = pthread_setaffinity_np(thread, sizeof(set), &set);
+		if (err) {
+			printf("[RT] %s: cannot pin to CPU %d: %s\n", name, s->cpu, strerror(err));
+			ret = -err;
+		}
+	}
+	err = pthread_setschedparam(thread, s->policy, &sp);
+	if (err) {
+		printf("[RT] %s: cannot set %s priority %d: %s (needs CAP_SYS_NICE or RLIMIT_RTPRIO)\n",
+		       name, policy_name(s->policy), s->prio, strerror(err));
+		ret = -err;
+	}
+
+	pthread_getschedparam(thread, &policy, &sp);
+	pthread_getaffinity_np(thread, sizeof(set), &set);
+	format_cpus(&set, cpus, sizeof(cpus));
+	read_cpulist("/sys/devices/system/cpu/isolated", &isolated);
+	CPU_AND(&both, &set, &isolated);
+	printf("[RT] %s: %s priority %d, CPUs %s%s\n", name, policy_name(policy), sp.sched_priority,
+	       cpus, CPU_EQUAL(&both, &set) ? " (isolated)" :
+	       policy != SCHED_OTHER ? " (shared with other tasks)" : "");
+	return ret;
+}
+
+int rt_apply(const char *name, pthread_t thread, const char *spec)
+{
+	struct rt_sched s;
+	int ret = rt_parse(spec, &s);
+
+	if (ret < 0)
+		printf("[RT] %s: invalid profile \"%s\", expected <other|fifo|rr>[:prio][@cpu]\n",
+		       name, spec);
+	if (ret != 0)
+		return ret < 0 ? ret : 0;
+	return rt_apply_sched(name, thread, &s);
+}
+
+// ====================== Memory =========================
+
+void rt_prefault_stack(void)
+{
+	volatile char stack[RT_STACK_PREFAULT];
+
+	for (size_t i = 0; i < sizeof(stack); i += 4096)
+		stack[i] = 0;
+}
+
+/*
+ * Locks every current and future mapping, so dma-bufs, heap growth and
+ * thread stacks are faulted in when they are created rather than on first
+ * touch. The heap is never trimmed or served from fresh mmaps, and new
+ * threads get smaller stacks since all of each one is locked.
+ */
+int rt_lock_memory(void)
+{
+	pthread_attr_t attr;
+	char line[128];
+	FILE *fp;
+
+	if (pthread_attr_init(&attr) == 0) {
+		pthread_attr_setstacksize(&attr, RT_THREAD_STACK);
+		pthread_setattr_default_np(&attr);
+		pthread_attr_destroy(&attr);
+	}
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+		int err = errno;
+		struct rlimit rl;
+
+		getrlimit(RLIMIT_MEMLOCK, &rl);
+		printf("[RT] mlockall failed: %s (RLIMIT_MEMLOCK %ld KB)\n", strerror(err),
+		       rl.rlim_cur == RLIM_INFINITY ? -1L : (long)(rl.rlim_cur / 1024));
+		return -err;
+	}
+	rt_prefault_stack();
+
+	fp = fopen("/proc/self/status", "r");
+	while (fp && fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "VmLck:", 6) == 0)
+			printf("[RT] Memory locked, %s", line);
+	}
+	if (fp)
+		fclose(fp);
+	return 0;
+}
+
+// ====================== Startup Check =========================
+
+/* Reports system settings that defeat a real-time profile */
+void rt_check(void)
+{
+	long runtime = read_long("/proc/sys/kernel/sched_rt_runtime_us", -1);
+	long period = read_long("/proc/sys/kernel/sched_rt_period_us", 0);
+	cpu_set_t isolated;
+	char cpus[128];
+	struct rlimit rl;
+
+	if (runtime >= 0)
+		printf("[RT] RT throttling on: RT threads may run %ld of every %ld us "
+		       "(sched_rt_runtime_us=-1 disables it)\n", runtime, period);
+	read_cpulist("/sys/devices/system/cpu/isolated", &isolated);
+	format_cpus(&isolated, cpus, sizeof(cpus));
+	printf("[RT] Isolated CPUs: %s\n", cpus[0] ? cpus : "none (isolcpus= / nohz_full= not set)");
+	if (geteuid() != 0 && getrlimit(RLIMIT_RTPRIO, &rl) == 0)
+		printf("[RT] Not root: RLIMIT_RTPRIO %lu\n", (unsigned long)rl.rlim_cur);
+}
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "config.h"
+#include "host_interface.h"
+#include "streams.h"
+
+static struct dsp_stream streams[STREAMS_MAX];
+static int num_streams;
+static struct rpmsg_sched *sched;
+static bool filter_on;
+static struct rpmsg_sched_stats logged[RPMSG_SCHED_MAX_STREAMS];
+
+// ====================== Setup =========================
+
+/* "name:graph[:priority[:deadline_ms]]", comma separated; empty = no extra streams */
+int streams_parse(const char *spec)
+{
+	const char *p = spec;
+
+	num_streams = 0;
+	while (p && *p) {
+		struct dsp_stream *st = &streams[num_streams];
+		size_t n = strcspn(p, ":,");
+		char *end;
+
+		if (num_streams == STREAMS_MAX) {
+			printf("STREAMS: at most %d extra streams\n", STREAMS_MAX);
+			return -EINVAL;
+		}
+		memset(st, 0, sizeof(*st));
+		if (n == 0 || n >= STREAM_NAME_LEN || p[n] != ':')
+			goto invalid;
+		memcpy(st->name, p, n);
+		p += n + 1;
+		st->graph_id = strtol(p, &end, 0);
+		if (end == p)
+			goto invalid;
+		p = end;
+		if (*p == ':')
+			st->priority = strtol(p + 1, (char **)&p, 10);
+		if (*p == ':')
+			st->deadline_ms = strtol(p + 1, (char **)&p, 10);
+		if (*p != '\0' && *p != ',')
+			goto invalid;
+		if (*p == ',')
+			p++;
+		num_streams++;
+	}
+	return 0;
+
+invalid:
+	printf("STREAMS: invalid entry \"%s\", expected name:graph[:priority[:deadline_ms]]\n", p);
+	num_streams = 0;
+	return -EINVAL;
+}
+
+int streams_count(void)
+{
+	return num_streams;
+}
+
+/* Register every parsed stream and give it `depth` data buffers of data_size bytes */
+int streams_init(struct rpmsg_sched *s, int depth, int data_size, uint32_t block_us)
+{
+	sched = s;
+	for (int i = 0; i < num_streams; i++) {
+		struct dsp_stream *st = &streams[i];
+		uint32_t deadline_us = st->deadline_ms ? st->deadline_ms * 1000u : block_us;
+
+		st->depth = depth;
+		st->sched_id = rpmsg_sched_add_stream(sched, st->name, st->graph_id, st->priority,
+						      deadline_us);
+		if (st->sched_id < 0) {
+			printf("[Stream] %s: cannot register: %d\n", st->name, st->sched_id);
+			return st->sched_id;
+		}
+		if (dmabuf_pool_init(app_config.dma_heap_reserved, data_size, depth,
+				     app_config.rproc_dev_name, &st->pool) < 0 ||
+		    dmabuf_heap_init(app_config.dma_heap_reserved, depth * PARAMS_STRIDE,
+				     app_config.rproc_dev_name, &st->params) < 0) {
+			printf("[Stream] %s: dma-buf allocation failed\n", st->name);
+			return -ENOMEM;
+		}
+		for (int j = 0; j < depth; j++)
+			st->bufs[j] = dmabuf_pool_acquire(&st->pool);
+		printf("[Stream] %s: graph %d, priority %d, deadline %.2f ms, %d buffers\n", st->name,
+		       st->graph_id, st->priority, deadline_us / 1000.0, depth);
+	}
+	return 0;
+}
+
+void streams_set_filter(bool enabled)
+{
+	__atomic_store_n(&filter_on, enabled, __ATOMIC_RELAXED);
+}
+
+// ====================== Jobs =========================
+
+static params_t *job_params(struct dsp_stream *st, int idx)
+{
+	return (params_t *)((uint8_t *)st->params.kern_addr + idx * PARAMS_STRIDE);
+}
+
+/*
+ * Retire the oldest job: block until it is done (or abandoned on Ctrl+C), or
+ * only check it when poll is set. Returns 0 once it is retired.
+ */
+static int stream_reap_one(struct dsp_stream *st, bool poll)
+{
+	uint32_t off = st->head * PARAMS_STRIDE;
+	int ret;
+
+	if (poll)
+		ret = rpmsg_sched_wait(sched, st->jobs[st->head], NULL, 0);
+	else
+		ret = pipeline_wait_job(sched, st->jobs[st->head], NULL);
+	if (ret == -ETIMEDOUT)
+		return ret;
+	if (ret == -ECANCELED) {
+		printf("[Stream] %s: no DSP reply, abandoning the job\n", st->name);
+		goto retire;
+	}
+	if (ret < 0)
+		printf("[Stream] %s: job failed: %d\n", st->name, ret);
+
+	dmabuf_begin_cpu_access_range(&st->params, DMABUF_DIR_READ, off, sizeof(params_t));
+	st->dsp_load_sum += job_params(st, st->head)->dsp_load;
+	dmabuf_end_cpu_access_range(&st->params, DMABUF_DIR_READ, off, sizeof(params_t));
+	__atomic_store_n(&st->dsp_loads, st->dsp_loads + 1, __ATOMIC_RELAXED);
+retire:
+	st->jobs[st->head] = 0;
+	st->head = (st->head + 1) % st->depth;
+	st->count--;
+	return 0;
+}
+
+/*
+ * Hand a copy of the block to every extra stream. Results stay in the
+ * stream's own buffers; only their timing and DSP load are reported.
+ */
+void streams_submit(const int16_t *data, int bytes, uint32_t channel_mask,
+		    const struct timespec *release, bool block)
+{
+	for (int i = 0; i < num_streams; i++) {
+		struct dsp_stream *st = &streams[i];
+		struct dma_buf_params *buf;
+		ipc_msg_buf_t msg = { 0 };
+		uint32_t off;
+		int idx, ret;
+
+		while (st->count && stream_reap_one(st, true) == 0)
+			;
+		if (st->count == st->depth) {
+			if (!block) {
+				__atomic_store_n(&st->dropped, st->dropped + 1, __ATOMIC_RELAXED);
+				continue;
+			}
+			stream_reap_one(st, false);
+		}
+
+		idx = (st->head + st->count) % st->depth;
+		buf = st->bufs[idx];
+		off = idx * PARAMS_STRIDE;
+		dmabuf_begin_cpu_access_range(buf, DMABUF_DIR_WRITE, 0, bytes);
+		memcpy(buf->kern_addr, data, bytes);
+		dmabuf_end_cpu_access_range(buf, DMABUF_DIR_WRITE, 0, bytes);
+		dmabuf_begin_cpu_access_range(&st->params, DMABUF_DIR_WRITE, off, sizeof(params_t));
+		job_params(st, idx)->filter_enabled = __atomic_load_n(&filter_on, __ATOMIC_RELAXED);
+		job_params(st, idx)->channel_mask = channel_mask;
+		dmabuf_end_cpu_access_range(&st->params, DMABUF_DIR_WRITE, off, sizeof(params_t));
+
+		msg.data_buffer = (uint32_t)buf->phys_addr;
+		msg.data_size = bytes;
+		msg.params_buffer = (uint32_t)st->params.phys_addr + off;
+		msg.params_size = PARAMS_STRIDE;
+		ret = rpmsg_sched_submit(sched, st->sched_id, &msg, release, NULL, &st->jobs[idx]);
+		if (ret < 0) {
+			printf("[Stream] %s: submit failed: %d\n", st->name, ret);
+			continue;
+		}
+		st->count++;
+	}
+}
+
+/* Wait for every outstanding job, at the end of a run */
+void streams_drain(void)
+{
+	for (int i = 0; i < num_streams; i++)
+		while (streams[i].count)
+			stream_reap_one(&streams[i], false);
+}
+
+void streams_destroy(void)
+{
+	for (int i = 0; i < num_streams; i++) {
+		struct dsp_stream *st = &streams[i];
+
+		for (int j = 0; j < st->depth; j++)
+			if (st->bufs[j])
+				dmabuf_pool_release(&st->pool, st->bufs[j]);
+		dmabuf_pool_destroy(&st->pool);
+		dmabuf_heap_destroy(&st->params);
+	}
+	num_streams = 0;
+}
+
+// ====================== Stats =========================
+
+/*
+ * One pair of "[Stream]" lines per scheduler stream, averages over the
+ * interval since the last call. main_load is the main stream's DSP load,
+ * which the complete stage tracks itself.
+ */
+void log_stream_stats(struct rpmsg_sched *s, double main_load)
+{
+	for (int i = 0; i < s->num_streams; i++) {
+		struct dsp_stream *st = NULL;
+		struct rpmsg_sched_stats cur, *last = &logged[i];
+		unsigned long jobs, loads;
+		double load = main_load;
+		struct log_record *r;
+
+		for (int j = 0; j < num_streams; j++)
+			if (streams[j].sched_id == i)
+				st = &streams[j];
+		rpmsg_sched_get_stats(s, i, &cur);
+		jobs = cur.jobs - last->jobs;
+		if (st) {
+			loads = __atomic_load_n(&st->dsp_loads, __ATOMIC_RELAXED);
+			load = loads > st->logged_loads ?
+			       (st->dsp_load_sum - st->logged_load_sum) / (loads - st->logged_loads) : 0.0;
+			st->logged_load_sum = st->dsp_load_sum;
+			st->logged_loads = loads;
+		}
+
+		if ((r = log_begin(LOG_EV_STREAM)) != NULL) {
+			r->a[0].s = s->streams[i].name;
+			r->a[1].i = s->streams[i].graph_id;
+			r->a[2].i = s->streams[i].priority;
+			r->a[3].i = cur.jobs;
+			r->a[4].i = cur.misses;
+			r->a[5].i = st ? __atomic_load_n(&st->dropped, __ATOMIC_RELAXED) : 0;
+			log_end(r);
+		}
+		if ((r = log_begin(LOG_EV_STREAM_TIME)) != NULL) {
+			r->a[0].s = s->streams[i].name;
+			r->a[1].f = jobs ? (cur.wait_ns - last->wait_ns) / 1e6 / jobs : 0.0;
+			r->a[2].f = cur.wait_max_ns / 1e6;
+			r->a[3].f = jobs ? (cur.latency_ns - last->latency_ns) / 1e6 / jobs : 0.0;
+			r->a[4].f = cur.latency_max_ns / 1e6;
+			r->a[5].f = load;
+			log_end(r);
+		}
+		*last = cur;
+	}
+}
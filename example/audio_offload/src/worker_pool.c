@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "worker_pool.h"
+#include "host_interface.h"
+
+/* Spin this long before sleeping in the kernel; a fork every ~5 ms mostly sleeps */
+#define WORKER_SPIN_NS		50000
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void futex_wait(uint32_t *addr, uint32_t val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr, int count)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/* Spin, then sleep, until *addr no longer holds val; returns the new value */
+static uint32_t wait_while_equal(uint32_t *addr, uint32_t val, uint32_t *sleepers)
+{
+	uint64_t deadline = now_ns() + WORKER_SPIN_NS;
+	uint32_t cur;
+
+	while ((cur = __atomic_load_n(addr, __ATOMIC_ACQUIRE)) == val) {
+		if (now_ns() < deadline) {
+			cpu_relax();
+			continue;
+		}
+		if (sleepers)
+			__atomic_add_fetch(sleepers, 1, __ATOMIC_SEQ_CST);
+		futex_wait(addr, val);
+		if (sleepers)
+			__atomic_sub_fetch(sleepers, 1, __ATOMIC_SEQ_CST);
+	}
+	return cur;
+}
+
+// ====================== Fork/Join Worker Pool =========================
+
+static void run_job(struct worker_pool *pool, int idx)
+{
+	struct worker_stats *st = &pool->stats[idx];
+	uint64_t start = now_ns(), busy;
+
+	pool->fn(idx, pool->arg);
+	busy = now_ns() - start;
+
+	__atomic_store_n(&st->jobs, st->jobs + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&st->busy_ns, st->busy_ns + busy, __ATOMIC_RELAXED);
+	__atomic_store_n(&st->wake_ns, st->wake_ns + (start - pool->fork_ns), __ATOMIC_RELAXED);
+	if (busy > st->max_ns)
+		__atomic_store_n(&st->max_ns, busy, __ATOMIC_RELAXED);
+}
+
+static void *worker_main(void *p)
+{
+	struct worker_arg *wa = p;
+	struct worker_pool *pool = wa->pool;
+	int idx = wa->idx;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t seen = 0;
+	cpu_set_t set;
+
+	/* Worker i stays on core i; the caller (worker 0) keeps its own placement */
+	CPU_ZERO(&set);
+	CPU_SET(idx % (ncpus > 0 ? ncpus : 1), &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		printf("Worker %d: failed to set affinity\n", idx);
+
+	while (1) {
+		seen = wait_while_equal(&pool->generation, seen, &pool->sleepers);
+		if (__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE))
+			break;
+		run_job(pool, idx);
+		if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0)
+			futex_wake(&pool->pending, 1);
+	}
+	return NULL;
+}
+
+/* count workers in total, count - 1 of them persistent threads */
+int worker_pool_init(struct worker_pool *pool, int count)
+{
+	memset(pool, 0, sizeof(*pool));
+	if (count < 1)
+		count = 1;
+	if (count > WORKER_POOL_MAX)
+		count = WORKER_POOL_MAX;
+
+	pool->count = 1;
+	for (int i = 1; i < count; i++) {
+		pool->args[i].pool = pool;
+		pool->args[i].idx = i;
+		if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->args[i]) != 0) {
+			printf("Failed to start ARM worker %d\n", i);
+			worker_pool_destroy(pool);
+			return -EAGAIN;
+		}
+		pool->count++;
+	}
+	printf("ARM worker pool: %d workers\n", pool->count);
+	return 0;
+}
+
+void worker_pool_destroy(struct worker_pool *pool)
+{
+	__atomic_store_n(&pool->stop, 1, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&pool->generation, 1, __ATOMIC_SEQ_CST);
+	futex_wake(&pool->generation, INT_MAX);
+	for (int i = 1; i < pool->count; i++)
+		pthread_join(pool->threads[i], NULL);
+	pool->count = 0;
+}
+
+/* Run fn on every worker and return once all of them are done */
+void worker_pool_run(struct worker_pool *pool, worker_fn_t fn, void *arg)
+{
+	uint32_t pending;
+
+	pool->fn = fn;
+	pool->arg = arg;
+	pool->fork_ns = now_ns();
+	if (pool->count > 1) {
+		__atomic_store_n(&pool->pending, pool->count - 1, __ATOMIC_RELAXED);
+		/* Pairs with the sleeper count taken before futex_wait() */
+		__atomic_add_fetch(&pool->generation, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST))
+			futex_wake(&pool->generation, INT_MAX);
+	}
+
+	run_job(pool, 0);
+
+	while ((pending = __atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE)) != 0)
+		wait_while_equal(&pool->pending, pending, NULL);
+}
+
+void log_worker_stats(struct worker_pool *pool)
+{
+	for (int i = 0; i < pool->count; i++) {
+		struct worker_stats *st = &pool->stats[i];
+		uint64_t jobs = __atomic_load_n(&st->jobs, __ATOMIC_RELAXED);
+		struct log_record *r;
+
+		if (!jobs || !(r = log_begin(LOG_EV_WORKER)))
+			continue;
+		r->a[0].i = i;
+		r->a[1].i = jobs;
+		r->a[2].f = __atomic_load_n(&st->busy_ns, __ATOMIC_RELAXED) / 1e6 / jobs;
+		r->a[3].f = __atomic_load_n(&st->max_ns, __ATOMIC_RELAXED) / 1e6;
+		r->a[4].f = __atomic_load_n(&st->wake_ns, __ATOMIC_RELAXED) / 1e3 / jobs;
+		log_end(r);
+	}
+}
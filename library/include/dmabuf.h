@@ -1,8 +1,19 @@
 #ifndef DMABUF_H
 #define DMABUF_H
 
+#include <stdint.h>
 #include <linux/dma-buf.h>
 
+/* Byte ranges of one buffer the CPU may own at the same time */
+#define DMABUF_CPU_RANGES	4
+
+/* A range owned by the CPU, with the DMABUF_DIR_* bits it was claimed for */
+struct dmabuf_cpu_range {
+	uint32_t offset;
+	uint32_t len;
+	uint32_t dir;
+};
+
 struct dma_buf_params {
 	int dma_heap_fd;
 	int dma_buf_fd;
@@ -10,10 +21,45 @@ struct dma_buf_params {
 	uint32_t *kern_addr;
 	uint64_t phys_addr;
 	int size;
+	int cpu_ranges;		/* entries in cpu_access, 0 = device owned */
+	struct dmabuf_cpu_range cpu_access[DMABUF_CPU_RANGES];
+};
+
+/* Cache maintenance direction, from the CPU's point of view */
+#define DMABUF_DIR_READ		DMA_BUF_SYNC_READ	/* CPU reads what the device wrote */
+#define DMABUF_DIR_WRITE	DMA_BUF_SYNC_WRITE	/* CPU writes what the device reads */
+#define DMABUF_DIR_RW		DMA_BUF_SYNC_RW
+
+/* Maximum number of buffers in one pool (one bit each in free_mask) */
+#define DMABUF_POOL_MAX_BUFS	64
+
+/*
+ * Fixed set of same-sized dma-bufs allocated, attached and mapped once.
+ * The heap and remoteproc fds are shared by all buffers of the pool.
+ */
+struct dmabuf_pool {
+	int dma_heap_fd;
+	int rproc_fd;
+	int count;
+	uint32_t buf_size;
+	uint64_t free_mask;	/* bit i set = bufs[i] free, updated atomically */
+	struct dma_buf_params bufs[DMABUF_POOL_MAX_BUFS];
 };
 
 int dmabuf_heap_init(char *heap_name, uint32_t buffer_size, char *rproc_dev, struct dma_buf_params *params);
 void dmabuf_heap_destroy(struct dma_buf_params *params);
 int dmabuf_sync(int fd, int start_stop);
 
+int dmabuf_begin_cpu_access(struct dma_buf_params *params, uint32_t dir);
+int dmabuf_end_cpu_access(struct dma_buf_params *params, uint32_t dir);
+int dmabuf_begin_cpu_access_range(struct dma_buf_params *params, uint32_t dir,
+                                  uint32_t offset, uint32_t len);
+int dmabuf_end_cpu_access_range(struct dma_buf_params *params, uint32_t dir,
+                                uint32_t offset, uint32_t len);
+
+int dmabuf_pool_init(char *heap_name, uint32_t buffer_size, int count, char *rproc_dev, struct dmabuf_pool *pool);
+void dmabuf_pool_destroy(struct dmabuf_pool *pool);
+struct dma_buf_params *dmabuf_pool_acquire(struct dmabuf_pool *pool);
+void dmabuf_pool_release(struct dmabuf_pool *pool, struct dma_buf_params *buf);
+
 #endif // DMABUF_H
@@ -0,0 +1,69 @@
+#ifndef RPMSG_ASYNC_H
+#define RPMSG_ASYNC_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "rpmsg_ipc.h"
+#include "dmabuf.h"
+
+/* Maximum number of requests outstanding on one endpoint */
+#define RPMSG_ASYNC_MAX_INFLIGHT	32
+
+enum {
+	RPMSG_REQ_FREE,
+	RPMSG_REQ_INFLIGHT,
+	RPMSG_REQ_DONE,
+};
+
+/* Reply format of the remote side, learnt from its replies */
+enum {
+	RPMSG_ABI_UNKNOWN,
+	RPMSG_ABI_LEGACY,	/* IPC_MSG_LEGACY_LEN replies, no seq and no batches */
+	RPMSG_ABI_TAGGED,	/* seq echoed back, batches supported */
+};
+
+/* Reply of either a single-buffer or a batched request */
+typedef union {
+	ipc_msg_buf_t msg;
+	ipc_batch_hdr_t batch;
+} ipc_reply_t;
+
+struct rpmsg_async_req {
+	uint32_t seq;
+	int state;
+	void *cookie;
+	ipc_reply_t reply;
+};
+
+/*
+ * Tagged request/reply tracking on top of an rpmsg endpoint fd. Each
+ * submitted message gets a ticket (its seq number); replies are routed
+ * back by seq so several requests can be outstanding at once.
+ */
+struct rpmsg_async {
+	int fd;
+	int event_fd;		/* eventfd, counts completions not yet reaped */
+	uint32_t next_seq;
+	int inflight;
+	int reading;		/* a thread is currently reading replies */
+	int abi;		/* RPMSG_ABI_* */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct rpmsg_async_req reqs[RPMSG_ASYNC_MAX_INFLIGHT];
+};
+
+int rpmsg_async_init(struct rpmsg_async *as, int fd);
+void rpmsg_async_destroy(struct rpmsg_async *as);
+int rpmsg_async_submit(struct rpmsg_async *as, ipc_msg_buf_t *msg, void *cookie, uint32_t *ticket);
+int rpmsg_async_submit_batch(struct rpmsg_async *as, ipc_batch_hdr_t *hdr,
+                             const ipc_batch_entry_t *entries, struct dma_buf_params *desc,
+                             void *cookie, uint32_t *ticket);
+int rpmsg_async_poll(struct rpmsg_async *as);
+int rpmsg_async_wait(struct rpmsg_async *as, uint32_t ticket, ipc_msg_buf_t *reply, int timeout_ms);
+int rpmsg_async_wait_batch(struct rpmsg_async *as, uint32_t ticket, ipc_batch_hdr_t *reply, int timeout_ms);
+int rpmsg_async_reap(struct rpmsg_async *as, uint32_t *ticket, ipc_reply_t *reply, void **cookie);
+int rpmsg_async_cancel(struct rpmsg_async *as, uint32_t ticket);
+int rpmsg_async_fd(struct rpmsg_async *as);
+int rpmsg_async_probe(struct rpmsg_async *as, int timeout_ms);
+
+#endif //RPMSG_ASYNC_H
@@ -0,0 +1,54 @@
+#ifndef RPMSG_IPC_H
+#define RPMSG_IPC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Largest payload a single rpmsg message can carry */
+#define RPMSG_MAX_MSG_LEN	496
+
+//------- C7 IPC message structure (shared with the DSP firmware) --------
+typedef struct __attribute__((__packed__))
+{
+	uint32_t data_buffer;
+	uint32_t params_buffer;
+	int32_t data_size;
+	int32_t params_size;
+	int32_t graph_id;
+	uint32_t seq;		/* request tag, echoed back unchanged in the reply */
+}
+ipc_msg_buf_t;
+
+/* Reply length of firmware predating the seq field; such replies come back in request order */
+#define IPC_MSG_LEGACY_LEN	offsetof(ipc_msg_buf_t, seq)
+
+//------- Batched IPC: one message, one completion for many buffers --------
+#define IPC_BATCH_MAGIC		0x48435442	/* "BTCH" */
+#define IPC_BATCH_F_INDIRECT	0x1		/* entries live in the desc_buffer dma-buf */
+
+typedef struct __attribute__((__packed__))
+{
+	uint32_t data_buffer;
+	int32_t data_size;
+	int32_t graph_id;
+}
+ipc_batch_entry_t;
+
+typedef struct __attribute__((__packed__))
+{
+	uint32_t magic;
+	uint32_t seq;		/* request tag, echoed back unchanged in the reply */
+	uint16_t count;
+	uint16_t flags;
+	uint32_t params_buffer;
+	int32_t params_size;
+	uint32_t desc_buffer;	/* device address of the entry array if IPC_BATCH_F_INDIRECT */
+	int32_t status;		/* set by the remote side, 0 = all entries processed */
+}
+ipc_batch_hdr_t;
+
+/* Entries that fit inline after the header in a single rpmsg message */
+#define IPC_BATCH_MAX_INLINE \
+	((RPMSG_MAX_MSG_LEN - sizeof(ipc_batch_hdr_t)) / sizeof(ipc_batch_entry_t))
+
+#endif //RPMSG_IPC_H
@@ -0,0 +1,95 @@
+#ifndef RPMSG_SCHED_H
+#define RPMSG_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "rpmsg_ipc.h"
+#include "rpmsg_async.h"
+
+#define RPMSG_SCHED_MAX_STREAMS	8
+/* Jobs queued or in flight over all streams */
+#define RPMSG_SCHED_MAX_JOBS	RPMSG_ASYNC_MAX_INFLIGHT
+
+enum {
+	RPMSG_JOB_FREE,
+	RPMSG_JOB_QUEUED,
+	RPMSG_JOB_SENDING,		/* being written to the endpoint */
+	RPMSG_JOB_INFLIGHT,
+	RPMSG_JOB_DONE,
+};
+
+/* Counters of one stream, in ns; read them with rpmsg_sched_get_stats() */
+struct rpmsg_sched_stats {
+	unsigned long jobs;		/* completed */
+	unsigned long misses;		/* completed after their deadline */
+	unsigned long errors;		/* failed to send */
+	uint64_t wait_ns;		/* submit to dispatch, summed */
+	uint64_t wait_max_ns;
+	uint64_t latency_ns;		/* submit to reply, summed */
+	uint64_t latency_max_ns;
+	int queued_max;			/* jobs waiting for dispatch */
+};
+
+struct rpmsg_sched_stream {
+	const char *name;
+	int32_t graph_id;
+	int priority;			/* higher is dispatched first */
+	uint64_t deadline_ns;		/* relative deadline of every job */
+	int queued;
+	struct rpmsg_sched_stats stats;
+};
+
+struct rpmsg_sched_job {
+	uint32_t id;
+	int state;
+	int stream;
+	int status;			/* 0, the send error, or -EPIPE once the endpoint failed */
+	ipc_msg_buf_t msg;		/* reply once done */
+	void *cookie;
+	uint64_t t_submit;
+	uint64_t t_deadline;
+	uint64_t t_dispatch;
+};
+
+/*
+ * Multiplexes the jobs of several streams onto one rpmsg endpoint. At most
+ * max_inflight jobs are outstanding on the remote side; the rest wait here
+ * and are dispatched by priority, then earliest deadline first. A completion
+ * thread owns the endpoint reads and writes, so neither submitters nor
+ * waiters ever block on it.
+ */
+struct rpmsg_sched {
+	struct rpmsg_async *as;
+	int max_inflight;
+	int inflight;
+	int num_streams;
+	uint32_t next_id;
+	bool stop;
+	bool dead;			/* endpoint failed, every job ends with -EPIPE */
+	int wake_fd;			/* eventfd, kicks the completion thread */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct rpmsg_sched_stream streams[RPMSG_SCHED_MAX_STREAMS];
+	struct rpmsg_sched_job jobs[RPMSG_SCHED_MAX_JOBS];
+};
+
+int rpmsg_sched_init(struct rpmsg_sched *s, struct rpmsg_async *as, int max_inflight);
+void rpmsg_sched_destroy(struct rpmsg_sched *s);
+int rpmsg_sched_add_stream(struct rpmsg_sched *s, const char *name, int32_t graph_id,
+                           int priority, uint32_t deadline_us);
+/*
+ * Queue msg for the stream, tagged with the stream's graph id. The deadline
+ * runs from release, or from now when release is NULL. Returns -EBUSY when
+ * all job slots are taken, -EPIPE once the endpoint has failed.
+ */
+int rpmsg_sched_submit(struct rpmsg_sched *s, int stream, const ipc_msg_buf_t *msg,
+                       const struct timespec *release, void *cookie, uint32_t *job);
+/* Wait for a job and release it; timeout_ms < 0 waits forever, 0 only checks */
+int rpmsg_sched_wait(struct rpmsg_sched *s, uint32_t job, ipc_msg_buf_t *reply, int timeout_ms);
+void rpmsg_sched_get_stats(struct rpmsg_sched *s, int stream, struct rpmsg_sched_stats *stats);
+pthread_t rpmsg_sched_thread(struct rpmsg_sched *s);
+
+#endif //RPMSG_SCHED_H
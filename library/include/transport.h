@@ -0,0 +1,36 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+
+/*
+ * Transport backends behind init_rpmsg()/dmabuf_heap_init():
+ *   "rpmsg"    - ti-rpmsg-char endpoint + Linux DMA heaps (default)
+ *   "loopback" - socketpair endpoint answered by a simulated DSP thread,
+ *                memfd-backed buffers with fake device addresses
+ * When no backend has been selected the RPMSG_DMA_TRANSPORT environment
+ * variable is consulted.
+ */
+int transport_select(const char *name);
+const char *transport_name(void);
+
+/*
+ * Compute-time model of the simulated DSP, per message:
+ *   fixed_us + jobs * job_us + total data_size * ns_per_kb / 1024 (+ jitter)
+ * where a batched message carries several jobs and a plain one carries one.
+ */
+struct loopback_model {
+	uint32_t fixed_us;
+	uint32_t ns_per_kb;
+	uint32_t jitter_us;
+	uint32_t job_us;
+};
+
+/* Request handler run by the simulated DSP; returns the reply length */
+typedef int (*loopback_handler_t)(void *msg, int len, void *ctx);
+
+void loopback_set_model(const struct loopback_model *model);
+void loopback_set_handler(loopback_handler_t handler, void *ctx);
+void *loopback_da_to_va(uint64_t da, uint32_t size);
+
+#endif //TRANSPORT_H
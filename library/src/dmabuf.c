@@ -10,6 +10,7 @@
 #include <errno.h>
 #include "dmabuf.h"
 #include "remoteproc_cdev.h"
+#include "transport_ops.h"
 
 // ========================= DMA Heap Utilities ================================
 
@@ -67,67 +68,308 @@ int dmabuf_get_phys(int rproc_fd, int dma_buf_fd, u_int64_t *phys_addr)
 	return 0;
 }
 
-int dmabuf_heap_init(char *heap_name, uint32_t buffer_size, char *rproc_dev, struct dma_buf_params *params)
+/* Open the remoteproc cdev used to attach dma-bufs to the remote core */
+int rproc_cdev_open(char *rproc_dev)
 {
-	int ret = -1;
+	int ret;
 
-	/* Open the requested dma-heap device */
-	params->dma_heap_fd = dmaheap_open(heap_name);
-	if (params->dma_heap_fd < 0) {
-		return params->dma_heap_fd;
-	}
+	ret = open(rproc_dev, O_RDONLY);
+	if (ret < 0)
+		printf("Failed to open %s: -%d\n", rproc_dev, errno);
 
-	params->dma_buf_fd = dmaheap_alloc(params->dma_heap_fd, buffer_size);
-	if (params->dma_buf_fd < 0)
-		return -1;
+	return ret;
+}
 
-	params->rproc_fd = open(rproc_dev, O_RDONLY);
-	if (params->rproc_fd < 0) {
-		close(params->dma_buf_fd);
-		printf("Failed to open %s: -%d\n", rproc_dev, errno);
+/* Allocate a dma-buf from heap_fd, attach it through rproc_fd and map it */
+int dmaheap_buf_alloc(int heap_fd, int rproc_fd, uint32_t buffer_size, struct dma_buf_params *params)
+{
+	int ret = -1;
+
+	params->dma_buf_fd = dmaheap_alloc(heap_fd, buffer_size);
+	if (params->dma_buf_fd < 0)
 		return -1;
-	}
 
-	ret = dmabuf_get_phys(params->rproc_fd, params->dma_buf_fd, &params->phys_addr);
+	ret = dmabuf_get_phys(rproc_fd, params->dma_buf_fd, &params->phys_addr);
 	if (ret < 0) {
 		close(params->dma_buf_fd);
-		close(params->rproc_fd);
 		return ret;
 	}
 	if (params->phys_addr > ~0UL) {
 		printf("Can't pass buffer @%llx (64-bit adress) to the remote endpoint.\n",
 		       (unsigned long long) params->phys_addr);
 		close(params->dma_buf_fd);
-		close(params->rproc_fd);
 		return -1;
 	}
 
-	params->kern_addr = mmap(NULL, buffer_size, PROT_WRITE | PROT_READ, MAP_SHARED,
-	                         params->dma_buf_fd, 0);
+	/* Populate now, so the first frames do not take the page faults */
+	params->kern_addr = mmap(NULL, buffer_size, PROT_WRITE | PROT_READ,
+	                         MAP_SHARED | MAP_POPULATE, params->dma_buf_fd, 0);
 
 	if (params->kern_addr == MAP_FAILED) {
 		printf("Mapping dma-buf failed: -%d\n", errno);
 		close(params->dma_buf_fd);
-		close(params->rproc_fd);
 		return -1;
 	}
 	params->size = buffer_size;
 	return 0;
 }
 
-void dmabuf_heap_destroy(struct dma_buf_params *params)
+void dmaheap_buf_free(struct dma_buf_params *params)
 {
 	munmap(params->kern_addr, params->size);
 	close(params->dma_buf_fd);
-	close(params->rproc_fd);
 }
 
-/* Indicate start/end of a map access session.*/
-int dmabuf_sync(int fd, int start_stop)
+#ifdef DMA_BUF_IOCTL_SYNC_PARTIAL
+/* Cleared once the kernel rejects partial syncs, so we stop trying */
+static int sync_partial_supported = 1;
+#endif
+
+/* Cache sync of a whole dma-buf, or only [offset, offset + len) where the kernel supports it */
+int dmaheap_buf_sync(int fd, uint64_t flags, uint32_t offset, uint32_t len)
 {
 	struct dma_buf_sync sync = {
-		.flags = start_stop | DMA_BUF_SYNC_RW,
+		.flags = flags,
 	};
 
+#ifdef DMA_BUF_IOCTL_SYNC_PARTIAL
+	if (len && sync_partial_supported) {
+		struct dma_buf_sync_partial partial = {
+			.flags = flags,
+			.offset = offset,
+			.len = len,
+		};
+		int ret = ioctl(fd, DMA_BUF_IOCTL_SYNC_PARTIAL, &partial);
+
+		if (ret == 0 || errno != ENOTTY)
+			return ret;
+		sync_partial_supported = 0;
+	}
+#endif
 	return ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
 }
+
+// ========================= DMA Buffer API ================================
+
+int dmabuf_heap_init(char *heap_name, uint32_t buffer_size, char *rproc_dev, struct dma_buf_params *params)
+{
+	const struct transport_ops *ops = transport_get();
+	int ret = -1;
+
+	/* Open the requested dma-heap device */
+	params->dma_heap_fd = ops->heap_open(heap_name);
+	if (params->dma_heap_fd < 0) {
+		return params->dma_heap_fd;
+	}
+
+	params->rproc_fd = ops->rproc_open(rproc_dev);
+	if (params->rproc_fd < 0) {
+		close(params->dma_heap_fd);
+		return -1;
+	}
+
+	ret = ops->buf_alloc(params->dma_heap_fd, params->rproc_fd, buffer_size, params);
+	if (ret < 0) {
+		close(params->rproc_fd);
+		close(params->dma_heap_fd);
+		return ret;
+	}
+	params->cpu_ranges = 0;
+	return 0;
+}
+
+void dmabuf_heap_destroy(struct dma_buf_params *params)
+{
+	transport_get()->buf_free(params);
+	close(params->rproc_fd);
+	close(params->dma_heap_fd);
+}
+
+/* Indicate start/end of a map access session.*/
+int dmabuf_sync(int fd, int start_stop)
+{
+	return transport_get()->buf_sync(fd, start_stop | DMA_BUF_SYNC_RW, 0, 0);
+}
+
+/* Clamp [offset, offset + len) to the buffer, len 0 = whole buffer */
+static void cpu_range(const struct dma_buf_params *params, uint32_t offset, uint32_t len,
+                      uint32_t *start, uint32_t *end)
+{
+	*start = offset;
+	*end = len ? offset + len : (uint32_t)params->size;
+	if (*end > (uint32_t)params->size)
+		*end = params->size;
+}
+
+static int cpu_range_sync(struct dma_buf_params *params, uint64_t flags, uint32_t start, uint32_t end)
+{
+	if (start == 0 && end == (uint32_t)params->size)
+		return transport_get()->buf_sync(params->dma_buf_fd, flags, 0, 0);
+	return transport_get()->buf_sync(params->dma_buf_fd, flags, start, end - start);
+}
+
+/*
+ * Device -> CPU transition. Ownership is tracked per range: the call is
+ * skipped when a range the CPU already owns covers this one for every
+ * requested direction, since the device cannot have written it in the
+ * meantime. len == 0 covers the whole buffer.
+ */
+int dmabuf_begin_cpu_access_range(struct dma_buf_params *params, uint32_t dir,
+                                  uint32_t offset, uint32_t len)
+{
+	struct dmabuf_cpu_range *r = NULL;
+	uint32_t start, end, missing = dir;
+	int ret;
+
+	cpu_range(params, offset, len, &start, &end);
+	for (int i = 0; i < params->cpu_ranges; i++) {
+		struct dmabuf_cpu_range *held = &params->cpu_access[i];
+
+		if (held->offset == start && held->len == end - start)
+			r = held;
+		if (held->offset <= start && held->offset + held->len >= end && !(dir & ~held->dir))
+			return 0;
+	}
+	if (r)
+		missing = dir & ~r->dir;
+
+	/* Out of slots: claim the whole buffer and track it as a single range */
+	if (!r && params->cpu_ranges == DMABUF_CPU_RANGES) {
+		for (int i = 0; i < params->cpu_ranges; i++)
+			dir |= params->cpu_access[i].dir;
+		missing = dir;
+		start = 0;
+		end = params->size;
+		params->cpu_ranges = 0;
+	}
+
+	ret = cpu_range_sync(params, DMA_BUF_SYNC_START | missing, start, end);
+	if (ret < 0)
+		return ret;
+	if (!r) {
+		r = &params->cpu_access[params->cpu_ranges++];
+		r->offset = start;
+		r->len = end - start;
+		r->dir = 0;
+	}
+	r->dir |= missing;
+	return 0;
+}
+
+/*
+ * CPU -> device transition. dir says how the CPU used the buffer: WRITE
+ * cleans dirty lines, READ drops them. Every owned range overlapping this
+ * one is handed back in full, so a whole-buffer claim is never ended by a
+ * partial sync. Skipped when the device already owns it.
+ */
+int dmabuf_end_cpu_access_range(struct dma_buf_params *params, uint32_t dir,
+                                uint32_t offset, uint32_t len)
+{
+	uint32_t start, end;
+	int ret;
+
+	cpu_range(params, offset, len, &start, &end);
+	for (int i = 0; i < params->cpu_ranges; ) {
+		struct dmabuf_cpu_range *held = &params->cpu_access[i];
+
+		if (held->offset >= end || held->offset + held->len <= start) {
+			i++;
+			continue;
+		}
+		ret = cpu_range_sync(params, DMA_BUF_SYNC_END | dir, held->offset,
+		                     held->offset + held->len);
+		if (ret < 0)
+			return ret;
+		*held = params->cpu_access[--params->cpu_ranges];
+	}
+	return 0;
+}
+
+int dmabuf_begin_cpu_access(struct dma_buf_params *params, uint32_t dir)
+{
+	return dmabuf_begin_cpu_access_range(params, dir, 0, 0);
+}
+
+int dmabuf_end_cpu_access(struct dma_buf_params *params, uint32_t dir)
+{
+	return dmabuf_end_cpu_access_range(params, dir, 0, 0);
+}
+
+// ========================= DMA Buffer Pool ================================
+
+int dmabuf_pool_init(char *heap_name, uint32_t buffer_size, int count, char *rproc_dev, struct dmabuf_pool *pool)
+{
+	const struct transport_ops *ops = transport_get();
+	int ret = -1;
+
+	if (count <= 0 || count > DMABUF_POOL_MAX_BUFS) {
+		printf("Invalid dma-buf pool size %d (max %d)\n", count, DMABUF_POOL_MAX_BUFS);
+		return -1;
+	}
+
+	pool->count = 0;
+	pool->buf_size = buffer_size;
+	pool->free_mask = 0;
+
+	pool->dma_heap_fd = ops->heap_open(heap_name);
+	if (pool->dma_heap_fd < 0)
+		return pool->dma_heap_fd;
+
+	pool->rproc_fd = ops->rproc_open(rproc_dev);
+	if (pool->rproc_fd < 0) {
+		close(pool->dma_heap_fd);
+		return -1;
+	}
+
+	for (int i = 0; i < count; i++) {
+		struct dma_buf_params *buf = &pool->bufs[i];
+
+		ret = ops->buf_alloc(pool->dma_heap_fd, pool->rproc_fd, buffer_size, buf);
+		if (ret < 0) {
+			dmabuf_pool_destroy(pool);
+			return ret;
+		}
+		buf->dma_heap_fd = pool->dma_heap_fd;
+		buf->rproc_fd = pool->rproc_fd;
+		buf->cpu_ranges = 0;
+		pool->count++;
+	}
+
+	pool->free_mask = (count == 64) ? ~0ULL : ((1ULL << count) - 1);
+	return 0;
+}
+
+void dmabuf_pool_destroy(struct dmabuf_pool *pool)
+{
+	const struct transport_ops *ops = transport_get();
+
+	for (int i = 0; i < pool->count; i++)
+		ops->buf_free(&pool->bufs[i]);
+	pool->count = 0;
+	pool->free_mask = 0;
+	close(pool->rproc_fd);
+	close(pool->dma_heap_fd);
+}
+
+/* Take a free buffer from the pool, NULL when all are in use. Lock-free. */
+struct dma_buf_params *dmabuf_pool_acquire(struct dmabuf_pool *pool)
+{
+	uint64_t mask = __atomic_load_n(&pool->free_mask, __ATOMIC_ACQUIRE);
+
+	while (mask) {
+		uint64_t bit = mask & -mask;
+
+		if (__atomic_compare_exchange_n(&pool->free_mask, &mask, mask & ~bit, 1,
+		                                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+			return &pool->bufs[__builtin_ctzll(bit)];
+	}
+	return NULL;
+}
+
+/* Return a buffer obtained from dmabuf_pool_acquire(). Lock-free. */
+void dmabuf_pool_release(struct dmabuf_pool *pool, struct dma_buf_params *buf)
+{
+	int idx = buf - pool->bufs;
+
+	__atomic_fetch_or(&pool->free_mask, 1ULL << idx, __ATOMIC_RELEASE);
+}
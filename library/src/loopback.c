@@ -0,0 +1,316 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "transport.h"
+#include "transport_ops.h"
+#include "rpmsg_ipc.h"
+
+#define LOOPBACK_MAX_EPTS	8
+#define LOOPBACK_MAX_BUFS	256
+#define LOOPBACK_DA_BASE	0xA0000000ULL
+#define LOOPBACK_PAGE_SIZE	4096
+
+/* Simulated DSP endpoint: the app owns fd, the worker answers on peer_fd */
+struct loopback_ept {
+	int fd;
+	int peer_fd;
+	int in_use;
+	pthread_t worker;
+};
+
+struct loopback_buf {
+	uint64_t da;
+	void *va;
+	uint32_t size;
+};
+
+static struct loopback_ept epts[LOOPBACK_MAX_EPTS];
+static struct loopback_buf bufs[LOOPBACK_MAX_BUFS];
+static int num_bufs;
+static uint64_t next_da = LOOPBACK_DA_BASE;
+static pthread_mutex_t loopback_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct loopback_model model = {
+	.fixed_us = 200,
+	.ns_per_kb = 0,
+	.jitter_us = 0,
+	.job_us = 0,
+};
+static loopback_handler_t handler;
+static void *handler_ctx;
+
+void loopback_set_model(const struct loopback_model *m)
+{
+	pthread_mutex_lock(&loopback_lock);
+	model = *m;
+	pthread_mutex_unlock(&loopback_lock);
+}
+
+void loopback_set_handler(loopback_handler_t h, void *ctx)
+{
+	pthread_mutex_lock(&loopback_lock);
+	handler = h;
+	handler_ctx = ctx;
+	pthread_mutex_unlock(&loopback_lock);
+}
+
+/* Translate a fake device address back to the host mapping */
+void *loopback_da_to_va(uint64_t da, uint32_t size)
+{
+	void *va = NULL;
+
+	pthread_mutex_lock(&loopback_lock);
+	for (int i = 0; i < num_bufs; i++) {
+		if (da >= bufs[i].da && da + size <= bufs[i].da + bufs[i].size) {
+			va = (uint8_t *)bufs[i].va + (da - bufs[i].da);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&loopback_lock);
+	return va;
+}
+
+// ======================== Simulated DSP ===========================
+
+static uint64_t loopback_compute_ns(const struct loopback_model *m, const void *msg, int len)
+{
+	const ipc_batch_hdr_t *batch = msg;
+	uint64_t ns = (uint64_t)m->fixed_us * 1000;
+	uint64_t bytes = 0;
+
+	if (len >= (int)sizeof(*batch) && batch->magic == IPC_BATCH_MAGIC) {
+		const ipc_batch_entry_t *entries = (const ipc_batch_entry_t *)(batch + 1);
+
+		if (batch->flags & IPC_BATCH_F_INDIRECT)
+			entries = loopback_da_to_va(batch->desc_buffer,
+			                            batch->count * sizeof(ipc_batch_entry_t));
+		else if (len < (int)(sizeof(*batch) + batch->count * sizeof(ipc_batch_entry_t)))
+			entries = NULL;
+		if (!entries) {
+			printf("loopback: malformed batch of %u jobs\n", batch->count);
+			return ns;
+		}
+		for (int i = 0; i < batch->count; i++)
+			bytes += entries[i].data_size > 0 ? entries[i].data_size : 0;
+		ns += (uint64_t)batch->count * m->job_us * 1000;
+	} else if (len >= (int)sizeof(ipc_msg_buf_t)) {
+		const ipc_msg_buf_t *req = msg;
+
+		if (req->data_size > 0)
+			bytes = req->data_size;
+		ns += (uint64_t)m->job_us * 1000;
+	}
+	ns += bytes * m->ns_per_kb / 1024;
+	if (m->jitter_us)
+		ns += (uint64_t)(rand() % m->jitter_us) * 1000;
+
+	return ns;
+}
+
+static void loopback_delay(uint64_t ns)
+{
+	struct timespec deadline;
+
+	if (!ns)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += ns / 1000000000ULL;
+	deadline.tv_nsec += ns % 1000000000ULL;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+		;
+}
+
+static void *loopback_worker(void *arg)
+{
+	struct loopback_ept *ept = arg;
+	char msg[RPMSG_MAX_MSG_LEN];
+
+	while (1) {
+		struct loopback_model m;
+		loopback_handler_t h;
+		void *ctx;
+		int len, reply_len;
+
+		len = read(ept->peer_fd, msg, sizeof(msg));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+
+		pthread_mutex_lock(&loopback_lock);
+		m = model;
+		h = handler;
+		ctx = handler_ctx;
+		pthread_mutex_unlock(&loopback_lock);
+
+		loopback_delay(loopback_compute_ns(&m, msg, len));
+
+		/* Default firmware behaviour: pass the data through and echo the request */
+		reply_len = h ? h(msg, len, ctx) : len;
+		if (reply_len > 0 && write(ept->peer_fd, msg, reply_len) < 0)
+			break;
+	}
+	return NULL;
+}
+
+static int loopback_ept_open(int rproc_id, int rmt_ep)
+{
+	int sv[2];
+	struct loopback_ept *ept = NULL;
+
+	pthread_mutex_lock(&loopback_lock);
+	for (int i = 0; i < LOOPBACK_MAX_EPTS; i++) {
+		if (!epts[i].in_use) {
+			ept = &epts[i];
+			break;
+		}
+	}
+	if (!ept) {
+		pthread_mutex_unlock(&loopback_lock);
+		printf("loopback: no free endpoint slots\n");
+		return -EBUSY;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		pthread_mutex_unlock(&loopback_lock);
+		perror("loopback: socketpair");
+		return -errno;
+	}
+	ept->fd = sv[0];
+	ept->peer_fd = sv[1];
+	if (pthread_create(&ept->worker, NULL, loopback_worker, ept) != 0) {
+		pthread_mutex_unlock(&loopback_lock);
+		close(sv[0]);
+		close(sv[1]);
+		printf("loopback: failed to start DSP worker\n");
+		return -EAGAIN;
+	}
+	ept->in_use = 1;
+	pthread_mutex_unlock(&loopback_lock);
+
+	printf("Created loopback endpt for rproc %d port %d, fd = %d\n", rproc_id, rmt_ep, ept->fd);
+	return ept->fd;
+}
+
+static void loopback_ept_close(int fd)
+{
+	struct loopback_ept *ept = NULL;
+
+	pthread_mutex_lock(&loopback_lock);
+	for (int i = 0; i < LOOPBACK_MAX_EPTS; i++) {
+		if (epts[i].in_use && epts[i].fd == fd) {
+			ept = &epts[i];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&loopback_lock);
+
+	if (!ept) {
+		close(fd);
+		return;
+	}
+	/* Worker sees EOF on the peer end and exits */
+	shutdown(ept->fd, SHUT_RDWR);
+	pthread_join(ept->worker, NULL);
+	close(ept->fd);
+	close(ept->peer_fd);
+
+	pthread_mutex_lock(&loopback_lock);
+	ept->in_use = 0;
+	pthread_mutex_unlock(&loopback_lock);
+}
+
+// ======================== Simulated DMA Buffers ===========================
+
+/* Placeholder fd so callers can close() heap/rproc handles uniformly */
+static int loopback_dev_open(char *name)
+{
+	return open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+static int loopback_buf_alloc(int heap_fd, int rproc_fd, uint32_t size, struct dma_buf_params *params)
+{
+	uint32_t span = (size + LOOPBACK_PAGE_SIZE - 1) & ~(LOOPBACK_PAGE_SIZE - 1);
+
+	params->dma_buf_fd = memfd_create("rpmsg_dma_loopback", MFD_CLOEXEC);
+	if (params->dma_buf_fd < 0) {
+		printf("loopback: memfd_create failed: -%d\n", errno);
+		return -1;
+	}
+	if (ftruncate(params->dma_buf_fd, span) < 0) {
+		printf("loopback: ftruncate failed: -%d\n", errno);
+		close(params->dma_buf_fd);
+		return -1;
+	}
+	params->kern_addr = mmap(NULL, span, PROT_WRITE | PROT_READ, MAP_SHARED | MAP_POPULATE,
+	                         params->dma_buf_fd, 0);
+	if (params->kern_addr == MAP_FAILED) {
+		printf("loopback: mapping memfd failed: -%d\n", errno);
+		close(params->dma_buf_fd);
+		return -1;
+	}
+
+	pthread_mutex_lock(&loopback_lock);
+	if (num_bufs == LOOPBACK_MAX_BUFS) {
+		pthread_mutex_unlock(&loopback_lock);
+		printf("loopback: too many buffers\n");
+		munmap(params->kern_addr, span);
+		close(params->dma_buf_fd);
+		return -1;
+	}
+	params->phys_addr = next_da;
+	next_da += span;
+	bufs[num_bufs].da = params->phys_addr;
+	bufs[num_bufs].va = params->kern_addr;
+	bufs[num_bufs].size = span;
+	num_bufs++;
+	pthread_mutex_unlock(&loopback_lock);
+
+	params->size = size;
+	return 0;
+}
+
+static void loopback_buf_free(struct dma_buf_params *params)
+{
+	pthread_mutex_lock(&loopback_lock);
+	for (int i = 0; i < num_bufs; i++) {
+		if (bufs[i].da == params->phys_addr) {
+			bufs[i] = bufs[--num_bufs];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&loopback_lock);
+
+	munmap(params->kern_addr, params->size);
+	close(params->dma_buf_fd);
+}
+
+/* memfd mappings are coherent, nothing to clean or invalidate */
+static int loopback_buf_sync(int fd, uint64_t flags, uint32_t offset, uint32_t len)
+{
+	return 0;
+}
+
+const struct transport_ops loopback_transport = {
+	.name		= "loopback",
+	.ept_open	= loopback_ept_open,
+	.ept_close	= loopback_ept_close,
+	.heap_open	= loopback_dev_open,
+	.rproc_open	= loopback_dev_open,
+	.buf_alloc	= loopback_buf_alloc,
+	.buf_free	= loopback_buf_free,
+	.buf_sync	= loopback_buf_sync,
+};
@@ -2,30 +2,30 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
+#ifdef HAVE_TI_RPMSG_CHAR
 #include <rproc_id.h>
 #include <ti_rpmsg_char.h>
+#endif
 #include "rpmsg.h"
 #include "dmabuf.h"
+#include "transport_ops.h"
 
 // ======================== RPMSG Communication ===========================
 
 int send_msg(int fd, char *msg, int len)
 {
 	int ret = 0;
-	dmabuf_sync(fd, 1);
 	ret = write(fd, msg, len);
 	if (ret < 0) {
 		perror("Can't write to rpmsg endpt device\n");
 		return -1;
 	}
-	dmabuf_sync(fd, 0);
 	return ret;
 }
 
 int recv_msg(int fd, int len, char *reply_msg, int *reply_len)
 {
 	int ret = 0;
-	dmabuf_sync(fd, 1);
 	ret = read(fd, reply_msg, len);
 	if (ret < 0) {
 		perror("Can't read from rpmsg endpt device\n");
@@ -33,13 +33,13 @@ int recv_msg(int fd, int len, char *reply_msg, int *reply_len)
 	} else {
 		*reply_len = ret;
 	}
-	dmabuf_sync(fd, 0);
 	return 0;
 }
 
-/* Initializes the RPMSG communication. */
-int init_rpmsg(int rproc_id, int rmt_ep)
+/* Create a ti-rpmsg-char endpoint device towards the remote core. */
+int rpmsg_cdev_open(int rproc_id, int rmt_ep)
 {
+#ifdef HAVE_TI_RPMSG_CHAR
 	int ret;
 	char eptdev_name[64] = { 0 };
 	rpmsg_char_dev_t *rcdev;
@@ -59,10 +59,24 @@ int init_rpmsg(int rproc_id, int rmt_ep)
 	}
 	printf("Created endpt device %s, fd = %d port = %d\n", eptdev_name, rcdev->fd, rcdev->endpt);
 	return  rcdev->fd;
+#else
+	printf("libti_rpmsg_dma built without ti-rpmsg-char, use the loopback transport\n");
+	return -ENOSYS;
+#endif
 }
 
-void cleanup_rpmsg(int fd)
+void rpmsg_cdev_close(int fd)
 {
 	close(fd);
 }
 
+/* Initializes the RPMSG communication. */
+int init_rpmsg(int rproc_id, int rmt_ep)
+{
+	return transport_get()->ept_open(rproc_id, rmt_ep);
+}
+
+void cleanup_rpmsg(int fd)
+{
+	transport_get()->ept_close(fd);
+}
@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include "rpmsg.h"
+#include "rpmsg_async.h"
+
+// ======================== Async RPMSG Requests ===========================
+
+int rpmsg_async_init(struct rpmsg_async *as, int fd)
+{
+	pthread_condattr_t attr;
+
+	memset(as, 0, sizeof(*as));
+	as->fd = fd;
+	as->next_seq = 1;
+
+	as->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE);
+	if (as->event_fd < 0) {
+		printf("eventfd failed: -%d\n", errno);
+		return -1;
+	}
+
+	pthread_mutex_init(&as->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&as->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	return 0;
+}
+
+void rpmsg_async_destroy(struct rpmsg_async *as)
+{
+	close(as->event_fd);
+	pthread_cond_destroy(&as->cond);
+	pthread_mutex_destroy(&as->lock);
+}
+
+/* Fd that becomes readable whenever a completion is waiting to be reaped */
+int rpmsg_async_fd(struct rpmsg_async *as)
+{
+	return as->event_fd;
+}
+
+/* Tag msg with the next seq at seq_offset and send it; shared by single and batched submissions */
+static int rpmsg_async_send(struct rpmsg_async *as, void *msg, int len, size_t seq_offset,
+                            void *cookie, uint32_t *ticket)
+{
+	struct rpmsg_async_req *req;
+	uint32_t seq;
+	int ret;
+
+	pthread_mutex_lock(&as->lock);
+	req = &as->reqs[as->next_seq % RPMSG_ASYNC_MAX_INFLIGHT];
+	if (req->state != RPMSG_REQ_FREE) {
+		pthread_mutex_unlock(&as->lock);
+		return -EBUSY;
+	}
+	seq = as->next_seq++;
+	memcpy((char *)msg + seq_offset, &seq, sizeof(seq));
+	req->seq = seq;
+	req->cookie = cookie;
+	req->state = RPMSG_REQ_INFLIGHT;
+	as->inflight++;
+	pthread_mutex_unlock(&as->lock);
+
+	ret = send_msg(as->fd, msg, len);
+	if (ret != len) {
+		pthread_mutex_lock(&as->lock);
+		req->state = RPMSG_REQ_FREE;
+		as->inflight--;
+		pthread_mutex_unlock(&as->lock);
+		return -EIO;
+	}
+
+	*ticket = seq;
+	return 0;
+}
+
+int rpmsg_async_submit(struct rpmsg_async *as, ipc_msg_buf_t *msg, void *cookie, uint32_t *ticket)
+{
+	return rpmsg_async_send(as, msg, sizeof(*msg), offsetof(ipc_msg_buf_t, seq), cookie, ticket);
+}
+
+/*
+ * Submit hdr->count jobs as one message with a single completion. Entries
+ * go inline when they fit in one rpmsg message, otherwise they are written
+ * to the desc dma-buf and only its device address is sent.
+ */
+int rpmsg_async_submit_batch(struct rpmsg_async *as, ipc_batch_hdr_t *hdr,
+                             const ipc_batch_entry_t *entries, struct dma_buf_params *desc,
+                             void *cookie, uint32_t *ticket)
+{
+	char msg[RPMSG_MAX_MSG_LEN];
+	ipc_batch_hdr_t *wire = (ipc_batch_hdr_t *)msg;
+	uint32_t entries_len = hdr->count * sizeof(ipc_batch_entry_t);
+	int len = sizeof(*hdr);
+	int ret;
+
+	/* Firmware without seq support would take the header for a single-buffer request */
+	if (__atomic_load_n(&as->abi, __ATOMIC_RELAXED) != RPMSG_ABI_TAGGED) {
+		printf("rpmsg_async: batches need a remote side that echoes seq, see rpmsg_async_probe()\n");
+		return -EOPNOTSUPP;
+	}
+
+	hdr->magic = IPC_BATCH_MAGIC;
+	hdr->status = 0;
+	if (hdr->count <= IPC_BATCH_MAX_INLINE && !desc) {
+		hdr->flags &= ~IPC_BATCH_F_INDIRECT;
+		hdr->desc_buffer = 0;
+		memcpy(msg + sizeof(*hdr), entries, entries_len);
+		len += entries_len;
+	} else {
+		if (!desc || entries_len > (uint32_t)desc->size)
+			return -E2BIG;
+		dmabuf_begin_cpu_access_range(desc, DMABUF_DIR_WRITE, 0, entries_len);
+		memcpy(desc->kern_addr, entries, entries_len);
+		dmabuf_end_cpu_access_range(desc, DMABUF_DIR_WRITE, 0, entries_len);
+		hdr->flags |= IPC_BATCH_F_INDIRECT;
+		hdr->desc_buffer = (uint32_t)desc->phys_addr;
+	}
+
+	*wire = *hdr;
+	ret = rpmsg_async_send(as, msg, len, offsetof(ipc_batch_hdr_t, seq), cookie, ticket);
+	hdr->seq = wire->seq;
+	return ret;
+}
+
+/* Route a reply to its request by seq. Called with as->lock held. */
+static void rpmsg_async_complete(struct rpmsg_async *as, uint32_t seq, const char *reply, int len)
+{
+	struct rpmsg_async_req *req = &as->reqs[seq % RPMSG_ASYNC_MAX_INFLIGHT];
+	uint64_t one = 1;
+
+	if (req->state != RPMSG_REQ_INFLIGHT || req->seq != seq) {
+		printf("Dropping rpmsg reply with unknown seq %u\n", seq);
+		return;
+	}
+	memset(&req->reply, 0, sizeof(req->reply));
+	memcpy(&req->reply, reply, len < (int)sizeof(req->reply) ? len : (int)sizeof(req->reply));
+	req->state = RPMSG_REQ_DONE;
+	as->inflight--;
+	if (write(as->event_fd, &one, sizeof(one)) < 0)
+		printf("eventfd write failed: -%d\n", errno);
+	pthread_cond_broadcast(&as->cond);
+}
+
+/*
+ * A reply without seq completes the oldest request in flight: such firmware
+ * serves one endpoint in order. Called with as->lock held.
+ */
+static void rpmsg_async_complete_legacy(struct rpmsg_async *as, const char *reply, int len)
+{
+	struct rpmsg_async_req *oldest = NULL;
+
+	if (as->abi != RPMSG_ABI_LEGACY) {
+		printf("rpmsg_async: remote replies without seq, completing requests in order\n");
+		__atomic_store_n(&as->abi, RPMSG_ABI_LEGACY, __ATOMIC_RELAXED);
+	}
+	for (int i = 0; i < RPMSG_ASYNC_MAX_INFLIGHT; i++) {
+		struct rpmsg_async_req *req = &as->reqs[i];
+
+		if (req->state != RPMSG_REQ_INFLIGHT)
+			continue;
+		if (!oldest || (int32_t)(req->seq - oldest->seq) < 0)
+			oldest = req;
+	}
+	if (!oldest) {
+		printf("Dropping rpmsg reply with no request in flight\n");
+		return;
+	}
+	rpmsg_async_complete(as, oldest->seq, reply, len);
+}
+
+/* Read at most one reply from the endpoint. Returns 1 if one was handled, 0 on timeout. */
+static int rpmsg_async_read_one(struct rpmsg_async *as, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = as->fd, .events = POLLIN };
+	char buf[RPMSG_MAX_MSG_LEN];
+	const ipc_batch_hdr_t *batch = (const ipc_batch_hdr_t *)buf;
+	uint32_t seq;
+	int ret, len = 0;
+
+	ret = poll(&pfd, 1, timeout_ms);
+	if (ret < 0)
+		return errno == EINTR ? 0 : -errno;
+	if (ret == 0)
+		return 0;
+
+	ret = recv_msg(as->fd, sizeof(buf), buf, &len);
+	if (ret < 0)
+		return -EIO;
+	if (len >= (int)sizeof(*batch) && batch->magic == IPC_BATCH_MAGIC) {
+		seq = batch->seq;
+	} else if (len >= (int)sizeof(ipc_msg_buf_t)) {
+		seq = ((const ipc_msg_buf_t *)buf)->seq;
+	} else if (len == (int)IPC_MSG_LEGACY_LEN) {
+		pthread_mutex_lock(&as->lock);
+		rpmsg_async_complete_legacy(as, buf, len);
+		pthread_mutex_unlock(&as->lock);
+		return 1;
+	} else {
+		printf("Short rpmsg reply: %d bytes\n", len);
+		return 1;
+	}
+
+	pthread_mutex_lock(&as->lock);
+	if (as->abi != RPMSG_ABI_TAGGED)
+		__atomic_store_n(&as->abi, RPMSG_ABI_TAGGED, __ATOMIC_RELAXED);
+	rpmsg_async_complete(as, seq, buf, len);
+	pthread_mutex_unlock(&as->lock);
+	return 1;
+}
+
+/* Release a completed request. Called with as->lock held. */
+static void rpmsg_async_consume(struct rpmsg_async *as, struct rpmsg_async_req *req,
+                                void *reply, size_t reply_len)
+{
+	uint64_t cnt;
+
+	if (reply)
+		memcpy(reply, &req->reply, reply_len);
+	req->state = RPMSG_REQ_FREE;
+	if (read(as->event_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+		printf("eventfd read failed: -%d\n", errno);
+}
+
+/* Drain every reply already queued on the endpoint without blocking */
+int rpmsg_async_poll(struct rpmsg_async *as)
+{
+	int done = 0, ret;
+
+	pthread_mutex_lock(&as->lock);
+	if (as->reading) {
+		pthread_mutex_unlock(&as->lock);
+		return 0;
+	}
+	as->reading = 1;
+	pthread_mutex_unlock(&as->lock);
+
+	while ((ret = rpmsg_async_read_one(as, 0)) > 0)
+		done++;
+
+	pthread_mutex_lock(&as->lock);
+	as->reading = 0;
+	pthread_cond_broadcast(&as->cond);
+	pthread_mutex_unlock(&as->lock);
+
+	return ret < 0 ? ret : done;
+}
+
+static int remaining_ms(const struct timespec *deadline)
+{
+	struct timespec now;
+	long ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+	return ms > 0 ? ms : 0;
+}
+
+/*
+ * Wait for a specific ticket. Only one thread reads the endpoint at a time;
+ * others sleep until the reader has routed a reply. timeout_ms < 0 waits forever.
+ */
+static int rpmsg_async_wait_reply(struct rpmsg_async *as, uint32_t ticket, void *reply,
+                                  size_t reply_len, int timeout_ms)
+{
+	struct rpmsg_async_req *req = &as->reqs[ticket % RPMSG_ASYNC_MAX_INFLIGHT];
+	struct timespec deadline;
+	int ret = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	if (timeout_ms >= 0) {
+		deadline.tv_sec += timeout_ms / 1000;
+		deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	pthread_mutex_lock(&as->lock);
+	if (req->seq != ticket || req->state == RPMSG_REQ_FREE) {
+		pthread_mutex_unlock(&as->lock);
+		return -EINVAL;
+	}
+
+	while (req->state != RPMSG_REQ_DONE) {
+		int wait_ms = timeout_ms < 0 ? -1 : remaining_ms(&deadline);
+
+		if (timeout_ms >= 0 && wait_ms == 0) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		if (as->reading) {
+			if (timeout_ms < 0)
+				pthread_cond_wait(&as->cond, &as->lock);
+			else
+				pthread_cond_timedwait(&as->cond, &as->lock, &deadline);
+			continue;
+		}
+
+		as->reading = 1;
+		pthread_mutex_unlock(&as->lock);
+		ret = rpmsg_async_read_one(as, wait_ms);
+		pthread_mutex_lock(&as->lock);
+		as->reading = 0;
+		pthread_cond_broadcast(&as->cond);
+		if (ret < 0)
+			break;
+		ret = 0;
+	}
+
+	if (req->state == RPMSG_REQ_DONE) {
+		rpmsg_async_consume(as, req, reply, reply_len);
+		ret = 0;
+	}
+	pthread_mutex_unlock(&as->lock);
+	return ret;
+}
+
+int rpmsg_async_wait(struct rpmsg_async *as, uint32_t ticket, ipc_msg_buf_t *reply, int timeout_ms)
+{
+	return rpmsg_async_wait_reply(as, ticket, reply, sizeof(*reply), timeout_ms);
+}
+
+int rpmsg_async_wait_batch(struct rpmsg_async *as, uint32_t ticket, ipc_batch_hdr_t *reply, int timeout_ms)
+{
+	return rpmsg_async_wait_reply(as, ticket, reply, sizeof(*reply), timeout_ms);
+}
+
+/* Take the oldest completed request, if any. Returns -EAGAIN when none is ready. */
+int rpmsg_async_reap(struct rpmsg_async *as, uint32_t *ticket, ipc_reply_t *reply, void **cookie)
+{
+	struct rpmsg_async_req *oldest = NULL;
+
+	pthread_mutex_lock(&as->lock);
+	for (int i = 0; i < RPMSG_ASYNC_MAX_INFLIGHT; i++) {
+		struct rpmsg_async_req *req = &as->reqs[i];
+
+		if (req->state != RPMSG_REQ_DONE)
+			continue;
+		if (!oldest || (int32_t)(req->seq - oldest->seq) < 0)
+			oldest = req;
+	}
+	if (!oldest) {
+		pthread_mutex_unlock(&as->lock);
+		return -EAGAIN;
+	}
+	if (ticket)
+		*ticket = oldest->seq;
+	if (cookie)
+		*cookie = oldest->cookie;
+	rpmsg_async_consume(as, oldest, reply, sizeof(*reply));
+	pthread_mutex_unlock(&as->lock);
+	return 0;
+}
+
+/*
+ * Give up on a request, typically after rpmsg_async_wait() timed out. Its
+ * slot is free again and a late reply no longer matches it, so the reader
+ * drops it. Returns -EINVAL for an unknown ticket.
+ */
+int rpmsg_async_cancel(struct rpmsg_async *as, uint32_t ticket)
+{
+	struct rpmsg_async_req *req = &as->reqs[ticket % RPMSG_ASYNC_MAX_INFLIGHT];
+	int ret = 0;
+
+	pthread_mutex_lock(&as->lock);
+	if (req->seq != ticket || req->state == RPMSG_REQ_FREE) {
+		ret = -EINVAL;
+	} else if (req->state == RPMSG_REQ_DONE) {
+		rpmsg_async_consume(as, req, NULL, 0);
+	} else {
+		req->state = RPMSG_REQ_FREE;
+		as->inflight--;
+	}
+	pthread_mutex_unlock(&as->lock);
+	return ret;
+}
+
+/*
+ * Learn the reply format from one empty request (no data, no params) before
+ * any other traffic. Returns RPMSG_ABI_LEGACY or RPMSG_ABI_TAGGED, or a
+ * negative error if the remote side does not answer within timeout_ms.
+ */
+int rpmsg_async_probe(struct rpmsg_async *as, int timeout_ms)
+{
+	ipc_msg_buf_t msg = { 0 };
+	uint32_t ticket;
+	int ret;
+
+	ret = rpmsg_async_submit(as, &msg, NULL, &ticket);
+	if (ret < 0)
+		return ret;
+	ret = rpmsg_async_wait(as, ticket, NULL, timeout_ms);
+	if (ret < 0) {
+		printf("rpmsg_async: no reply to the probe request: %d\n", ret);
+		rpmsg_async_cancel(as, ticket);
+		return ret;
+	}
+	return __atomic_load_n(&as->abi, __ATOMIC_RELAXED);
+}
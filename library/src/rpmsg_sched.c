@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include "rpmsg_sched.h"
+
+// ======================== Stream Scheduler ===========================
+
+static uint64_t ts_ns(const struct timespec *t)
+{
+	return (uint64_t)t->tv_sec * 1000000000ULL + t->tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ts_ns(&t);
+}
+
+/* Next job to send: highest stream priority, then earliest deadline, then oldest */
+static struct rpmsg_sched_job *sched_pick(struct rpmsg_sched *s)
+{
+	struct rpmsg_sched_job *best = NULL;
+
+	for (int i = 0; i < RPMSG_SCHED_MAX_JOBS; i++) {
+		struct rpmsg_sched_job *job = &s->jobs[i];
+		int prio, best_prio;
+
+		if (job->state != RPMSG_JOB_QUEUED)
+			continue;
+		if (!best) {
+			best = job;
+			continue;
+		}
+		prio = s->streams[job->stream].priority;
+		best_prio = s->streams[best->stream].priority;
+		if (prio != best_prio) {
+			if (prio > best_prio)
+				best = job;
+		} else if (job->t_deadline != best->t_deadline) {
+			if (job->t_deadline < best->t_deadline)
+				best = job;
+		} else if ((int32_t)(job->id - best->id) < 0) {
+			best = job;
+		}
+	}
+	return best;
+}
+
+/*
+ * Send queued jobs while the remote side has room. Called with s->lock held
+ * by the completion thread only; the lock is dropped around each write, so
+ * a full TX queue stalls neither submitters nor waiters.
+ */
+static void sched_dispatch(struct rpmsg_sched *s)
+{
+	struct rpmsg_sched_job *job;
+
+	while (!s->dead && s->inflight < s->max_inflight && (job = sched_pick(s)) != NULL) {
+		struct rpmsg_sched_stream *st = &s->streams[job->stream];
+		ipc_msg_buf_t msg = job->msg;
+		uint32_t ticket;
+		uint64_t wait;
+		int ret;
+
+		job->state = RPMSG_JOB_SENDING;
+		s->inflight++;
+		pthread_mutex_unlock(&s->lock);
+		ret = rpmsg_async_submit(s->as, &msg, job, &ticket);
+		pthread_mutex_lock(&s->lock);
+
+		/* A request slot still taken on the endpoint: retry on the next completion */
+		if (ret == -EBUSY && job->state == RPMSG_JOB_SENDING) {
+			job->state = RPMSG_JOB_QUEUED;
+			s->inflight--;
+			break;
+		}
+
+		job->t_dispatch = now_ns();
+		wait = job->t_dispatch - job->t_submit;
+		st->queued--;
+		st->stats.wait_ns += wait;
+		if (wait > st->stats.wait_max_ns)
+			st->stats.wait_max_ns = wait;
+		/* Already failed by sched_fail_all() while the lock was dropped */
+		if (job->state != RPMSG_JOB_SENDING)
+			continue;
+		if (ret < 0) {
+			job->status = ret;
+			job->state = RPMSG_JOB_DONE;
+			s->inflight--;
+			st->stats.errors++;
+			pthread_cond_broadcast(&s->cond);
+			continue;
+		}
+		job->state = RPMSG_JOB_INFLIGHT;
+	}
+}
+
+/* The endpoint is gone: fail every job not yet done. Called with s->lock held. */
+static void sched_fail_all(struct rpmsg_sched *s, int err)
+{
+	s->dead = true;
+	for (int i = 0; i < RPMSG_SCHED_MAX_JOBS; i++) {
+		struct rpmsg_sched_job *job = &s->jobs[i];
+
+		if (job->state == RPMSG_JOB_FREE || job->state == RPMSG_JOB_DONE)
+			continue;
+		if (job->state == RPMSG_JOB_QUEUED)
+			s->streams[job->stream].queued--;
+		job->status = err;
+		job->state = RPMSG_JOB_DONE;
+		s->streams[job->stream].stats.errors++;
+	}
+	s->inflight = 0;
+	pthread_cond_broadcast(&s->cond);
+}
+
+/* Collect every routed reply. Called with s->lock held. */
+static void sched_reap(struct rpmsg_sched *s)
+{
+	ipc_reply_t reply;
+	void *cookie;
+
+	while (rpmsg_async_reap(s->as, NULL, &reply, &cookie) == 0) {
+		struct rpmsg_sched_job *job = cookie;
+		struct rpmsg_sched_stats *stats = &s->streams[job->stream].stats;
+		uint64_t now = now_ns();
+		uint64_t latency = now - job->t_submit;
+
+		job->msg = reply.msg;
+		job->state = RPMSG_JOB_DONE;
+		s->inflight--;
+		stats->jobs++;
+		stats->latency_ns += latency;
+		if (latency > stats->latency_max_ns)
+			stats->latency_max_ns = latency;
+		if (now > job->t_deadline)
+			stats->misses++;
+	}
+	pthread_cond_broadcast(&s->cond);
+}
+
+/*
+ * Sole reader of the endpoint and sole sender: route replies, then refill
+ * the remote queue. An endpoint error fails every outstanding job, after
+ * which only the wake-up eventfd is watched.
+ */
+static void *sched_thread(void *arg)
+{
+	struct rpmsg_sched *s = arg;
+	struct pollfd pfd[2] = {
+		{ .fd = s->as->fd, .events = POLLIN },
+		{ .fd = s->wake_fd, .events = POLLIN },
+	};
+	uint64_t cnt;
+
+	pthread_mutex_lock(&s->lock);
+	while (!s->stop) {
+		int err = 0;
+
+		pthread_mutex_unlock(&s->lock);
+		if (poll(pfd, 2, -1) < 0 && errno != EINTR)
+			printf("rpmsg_sched: poll failed: -%d\n", errno);
+		if ((pfd[1].revents & POLLIN) && read(s->wake_fd, &cnt, sizeof(cnt)) < 0)
+			printf("rpmsg_sched: eventfd read failed: -%d\n", errno);
+		if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+			err = -EPIPE;
+		else if ((pfd[0].revents & POLLIN) && rpmsg_async_poll(s->as) < 0)
+			err = -EPIPE;
+		pthread_mutex_lock(&s->lock);
+		sched_reap(s);
+		if (err) {
+			printf("rpmsg_sched: endpoint failed, failing all outstanding jobs\n");
+			sched_fail_all(s, err);
+			pfd[0].fd = -1;
+		}
+		sched_dispatch(s);
+	}
+	pthread_mutex_unlock(&s->lock);
+	return NULL;
+}
+
+/*
+ * The scheduler takes over the endpoint: every request on `as` must go
+ * through it from now on, replies to anything else are dropped.
+ */
+int rpmsg_sched_init(struct rpmsg_sched *s, struct rpmsg_async *as, int max_inflight)
+{
+	pthread_condattr_t attr;
+	int ret;
+
+	memset(s, 0, sizeof(*s));
+	s->as = as;
+	s->next_id = 1;
+	s->max_inflight = max_inflight;
+	if (s->max_inflight < 1 || s->max_inflight > RPMSG_ASYNC_MAX_INFLIGHT)
+		s->max_inflight = RPMSG_ASYNC_MAX_INFLIGHT;
+
+	s->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (s->wake_fd < 0) {
+		printf("eventfd failed: -%d\n", errno);
+		return -1;
+	}
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&s->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	ret = pthread_create(&s->thread, NULL, sched_thread, s);
+	if (ret != 0) {
+		printf("rpmsg_sched: thread creation failed: %d\n", ret);
+		close(s->wake_fd);
+		pthread_cond_destroy(&s->cond);
+		pthread_mutex_destroy(&s->lock);
+		return -1;
+	}
+	return 0;
+}
+
+/* Jobs still outstanding are abandoned, their replies are never read */
+void rpmsg_sched_destroy(struct rpmsg_sched *s)
+{
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&s->lock);
+	s->stop = true;
+	pthread_mutex_unlock(&s->lock);
+	if (write(s->wake_fd, &one, sizeof(one)) < 0)
+		printf("rpmsg_sched: eventfd write failed: -%d\n", errno);
+	pthread_join(s->thread, NULL);
+	close(s->wake_fd);
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->lock);
+}
+
+/* Returns the stream index. deadline_us 0 means none: dispatched last within its priority */
+int rpmsg_sched_add_stream(struct rpmsg_sched *s, const char *name, int32_t graph_id,
+                           int priority, uint32_t deadline_us)
+{
+	struct rpmsg_sched_stream *st;
+	int idx;
+
+	pthread_mutex_lock(&s->lock);
+	if (s->num_streams >= RPMSG_SCHED_MAX_STREAMS) {
+		pthread_mutex_unlock(&s->lock);
+		return -ENOSPC;
+	}
+	idx = s->num_streams++;
+	st = &s->streams[idx];
+	memset(st, 0, sizeof(*st));
+	st->name = name;
+	st->graph_id = graph_id;
+	st->priority = priority;
+	st->deadline_ns = deadline_us ? deadline_us * 1000ULL : UINT64_MAX;
+	pthread_mutex_unlock(&s->lock);
+	return idx;
+}
+
+int rpmsg_sched_submit(struct rpmsg_sched *s, int stream, const ipc_msg_buf_t *msg,
+                       const struct timespec *release, void *cookie, uint32_t *job)
+{
+	struct rpmsg_sched_stream *st;
+	struct rpmsg_sched_job *j;
+	uint64_t t_release, one = 1;
+
+	pthread_mutex_lock(&s->lock);
+	if (stream < 0 || stream >= s->num_streams) {
+		pthread_mutex_unlock(&s->lock);
+		return -EINVAL;
+	}
+	if (s->dead) {
+		pthread_mutex_unlock(&s->lock);
+		return -EPIPE;
+	}
+	st = &s->streams[stream];
+	/* Skip ids whose slot is still held, e.g. by a job starved behind higher priorities */
+	for (int tries = 0;; tries++) {
+		j = &s->jobs[s->next_id % RPMSG_SCHED_MAX_JOBS];
+		if (j->state == RPMSG_JOB_FREE)
+			break;
+		if (tries == RPMSG_SCHED_MAX_JOBS) {
+			pthread_mutex_unlock(&s->lock);
+			return -EBUSY;
+		}
+		if (++s->next_id == 0)
+			s->next_id = 1;
+	}
+	j->id = s->next_id++;
+	if (s->next_id == 0)
+		s->next_id = 1;		/* 0 is never a valid job */
+	j->stream = stream;
+	j->status = 0;
+	j->msg = *msg;
+	j->msg.graph_id = st->graph_id;
+	j->cookie = cookie;
+	j->t_submit = now_ns();
+	t_release = release ? ts_ns(release) : j->t_submit;
+	j->t_deadline = st->deadline_ns == UINT64_MAX ? UINT64_MAX : t_release + st->deadline_ns;
+	j->state = RPMSG_JOB_QUEUED;
+	if (++st->queued > st->stats.queued_max)
+		st->stats.queued_max = st->queued;
+	*job = j->id;
+	pthread_mutex_unlock(&s->lock);
+
+	/* The completion thread sends it, so the caller never blocks on the endpoint */
+	if (write(s->wake_fd, &one, sizeof(one)) < 0)
+		printf("rpmsg_sched: eventfd write failed: -%d\n", errno);
+	return 0;
+}
+
+int rpmsg_sched_wait(struct rpmsg_sched *s, uint32_t job, ipc_msg_buf_t *reply, int timeout_ms)
+{
+	struct rpmsg_sched_job *j = &s->jobs[job % RPMSG_SCHED_MAX_JOBS];
+	struct timespec deadline;
+	int ret = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	if (timeout_ms > 0) {
+		deadline.tv_sec += timeout_ms / 1000;
+		deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	pthread_mutex_lock(&s->lock);
+	if (j->id != job || j->state == RPMSG_JOB_FREE) {
+		pthread_mutex_unlock(&s->lock);
+		return -EINVAL;
+	}
+	while (j->state != RPMSG_JOB_DONE) {
+		if (timeout_ms == 0) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		if (timeout_ms < 0) {
+			pthread_cond_wait(&s->cond, &s->lock);
+		} else if (pthread_cond_timedwait(&s->cond, &s->lock, &deadline) == ETIMEDOUT) {
+			ret = j->state == RPMSG_JOB_DONE ? 0 : -ETIMEDOUT;
+			break;
+		}
+	}
+	if (j->state == RPMSG_JOB_DONE) {
+		ret = j->status;
+		if (reply)
+			*reply = j->msg;
+		j->state = RPMSG_JOB_FREE;
+	}
+	pthread_mutex_unlock(&s->lock);
+	return ret;
+}
+
+void rpmsg_sched_get_stats(struct rpmsg_sched *s, int stream, struct rpmsg_sched_stats *stats)
+{
+	pthread_mutex_lock(&s->lock);
+	*stats = s->streams[stream].stats;
+	pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * The completion thread routes every reply, so callers waiting on it at a
+ * real-time priority should give it the same scheduling.
+ */
+pthread_t rpmsg_sched_thread(struct rpmsg_sched *s)
+{
+	return s->thread;
+}
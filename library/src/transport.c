@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "transport.h"
+#include "transport_ops.h"
+
+// ========================= Transport Selection ===============================
+
+static const struct transport_ops rpmsg_transport = {
+	.name		= "rpmsg",
+	.ept_open	= rpmsg_cdev_open,
+	.ept_close	= rpmsg_cdev_close,
+	.heap_open	= dmaheap_open,
+	.rproc_open	= rproc_cdev_open,
+	.buf_alloc	= dmaheap_buf_alloc,
+	.buf_free	= dmaheap_buf_free,
+	.buf_sync	= dmaheap_buf_sync,
+};
+
+static const struct transport_ops *transports[] = {
+	&rpmsg_transport,
+	&loopback_transport,
+};
+
+static const struct transport_ops *active_transport;
+
+static const struct transport_ops *transport_lookup(const char *name)
+{
+	for (size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++) {
+		if (strcmp(transports[i]->name, name) == 0)
+			return transports[i];
+	}
+	return NULL;
+}
+
+int transport_select(const char *name)
+{
+	const struct transport_ops *ops = transport_lookup(name);
+
+	if (!ops) {
+		printf("Unknown transport '%s'\n", name);
+		return -1;
+	}
+	active_transport = ops;
+	return 0;
+}
+
+const struct transport_ops *transport_get(void)
+{
+	if (!active_transport) {
+		const char *env = getenv("RPMSG_DMA_TRANSPORT");
+
+		if (!env || transport_select(env) < 0)
+			active_transport = &rpmsg_transport;
+	}
+	return active_transport;
+}
+
+const char *transport_name(void)
+{
+	return transport_get()->name;
+}
@@ -0,0 +1,32 @@
+#ifndef TRANSPORT_OPS_H
+#define TRANSPORT_OPS_H
+
+#include <stdint.h>
+#include "dmabuf.h"
+
+/* Backend hooks behind the public rpmsg/dmabuf API */
+struct transport_ops {
+	const char *name;
+	int (*ept_open)(int rproc_id, int rmt_ep);
+	void (*ept_close)(int fd);
+	int (*heap_open)(char *heap_name);
+	int (*rproc_open)(char *rproc_dev);
+	int (*buf_alloc)(int heap_fd, int rproc_fd, uint32_t size, struct dma_buf_params *params);
+	void (*buf_free)(struct dma_buf_params *params);
+	int (*buf_sync)(int fd, uint64_t flags, uint32_t offset, uint32_t len);
+};
+
+const struct transport_ops *transport_get(void);
+
+/* rpmsg-char / DMA heap backend (rpmsg.c, dmabuf.c) */
+int rpmsg_cdev_open(int rproc_id, int rmt_ep);
+void rpmsg_cdev_close(int fd);
+int dmaheap_open(char *heap_name);
+int rproc_cdev_open(char *rproc_dev);
+int dmaheap_buf_alloc(int heap_fd, int rproc_fd, uint32_t size, struct dma_buf_params *params);
+void dmaheap_buf_free(struct dma_buf_params *params);
+int dmaheap_buf_sync(int fd, uint64_t flags, uint32_t offset, uint32_t len);
+
+extern const struct transport_ops loopback_transport;
+
+#endif //TRANSPORT_OPS_H